@@ -0,0 +1,486 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ *	Throughput benchmark for proximal.h. Each operation is timed over arrays of
+ *	operands drawn from several distributions, and the results are written to
+ *	standard output as JSON. The same source is built twice: bench_prox with
+ *	the bitwise specializations, and bench_prox_generic with the
+ *	__USE_*_SPECIALIZATION__ switches set to 0.
+ *
+ *		bench_prox [--count elements] [--time seconds] [--filter text]
+ *
+ *	The searches of sorted tables (proximal_search.h) are timed separately,
+ *	for several table sizes, in nanoseconds per query, with std::equal_range
+ *	as the reference.
+ *
+ *	Two baseline comparators are implemented here for reference: a relative
+ *	epsilon test, and the 4-ulp integer distance test used by googletest's
+ *	AlmostEquals (float and double only).
+ */
+
+#include "proximal.h"
+#include "proximal_search.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace utils;
+
+namespace
+{
+	template<class T> struct type_info;
+
+	template<> struct type_info<float>
+	{
+		using bits = std::uint32_t;
+		static constexpr const char* name = "float";
+		static constexpr bool specialized = __USE_FLOAT_IEEE754_SPECIALIZATION__;
+		static constexpr bool integer_domain = __USE_FLOAT_IEEE754_SPECIALIZATION__ && __USE_INTEGER_DOMAIN_COMPARISON__;
+	};
+
+	template<> struct type_info<double>
+	{
+		using bits = std::uint64_t;
+		static constexpr const char* name = "double";
+		static constexpr bool specialized = __USE_DOUBLE_IEEE754_SPECIALIZATION__;
+		static constexpr bool integer_domain = __USE_DOUBLE_IEEE754_SPECIALIZATION__ && __USE_INTEGER_DOMAIN_COMPARISON__;
+	};
+
+	template<> struct type_info<long double>
+	{
+		using bits = void;
+		static constexpr const char* name = "long double";
+		static constexpr bool specialized = __USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__;
+		static constexpr bool integer_domain = false;
+	};
+
+	/*
+	 *	|a - b| <= 4 * epsilon * max(|a|, |b|), the usual relative tolerance.
+	 */
+	template<class T>
+	inline bool relative_epsilon(T a, T b)
+	{
+		const T tolerance = 4 * std::numeric_limits<T>::epsilon();
+		return a == b || std::abs(a - b) <= tolerance * std::max(std::abs(a), std::abs(b));
+	}
+
+	/*
+	 *	googletest's FloatingPoint<T>::AlmostEquals: map the sign-magnitude bit
+	 *	patterns onto a biased unsigned scale, and accept a distance of at most
+	 *	4 representable values. NaN never compares equal.
+	 */
+	template<class T>
+	inline typename type_info<T>::bits biased(T x)
+	{
+		using U = typename type_info<T>::bits;
+		constexpr U sign = U(1) << (sizeof(U) * 8 - 1);
+		U u;
+		std::memcpy(&u, &x, sizeof(u));
+		return (u & sign) ? ~u + 1 : u | sign;
+	}
+
+	template<class T>
+	inline bool almost_equals(T a, T b)
+	{
+		if (std::isnan(a) || std::isnan(b))
+		{
+			return false;
+		}
+		auto ua = biased(a);
+		auto ub = biased(b);
+		return (ua >= ub ? ua - ub : ub - ua) <= 4;
+	}
+
+	/*
+	 *	Operand distributions. Pairs are generated so that a mix of them fall
+	 *	inside and outside a margin of a few ulps. Normal operands are kept far
+	 *	enough above the smallest normal that their differences are normal too;
+	 *	denormal operands and differences are measured separately, since they
+	 *	are much slower on most hardware.
+	 */
+	enum class distribution { normal, denormal, special, equal };
+
+	const char* distribution_name(distribution d)
+	{
+		switch (d)
+		{
+		case distribution::normal: return "normal";
+		case distribution::denormal: return "denormal";
+		case distribution::special: return "nan_inf";
+		case distribution::equal: return "mostly_equal";
+		}
+		return "";
+	}
+
+	template<class T>
+	T step(T x, int ulps)
+	{
+		const T direction = ulps < 0 ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity();
+		for (int i = 0; i < std::abs(ulps); ++i)
+		{
+			x = std::nextafter(x, direction);
+		}
+		return x;
+	}
+
+	template<class T>
+	void generate(distribution d, std::size_t count, std::vector<T>& a, std::vector<T>& b)
+	{
+		std::mt19937_64 rng{0x70726f78696d616cull};
+		std::uniform_real_distribution<T> significand{1, 2};
+		std::uniform_int_distribution<int> exponent{std::numeric_limits<T>::min_exponent + std::numeric_limits<T>::digits, std::numeric_limits<T>::max_exponent - 2};
+		std::uniform_int_distribution<int> offset{-6, 6};
+		std::uniform_int_distribution<int> percent{0, 99};
+		std::uniform_int_distribution<std::uint64_t> denormal{0, (std::uint64_t(1) << std::min(std::numeric_limits<T>::digits - 1, 63)) - 1};
+		const T specials[] = {std::numeric_limits<T>::quiet_NaN(), std::numeric_limits<T>::infinity(), -std::numeric_limits<T>::infinity()};
+
+		a.resize(count);
+		b.resize(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			T x = std::ldexp(significand(rng), exponent(rng));
+			if (rng() & 1)
+			{
+				x = -x;
+			}
+			T y = step(x, offset(rng));
+			switch (d)
+			{
+			case distribution::normal:
+				break;
+			case distribution::denormal:
+				x = std::numeric_limits<T>::denorm_min() * static_cast<T>(denormal(rng));
+				y = step(x, offset(rng));
+				break;
+			case distribution::special:
+				if (percent(rng) < 25)
+				{
+					(rng() & 1 ? x : y) = specials[rng() % 3];
+				}
+				break;
+			case distribution::equal:
+				y = percent(rng) < 99 ? x : step(x, 1 + std::abs(offset(rng)));
+				break;
+			}
+			a[i] = x;
+			b[i] = y;
+		}
+	}
+
+	/*
+	 *	Run pass() until at least min_time has elapsed, and return the fastest
+	 *	single pass in seconds.
+	 */
+	template<class F>
+	double measure(F&& pass, double min_time)
+	{
+		using clock = std::chrono::steady_clock;
+		pass();
+		double best = std::numeric_limits<double>::max();
+		double total = 0;
+		int runs = 0;
+		while (total < min_time || runs < 3)
+		{
+			auto start = clock::now();
+			pass();
+			double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			best = std::min(best, elapsed);
+			total += elapsed;
+			++runs;
+		}
+		return best;
+	}
+
+	struct options
+	{
+		std::size_t count = std::size_t(1) << 20;
+		double time = 0.1;
+		std::string filter;
+	};
+
+	struct reporter
+	{
+		const options& opts;
+		bool first = true;
+		volatile std::size_t sink = 0;
+
+		bool wanted(const std::string& key) const
+		{
+			return opts.filter.empty() || key.find(opts.filter) != std::string::npos;
+		}
+
+		template<class T>
+		void emit(distribution d, const char* operation, double seconds, std::size_t bytes, double true_fraction)
+		{
+			std::printf("%s\n    {\"type\": \"%s\", \"distribution\": \"%s\", \"operation\": \"%s\", "
+				"\"implementation\": \"%s\", \"integer_domain\": %s, \"ns_per_element\": %.4f, \"gb_per_s\": %.3f",
+				first ? "" : ",", type_info<T>::name, distribution_name(d), operation,
+				type_info<T>::specialized ? "specialized" : "generic", type_info<T>::integer_domain ? "true" : "false",
+				seconds * 1e9 / opts.count, bytes / seconds * 1e-9);
+			if (true_fraction >= 0)
+			{
+				std::printf(", \"true_fraction\": %.4f", true_fraction);
+			}
+			std::printf("}");
+			first = false;
+		}
+
+		template<class T, class C>
+		void compare(distribution d, const char* operation, const std::vector<T>& a, const std::vector<T>& b, C cmp)
+		{
+			if (!wanted(std::string(type_info<T>::name) + " " + distribution_name(d) + " " + operation))
+			{
+				return;
+			}
+			const std::size_t count = a.size();
+			std::size_t hits = 0;
+			double seconds = measure([&]
+			{
+				std::size_t n = 0;
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					n += cmp(a[i], b[i]);
+				}
+				hits = n;
+				sink = sink + n;
+			}, opts.time);
+			emit<T>(d, operation, seconds, 2 * count * sizeof(T), double(hits) / count);
+		}
+
+		template<class T, class F>
+		void transform(distribution d, const char* operation, const std::vector<T>& x, std::vector<T>& result, F f)
+		{
+			if (!wanted(std::string(type_info<T>::name) + " " + distribution_name(d) + " " + operation))
+			{
+				return;
+			}
+			const std::size_t count = x.size();
+			double seconds = measure([&]
+			{
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					result[i] = f(x[i]);
+				}
+				sink = sink + (result[count / 2] != 0);
+			}, opts.time);
+			emit<T>(d, operation, seconds, 2 * count * sizeof(T), -1);
+		}
+
+		template<class T, class F>
+		void search(std::size_t table_size, const char* operation, std::size_t queries, F f)
+		{
+			double seconds = measure([&] { sink = sink + f(); }, opts.time);
+			std::printf("%s\n    {\"type\": \"%s\", \"table_elements\": %zu, \"operation\": \"%s\", \"ns_per_query\": %.2f}",
+				first ? "" : ",", type_info<T>::name, table_size, operation, seconds * 1e9 / queries);
+			first = false;
+		}
+
+		template<class T, class F>
+		void batch(distribution d, const char* operation, std::size_t bytes, F f)
+		{
+			if (!wanted(std::string(type_info<T>::name) + " " + distribution_name(d) + " " + operation))
+			{
+				return;
+			}
+			double seconds = measure([&] { sink = sink + f(); }, opts.time);
+			emit<T>(d, operation, seconds, bytes, -1);
+		}
+	};
+
+	template<class T>
+	void run(reporter& out)
+	{
+		const std::size_t count = out.opts.count;
+		std::vector<T> a, b, result(count);
+		std::vector<std::uint64_t> mask((count + 63) / 64);
+		proximal<1> close_enough;
+		proximal_dynamic dynamic{1};
+		for (distribution d : {distribution::normal, distribution::denormal, distribution::special, distribution::equal})
+		{
+			generate(d, count, a, b);
+			out.compare(d, "proximal<1>", a, b, close_enough);
+			out.compare(d, "proximal_dynamic(1)", a, b, dynamic);
+			out.compare(d, "relative_epsilon", a, b, relative_epsilon<T>);
+			out.transform(d, "ulp", a, result, [](T x) { return ulp(x); });
+			out.transform(d, "margin<1>", a, result, [](T x) { return margin<1>(x); });
+			out.transform(d, "ulp (ilog2)", a, result, [](T x) { return ulp<T>(x); });
+			out.transform(d, "margin<1> (ilog2)", a, result, [](T x) { return margin<1, T>(x); });
+			out.batch<T>(d, "ulp_histogram[]", 2 * count * sizeof(T), [&] { ulp_histogram h; h.add(a.data(), b.data(), count); return h.count(0); });
+			if constexpr (!std::is_same<T, long double>::value)
+			{
+				out.compare(d, "almost_equals_4ulp", a, b, almost_equals<T>);
+				out.batch<T>(d, "mismatches[]", 2 * count * sizeof(T), [&] { return close_enough.mismatches(a.data(), b.data(), count, mask.data()); });
+				out.batch<T>(d, "stats[]", 2 * count * sizeof(T), [&] { return close_enough.stats(a.data(), b.data(), count).mismatches; });
+				out.batch<T>(d, "margin<1>[]", 2 * count * sizeof(T), [&] { margin<1>(a.data(), result.data(), count); return std::size_t(result[0] != 0); });
+			}
+			if constexpr (std::is_same<T, float>::value)
+			{
+				std::vector<double> reference(b.begin(), b.end());
+				out.batch<T>(d, "proximal_cross mismatches[]", count * (sizeof(float) + sizeof(double)),
+					[&] { return proximal_cross<1>{}.mismatches(a.data(), reference.data(), count, mask.data()); });
+			}
+		}
+	}
+}
+
+namespace
+{
+	/*
+	 *	Queries are elements of the table moved a few ulps, so that most find
+	 *	a short range, in random order.
+	 */
+	template<class T>
+	void run_search(reporter& out)
+	{
+		const std::size_t query_count = std::min<std::size_t>(out.opts.count, std::size_t(1) << 16);
+		for (std::size_t size : {std::size_t(1) << 12, std::size_t(1) << 16, std::size_t(1) << 20, std::size_t(1) << 24})
+		{
+			const std::string prefix = std::string(type_info<T>::name) + " search " + std::to_string(size) + " ";
+			const char* operations[] = {"std::equal_range", "proximal_equal_range", "proximal_equal_range[]", "proximal_eytzinger equal_range", "proximal_eytzinger equal_range[]"};
+			if (std::none_of(std::begin(operations), std::end(operations), [&](const char* op) { return out.wanted(prefix + op); }))
+			{
+				continue;
+			}
+			std::mt19937_64 rng{0x7365617263680000ull + size};
+			std::uniform_real_distribution<T> value{-1e6, 1e6};
+			std::uniform_int_distribution<int> offset{-3, 3};
+			std::vector<T> table(size);
+			for (T& x : table)
+			{
+				x = value(rng);
+			}
+			std::sort(table.begin(), table.end());
+			std::vector<T> queries(query_count);
+			for (T& q : queries)
+			{
+				q = step(table[rng() % size], offset(rng));
+			}
+			std::vector<std::pair<std::size_t, std::size_t>> ranges(query_count);
+			if (out.wanted(prefix + operations[0]))
+			{
+				out.search<T>(size, operations[0], query_count, [&]
+				{
+					std::size_t n = 0;
+					for (T q : queries)
+					{
+						auto r = std::equal_range(table.begin(), table.end(), q);
+						n += static_cast<std::size_t>(r.second - r.first);
+					}
+					return n;
+				});
+			}
+			if (out.wanted(prefix + operations[1]))
+			{
+				out.search<T>(size, operations[1], query_count, [&]
+				{
+					std::size_t n = 0;
+					for (T q : queries)
+					{
+						auto r = proximal_equal_range(table.data(), table.data() + size, q);
+						n += static_cast<std::size_t>(r.second - r.first);
+					}
+					return n;
+				});
+			}
+			if (out.wanted(prefix + operations[2]))
+			{
+				out.search<T>(size, operations[2], query_count, [&]
+				{
+					proximal_equal_range(table.data(), size, queries.data(), query_count, ranges.data());
+					return ranges[0].second;
+				});
+			}
+			if (out.wanted(prefix + operations[3]) || out.wanted(prefix + operations[4]))
+			{
+				proximal_eytzinger<T> tree{table.data(), size};
+				if (out.wanted(prefix + operations[3]))
+				{
+					out.search<T>(size, operations[3], query_count, [&]
+					{
+						std::size_t n = 0;
+						for (T q : queries)
+						{
+							auto r = tree.equal_range(q);
+							n += r.second - r.first;
+						}
+						return n;
+					});
+				}
+				if (out.wanted(prefix + operations[4]))
+				{
+					out.search<T>(size, operations[4], query_count, [&]
+					{
+						tree.equal_range(queries.data(), query_count, ranges.data());
+						return ranges[0].second;
+					});
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	options opts;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (std::strcmp(argv[i], "--count") == 0)
+		{
+			opts.count = std::strtoull(argv[i + 1], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--time") == 0)
+		{
+			opts.time = std::strtod(argv[i + 1], nullptr);
+		}
+		else if (std::strcmp(argv[i], "--filter") == 0)
+		{
+			opts.filter = argv[i + 1];
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--count elements] [--time seconds] [--filter text]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (opts.count == 0)
+	{
+		opts.count = 1;
+	}
+
+	std::printf("{\n  \"count\": %zu,\n  \"simd\": \"%s\",\n  \"results\": [", opts.count, simd::isa_name(simd::active()));
+	reporter out{opts};
+	run<float>(out);
+	run<double>(out);
+	run<long double>(out);
+	run_search<float>(out);
+	run_search<double>(out);
+	std::printf("\n  ]\n}\n");
+	return 0;
+}
@@ -0,0 +1,894 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ *	Compares files of raw half, bfloat16, float or double values, in native byte
+ *	order, with proximal_dynamic. Each pair of files is mapped into memory and
+ *	compared in place, in chunks spread over a thread pool; nothing is copied.
+ *	The statistics of each pair are written to standard output as JSON.
+ *
+ *		proxdiff [--type half|bfloat16|float|double] [--n N] [--offset bytes] [--stride elements]
+ *			[--threads count] [--chunk bytes] [--numa] expected actual [expected actual ...]
+ *
+ *	The offset is the position of the first value in both files, and the stride
+ *	is the distance between the values compared, in elements; the indices in
+ *	the output count the values compared. The exit status is 0 if every pair
+ *	has the same number of values and all of them are close, 1 if not, and 2 on
+ *	error.
+ *
+ *		proxdiff --csv [--type float|double] [--n N] [--delimiter character]
+ *			[--column column=N ...] expected actual [expected actual ...]
+ *
+ *	With --csv, the files are compared as CSV text, field by field. Fields that
+ *	are numbers in both files are parsed with std::from_chars and compared with
+ *	the N of their column, which --column sets by number (from 1) or by name in
+ *	the first line; other fields must be equal. Both files are read in one pass,
+ *	with no table built, and the pair matches only if they have the same lines
+ *	and fields.
+ */
+
+#include "proximal.h"
+#include "proximal_parallel.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace utils;
+
+namespace
+{
+	struct options
+	{
+		std::string type = "double";
+		int n = 1;
+		std::size_t offset = 0;
+		std::size_t stride = 1;
+		unsigned threads = 0;
+		std::size_t chunk_bytes = 4 * 1024 * 1024;
+		bool numa_local = false;
+		bool csv = false;
+		char delimiter = ',';
+		std::vector<std::pair<std::string, int>> columns;
+	};
+
+	/*
+	 *	A read-only mapping of a whole file, advised for sequential access and,
+	 *	where the kernel supports it for file mappings, huge pages.
+	 */
+	class mapping
+	{
+	public:
+
+		explicit inline mapping(const char* path)
+		{
+			int fd = ::open(path, O_RDONLY);
+			if (fd < 0)
+			{
+				error_ = std::strerror(errno);
+				return;
+			}
+			struct stat st;
+			if (::fstat(fd, &st) != 0)
+			{
+				error_ = std::strerror(errno);
+				::close(fd);
+				return;
+			}
+			size_ = static_cast<std::size_t>(st.st_size);
+			if (size_ > 0)
+			{
+				void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (p == MAP_FAILED)
+				{
+					error_ = std::strerror(errno);
+					size_ = 0;
+				}
+				else
+				{
+					data_ = static_cast<const char*>(p);
+					::madvise(p, size_, MADV_SEQUENTIAL);
+				#ifdef MADV_HUGEPAGE
+					::madvise(p, size_, MADV_HUGEPAGE);
+				#endif
+				}
+			}
+			::close(fd);
+		}
+
+		inline ~mapping()
+		{
+			if (data_)
+			{
+				::munmap(const_cast<char*>(data_), size_);
+			}
+		}
+
+		mapping(const mapping&) = delete;
+		mapping& operator=(const mapping&) = delete;
+
+		inline const char* data() const
+		{
+			return data_;
+		}
+
+		inline std::size_t size() const
+		{
+			return size_;
+		}
+
+		inline const char* error() const
+		{
+			return error_;
+		}
+
+	private:
+
+		const char* data_ = nullptr;
+		std::size_t size_ = 0;
+		const char* error_ = nullptr;
+	};
+
+	inline void print_string(const char* s)
+	{
+		std::putchar('"');
+		for (; *s; ++s)
+		{
+			unsigned char c = static_cast<unsigned char>(*s);
+			if (c == '"' || c == '\\')
+			{
+				std::printf("\\%c", c);
+			}
+			else if (c < 0x20)
+			{
+				std::printf("\\u%04x", c);
+			}
+			else
+			{
+				std::putchar(c);
+			}
+		}
+		std::putchar('"');
+	}
+
+	/*
+	 *	JSON has no infinity; non-finite values are written as strings.
+	 */
+	inline void print_value(double x)
+	{
+		if (std::isfinite(x))
+		{
+			std::printf("%.17g", x);
+		}
+		else
+		{
+			std::printf("\"%s\"", std::isnan(x) ? "nan" : "inf");
+		}
+	}
+
+	inline void print_index(std::size_t index, std::size_t npos)
+	{
+		if (index == npos)
+		{
+			std::printf("null");
+		}
+		else
+		{
+			std::printf("%zu", index);
+		}
+	}
+
+	/*
+	 *	Compares the values of a pair of files in place. The chunks of both
+	 *	arrays are compared where they lie in the mappings: contiguous values
+	 *	take the SIMD batch path, and strided values are folded in one at a
+	 *	time.
+	 */
+	template<class T>
+	class binary_diff
+	{
+	public:
+
+		// half and bfloat16 values are compared, and reported, as float
+		using stats_type = decltype(std::declval<proximal_dynamic>().stats(std::declval<const T*>(), std::declval<const T*>(), 0));
+		using value_type = decltype(stats_type::max_error);
+
+		explicit inline binary_diff(const options& opts)
+		:
+		opts_{opts},
+		workers_{opts.threads, opts.numa_local},
+		close_enough_{opts.n}
+		{}
+
+		inline void header() const
+		{
+			std::printf("  \"offset\": %zu,\n  \"stride\": %zu,\n  \"threads\": %u,\n", opts_.offset, opts_.stride, workers_.size());
+		}
+
+		inline bool prepare(const mapping&, const char*)
+		{
+			return true;
+		}
+
+		/*
+		 *	Prints the statistics of the pair, and returns true if they match.
+		 */
+		inline bool compare(const mapping& expected, const mapping& actual)
+		{
+			const std::size_t expected_count = _element_count(expected);
+			const std::size_t actual_count = _element_count(actual);
+			const std::size_t count = std::min(expected_count, actual_count);
+			stats_type s;
+			if (count > 0)
+			{
+				s = _compare(reinterpret_cast<const T*>(expected.data() + opts_.offset), reinterpret_cast<const T*>(actual.data() + opts_.offset), count);
+			}
+			std::printf(", \"expected_elements\": %zu, \"actual_elements\": %zu, \"compared\": %zu, \"mismatches\": %zu, \"first_mismatch\": ",
+				expected_count, actual_count, s.count, s.mismatches);
+			print_index(s.first_mismatch, stats_type::npos);
+			std::printf(", \"max_error\": ");
+			print_value(s.max_error);
+			std::printf(", \"max_ulps\": ");
+			print_value(s.max_ulps);
+			std::printf(", \"worst\": ");
+			print_index(s.worst, stats_type::npos);
+			return s.mismatches == 0 && expected_count == actual_count;
+		}
+
+	private:
+
+		/*
+		 *	The number of values at offset, offset + stride, ... that fit in the file.
+		 */
+		inline std::size_t _element_count(const mapping& file) const
+		{
+			if (file.size() < opts_.offset || file.size() - opts_.offset < sizeof(T))
+			{
+				return 0;
+			}
+			return (file.size() - opts_.offset - sizeof(T)) / (opts_.stride * sizeof(T)) + 1;
+		}
+
+		inline stats_type _compare(const T* a, const T* b, std::size_t count)
+		{
+			const std::size_t stride = opts_.stride;
+			const std::size_t chunk = std::max<std::size_t>(1, opts_.chunk_bytes / (2 * sizeof(T)) / stride);
+			const std::size_t chunks = (count + chunk - 1) / chunk;
+			std::vector<stats_type> partial(chunks);
+			workers_.run(chunks, [&](std::size_t i)
+			{
+				const std::size_t first = i * chunk;
+				const std::size_t length = std::min(chunk, count - first);
+				if (stride == 1)
+				{
+					partial[i] = close_enough_.stats(a + first, b + first, length, first);
+				}
+				else
+				{
+					stats_type& s = partial[i];
+					for (std::size_t j = first; j < first + length; ++j)
+					{
+						const T x = a[j * stride];
+						const T y = b[j * stride];
+						const value_type u = static_cast<value_type>(x);
+						const value_type v = static_cast<value_type>(y);
+						const T larger = std::abs(u) > std::abs(v) ? x : y;
+						s.add(j, u, v, close_enough_(x, y), static_cast<value_type>(close_enough_.ulp(larger)));
+					}
+				}
+				return true;
+			}, a, chunk * stride * sizeof(T));
+			stats_type total;
+			for (const auto& s : partial)
+			{
+				total.merge(s);
+			}
+			return total;
+		}
+
+		const options& opts_;
+		parallel::pool workers_;
+		const proximal_dynamic close_enough_;
+	};
+
+	/*
+	 *	Finds the structural characters of a CSV file: the delimiter, newline
+	 *	and double quote. The text is classified 64 bytes at a time into a bit
+	 *	mask, with SSE2 where available, and the mask of the current block is
+	 *	kept for the following searches.
+	 */
+	class scanner
+	{
+	public:
+
+		inline scanner(const char* begin, const char* end, char delimiter)
+		:
+		begin_{begin},
+		end_{end},
+		delimiter_{delimiter}
+		{}
+
+		/*
+		 *	The first structural character at or after p, or end.
+		 */
+		inline const char* find(const char* p)
+		{
+			while (p < end_)
+			{
+				const char* block = begin_ + ((p - begin_) & ~std::ptrdiff_t{63});
+				if (block != block_)
+				{
+					block_ = block;
+					mask_ = _classify(block);
+				}
+				std::uint64_t m = mask_ & (~std::uint64_t{0} << (p - block));
+				if (m != 0)
+				{
+					return block + __builtin_ctzll(m);
+				}
+				p = block + 64;
+			}
+			return end_;
+		}
+
+		inline const char* end() const
+		{
+			return end_;
+		}
+
+	private:
+
+		inline std::uint64_t _classify(const char* block) const
+		{
+			std::uint64_t mask = 0;
+		#if defined(__SSE2__)
+			if (end_ - block >= 64)
+			{
+				const __m128i delimiter = _mm_set1_epi8(delimiter_);
+				const __m128i newline = _mm_set1_epi8('\n');
+				const __m128i quote = _mm_set1_epi8('"');
+				for (int i = 0; i < 4; ++i)
+				{
+					__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+					__m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, delimiter), _mm_cmpeq_epi8(v, newline)), _mm_cmpeq_epi8(v, quote));
+					mask |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(hits))) << (16 * i);
+				}
+				return mask;
+			}
+		#endif
+			const std::ptrdiff_t length = std::min<std::ptrdiff_t>(64, end_ - block);
+			for (std::ptrdiff_t i = 0; i < length; ++i)
+			{
+				const char c = block[i];
+				mask |= static_cast<std::uint64_t>(c == delimiter_ || c == '\n' || c == '"') << i;
+			}
+			return mask;
+		}
+
+		const char* begin_;
+		const char* end_;
+		const char* block_ = nullptr;
+		std::uint64_t mask_ = 0;
+		char delimiter_;
+	};
+
+	struct field
+	{
+		const char* begin;
+		const char* end;
+		bool last;		// the field ends its line
+	};
+
+	/*
+	 *	Reads a CSV file one field at a time. A double quote starts a quoted
+	 *	section, in which delimiters and newlines are text and "" is a quote;
+	 *	fields are returned as written, quotes included.
+	 */
+	class reader
+	{
+	public:
+
+		inline reader(const mapping& file, char delimiter)
+		:
+		scan_{file.data(), file.data() + file.size(), delimiter},
+		p_{file.data()}
+		{}
+
+		inline bool done() const
+		{
+			return p_ == scan_.end();
+		}
+
+		inline field next()
+		{
+			const char* begin = p_;
+			const char* q = scan_.find(p_);
+			while (q != scan_.end() && *q == '"')
+			{
+				q = scan_.find(_skip_quoted(q + 1));
+			}
+			field f{begin, q, q == scan_.end() || *q == '\n'};
+			p_ = q == scan_.end() ? q : q + 1;
+			if (f.last && f.end != f.begin && f.end[-1] == '\r')
+			{
+				--f.end;
+			}
+			return f;
+		}
+
+		inline void skip_line()
+		{
+			while (!next().last)
+			{}
+		}
+
+	private:
+
+		/*
+		 *	The position after the quote that closes a quoted section.
+		 */
+		inline const char* _skip_quoted(const char* p) const
+		{
+			for (;;)
+			{
+				p = static_cast<const char*>(std::memchr(p, '"', scan_.end() - p));
+				if (!p)
+				{
+					return scan_.end();
+				}
+				if (p + 1 == scan_.end() || p[1] != '"')
+				{
+					return p + 1;
+				}
+				p += 2;
+			}
+		}
+
+		scanner scan_;
+		const char* p_;
+	};
+
+	/*
+	 *	Parses a whole field, less surrounding blanks, as a number.
+	 */
+	template<class T>
+	inline bool parse(const field& f, T& x)
+	{
+		const char* begin = f.begin;
+		const char* end = f.end;
+		while (begin != end && (*begin == ' ' || *begin == '\t'))
+		{
+			++begin;
+		}
+		while (end != begin && (end[-1] == ' ' || end[-1] == '\t'))
+		{
+			--end;
+		}
+		if (end - begin > 1 && *begin == '+')
+		{
+			++begin;
+		}
+		if (begin == end)
+		{
+			return false;
+		}
+		const auto result = std::from_chars(begin, end, x);
+		return result.ec == std::errc{} && result.ptr == end;
+	}
+
+	struct location
+	{
+		std::size_t line = 0;
+		std::size_t column = 0;
+	};
+
+	inline void print_location(const location& at)
+	{
+		if (at.line == 0)
+		{
+			std::printf("null");
+		}
+		else
+		{
+			std::printf("{\"line\": %zu, \"column\": %zu}", at.line, at.column);
+		}
+	}
+
+	/*
+	 *	Compares a pair of CSV files field by field, as they are parsed. Fields
+	 *	that are numbers in both files are compared with the proximal_dynamic of
+	 *	their column, and other fields are compared as text. Lines and columns
+	 *	are numbered from 1.
+	 */
+	template<class T>
+	class csv_diff
+	{
+	public:
+
+		explicit inline csv_diff(const options& opts)
+		:
+		opts_{opts}
+		{}
+
+		inline void header() const
+		{
+			std::printf("  \"delimiter\": ");
+			const char delimiter[2] = {opts_.delimiter, 0};
+			print_string(delimiter);
+			std::printf(",\n");
+		}
+
+		/*
+		 *	Sets the N of each column given on the command line, by number or by
+		 *	its name in the first line of the expected file.
+		 */
+		inline bool prepare(const mapping& expected, const char* name)
+		{
+			columns_.clear();
+			std::vector<std::string> names;
+			for (const auto& c : opts_.columns)
+			{
+				std::size_t column = 0;
+				if (c.first.find_first_not_of("0123456789") == std::string::npos)
+				{
+					column = std::strtoull(c.first.c_str(), nullptr, 10);
+				}
+				else
+				{
+					if (names.empty())
+					{
+						reader header{expected, opts_.delimiter};
+						for (field f{nullptr, nullptr, header.done()}; !f.last; )
+						{
+							f = header.next();
+							names.emplace_back(f.begin, f.end);
+						}
+					}
+					column = std::find(names.begin(), names.end(), c.first) - names.begin() + 1;
+					if (column > names.size())
+					{
+						std::fprintf(stderr, "proxdiff: %s: no column named %s\n", name, c.first.c_str());
+						return false;
+					}
+				}
+				if (column == 0)
+				{
+					std::fprintf(stderr, "proxdiff: column numbers start at 1\n");
+					return false;
+				}
+				if (columns_.size() < column)
+				{
+					columns_.resize(column, proximal_dynamic{opts_.n});
+				}
+				columns_[column - 1] = proximal_dynamic{c.second};
+			}
+			return true;
+		}
+
+		inline bool compare(const mapping& expected, const mapping& actual)
+		{
+			const proximal_dynamic close_enough{opts_.n};
+			reader a{expected, opts_.delimiter};
+			reader b{actual, opts_.delimiter};
+			proximal_stats<T> s;
+			std::size_t fields = 0;
+			std::size_t text_mismatches = 0;
+			std::size_t shape_mismatches = 0;
+			location first;
+			location worst;
+			location at;
+			while (!a.done() || !b.done())
+			{
+				++at.line;
+				at.column = 0;
+				if (a.done() || b.done())
+				{
+					_mismatch(first, at, shape_mismatches);
+					(a.done() ? b : a).skip_line();
+					continue;
+				}
+				for (;;)
+				{
+					const field x = a.next();
+					const field y = b.next();
+					++at.column;
+					const bool same = x.end - x.begin == y.end - y.begin && std::memcmp(x.begin, y.begin, x.end - x.begin) == 0;
+					T u;
+					T v;
+					if (same)
+					{
+						// identical text matches, NaN included, so that a file
+						// compares equal to itself
+						s.count += parse(x, u);
+					}
+					else if (parse(x, u) && parse(y, v))
+					{
+						const proximal_dynamic& c = at.column <= columns_.size() ? columns_[at.column - 1] : close_enough;
+						const std::size_t mismatches = s.mismatches;
+						const std::size_t worst_index = s.worst;
+						s.add(fields, u, v, c(u, v));
+						if (s.mismatches != mismatches && first.line == 0)
+						{
+							first = at;
+						}
+						if (s.worst != worst_index)
+						{
+							worst = at;
+						}
+					}
+					else
+					{
+						_mismatch(first, at, text_mismatches);
+					}
+					++fields;
+					if (x.last || y.last)
+					{
+						if (x.last != y.last)
+						{
+							_mismatch(first, at, shape_mismatches);
+							(x.last ? b : a).skip_line();
+						}
+						break;
+					}
+				}
+			}
+			std::printf(", \"lines\": %zu, \"fields\": %zu, \"numeric_fields\": %zu, \"mismatches\": %zu, \"text_mismatches\": %zu, \"shape_mismatches\": %zu, \"first_mismatch\": ",
+				at.line, fields, s.count, s.mismatches, text_mismatches, shape_mismatches);
+			print_location(first);
+			std::printf(", \"max_error\": ");
+			print_value(s.max_error);
+			std::printf(", \"max_ulps\": ");
+			print_value(s.max_ulps);
+			std::printf(", \"worst\": ");
+			print_location(worst);
+			return s.mismatches == 0 && text_mismatches == 0 && shape_mismatches == 0;
+		}
+
+	private:
+
+		static inline void _mismatch(location& first, const location& at, std::size_t& count)
+		{
+			++count;
+			if (first.line == 0)
+			{
+				first = at;
+			}
+		}
+
+		const options& opts_;
+		std::vector<proximal_dynamic> columns_;
+	};
+
+	/*
+	 *	Compares each pair of files and prints one JSON object per pair.
+	 *	Returns the exit status.
+	 */
+	template<class D>
+	inline int run(D& diff, const options& opts, char** files, int count)
+	{
+		int status = 0;
+		bool first = true;
+		std::printf("{\n  \"type\": \"%s\",\n  \"n\": %d,\n", opts.type.c_str(), opts.n);
+		diff.header();
+		std::printf("  \"simd\": \"%s\",\n  \"files\": [", simd::isa_name(simd::active()));
+		for (int i = 0; i + 1 < count; i += 2)
+		{
+			const mapping expected{files[i]};
+			const mapping actual{files[i + 1]};
+			const char* failed = expected.error() ? files[i] : actual.error() ? files[i + 1] : nullptr;
+			if (failed)
+			{
+				std::fprintf(stderr, "proxdiff: %s: %s\n", failed, expected.error() ? expected.error() : actual.error());
+				status = 2;
+				continue;
+			}
+			if (!diff.prepare(expected, files[i]))
+			{
+				status = 2;
+				continue;
+			}
+			std::printf("%s\n    {\"expected\": ", first ? "" : ",");
+			first = false;
+			print_string(files[i]);
+			std::printf(", \"actual\": ");
+			print_string(files[i + 1]);
+			if (!diff.compare(expected, actual) && status == 0)
+			{
+				status = 1;
+			}
+			std::printf("}");
+		}
+		std::printf("\n  ]\n}\n");
+		return status;
+	}
+
+	template<class T>
+	inline int run_csv(const options& opts, char** files, int count)
+	{
+		csv_diff<T> diff{opts};
+		return run(diff, opts, files, count);
+	}
+
+	template<class T>
+	inline int run_binary(const options& opts, char** files, int count)
+	{
+		if (opts.offset % sizeof(T) != 0)
+		{
+			std::fprintf(stderr, "proxdiff: the offset must be a multiple of %zu bytes\n", sizeof(T));
+			return 2;
+		}
+		// so that offset + sizeof(T) and stride * sizeof(T) do not wrap
+		if (opts.offset > SIZE_MAX - sizeof(T) || opts.stride > SIZE_MAX / sizeof(T))
+		{
+			std::fprintf(stderr, "proxdiff: the offset or stride is too large\n");
+			return 2;
+		}
+		binary_diff<T> diff{opts};
+		return run(diff, opts, files, count);
+	}
+
+	inline int usage(const char* name)
+	{
+		std::fprintf(stderr, "usage: %s [--type half|bfloat16|float|double] [--n N] [--offset bytes] [--stride elements] "
+			"[--threads count] [--chunk bytes] [--numa] expected actual [expected actual ...]\n"
+			"       %s --csv [--type float|double] [--n N] [--delimiter character] [--column column=N ...] "
+			"expected actual [expected actual ...]\n", name, name);
+		return 2;
+	}
+
+	/*
+	 *	Parses the whole of text as a decimal integer that fits in T.
+	 */
+	template<class T>
+	inline bool parse_option(const char* text, T& value)
+	{
+		const char* end = text + std::strlen(text);
+		const std::from_chars_result result = std::from_chars(text, end, value);
+		return end != text && result.ec == std::errc{} && result.ptr == end;
+	}
+
+	inline int invalid(const char* name, const char* option, const char* value)
+	{
+		std::fprintf(stderr, "proxdiff: invalid value for %s: %s\n", option, value);
+		return usage(name);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	options opts;
+	int i = 1;
+	for (; i < argc && std::strncmp(argv[i], "--", 2) == 0; ++i)
+	{
+		if (std::strcmp(argv[i], "--numa") == 0)
+		{
+			opts.numa_local = true;
+			continue;
+		}
+		if (std::strcmp(argv[i], "--csv") == 0)
+		{
+			opts.csv = true;
+			continue;
+		}
+		if (i + 1 == argc)
+		{
+			return usage(argv[0]);
+		}
+		const char* value = argv[++i];
+		if (std::strcmp(argv[i - 1], "--type") == 0)
+		{
+			opts.type = value;
+		}
+		else if (std::strcmp(argv[i - 1], "--n") == 0)
+		{
+			if (!parse_option(value, opts.n) || opts.n < 0)
+			{
+				return invalid(argv[0], argv[i - 1], value);
+			}
+		}
+		else if (std::strcmp(argv[i - 1], "--offset") == 0)
+		{
+			if (!parse_option(value, opts.offset))
+			{
+				return invalid(argv[0], argv[i - 1], value);
+			}
+		}
+		else if (std::strcmp(argv[i - 1], "--stride") == 0)
+		{
+			if (!parse_option(value, opts.stride) || opts.stride == 0)
+			{
+				return invalid(argv[0], argv[i - 1], value);
+			}
+		}
+		else if (std::strcmp(argv[i - 1], "--threads") == 0)
+		{
+			if (!parse_option(value, opts.threads))
+			{
+				return invalid(argv[0], argv[i - 1], value);
+			}
+		}
+		else if (std::strcmp(argv[i - 1], "--chunk") == 0)
+		{
+			if (!parse_option(value, opts.chunk_bytes))
+			{
+				return invalid(argv[0], argv[i - 1], value);
+			}
+		}
+		else if (std::strcmp(argv[i - 1], "--delimiter") == 0 && std::strlen(value) == 1 && *value != '"' && *value != '\n')
+		{
+			opts.delimiter = *value;
+		}
+		else if (std::strcmp(argv[i - 1], "--column") == 0 && std::strrchr(value, '=') && std::strrchr(value, '=') != value)
+		{
+			const char* equals = std::strrchr(value, '=');
+			int n = 0;
+			if (!parse_option(equals + 1, n) || n < 0)
+			{
+				return invalid(argv[0], argv[i - 1], value);
+			}
+			opts.columns.emplace_back(std::string(value, equals), n);
+		}
+		else
+		{
+			return usage(argv[0]);
+		}
+	}
+	const int files = argc - i;
+	if (files == 0 || files % 2 != 0)
+	{
+		return usage(argv[0]);
+	}
+
+	if (opts.type == "float")
+	{
+		return opts.csv ? run_csv<float>(opts, argv + i, files) : run_binary<float>(opts, argv + i, files);
+	}
+	if (opts.type == "double")
+	{
+		return opts.csv ? run_csv<double>(opts, argv + i, files) : run_binary<double>(opts, argv + i, files);
+	}
+	if (opts.type == "half" && !opts.csv)
+	{
+		return run_binary<half>(opts, argv + i, files);
+	}
+	if (opts.type == "bfloat16" && !opts.csv)
+	{
+		return run_binary<bfloat16>(opts, argv + i, files);
+	}
+	return usage(argv[0]);
+}
@@ -0,0 +1,278 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ *	Tests of the proxdiff command line tool: each case writes its input files
+ *	to PROXDIFF_TEST_DIR, runs the proxdiff built alongside (PROXDIFF_PATH),
+ *	and checks the exit status and the JSON it prints.
+ */
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+namespace
+{
+	struct outcome
+	{
+		int status;
+		std::string output;
+	};
+
+	std::string path(const std::string& name)
+	{
+		::mkdir(PROXDIFF_TEST_DIR, 0755);
+		return std::string(PROXDIFF_TEST_DIR) + "/" + name;
+	}
+
+	template<class T>
+	std::string write_values(const std::string& name, const std::vector<T>& values)
+	{
+		const std::string file = path(name);
+		std::FILE* f = std::fopen(file.c_str(), "wb");
+		REQUIRE(f != nullptr);
+		std::fwrite(values.data(), sizeof(T), values.size(), f);
+		std::fclose(f);
+		return file;
+	}
+
+	std::string write_text(const std::string& name, const std::string& text)
+	{
+		const std::string file = path(name);
+		std::FILE* f = std::fopen(file.c_str(), "wb");
+		REQUIRE(f != nullptr);
+		std::fwrite(text.data(), 1, text.size(), f);
+		std::fclose(f);
+		return file;
+	}
+
+	/*
+	 *	Runs proxdiff with arguments (file names are not quoted), discarding
+	 *	its standard error.
+	 */
+	outcome proxdiff(const std::string& arguments)
+	{
+		const std::string command = std::string(PROXDIFF_PATH) + " " + arguments + " 2>/dev/null";
+		std::FILE* p = ::popen(command.c_str(), "r");
+		REQUIRE(p != nullptr);
+		outcome result{0, {}};
+		char buffer[4096];
+		for (std::size_t n; (n = std::fread(buffer, 1, sizeof(buffer), p)) > 0; )
+		{
+			result.output.append(buffer, n);
+		}
+		const int status = ::pclose(p);
+		result.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+		return result;
+	}
+
+	bool contains(const outcome& o, const std::string& text)
+	{
+		return o.output.find(text) != std::string::npos;
+	}
+}
+
+TEST_CASE("binary files")
+{
+	std::vector<double> values(1000);
+	for (std::size_t i = 0; i < values.size(); ++i)
+	{
+		values[i] = 1.0 + static_cast<double>(i) / 7.0;
+	}
+	const std::string expected = write_values("expected.f64", values);
+
+	SUBCASE("identical files")
+	{
+		outcome o = proxdiff(expected + " " + expected);
+		CHECK(o.status == 0);
+		CHECK(contains(o, "\"compared\": 1000, \"mismatches\": 0,"));
+	}
+
+	SUBCASE("close and mismatching values")
+	{
+		std::vector<double> actual = values;
+		actual[10] = std::nextafter(actual[10], 2.0 * actual[10]);
+		CHECK(proxdiff(expected + " " + write_values("close.f64", actual)).status == 0);
+		actual[500] *= 1.001;
+		actual[700] *= 1.01;
+		outcome o = proxdiff(expected + " " + write_values("mismatch.f64", actual));
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"mismatches\": 2, \"first_mismatch\": 500,"));
+		CHECK(contains(o, "\"worst\": 700}"));
+		CHECK(proxdiff("--n 48 " + expected + " " + path("mismatch.f64")).status == 0);
+	}
+
+	SUBCASE("offset and stride")
+	{
+		std::vector<double> actual = values;
+		for (std::size_t i = 1; i < actual.size(); i += 2)
+		{
+			actual[i] = -1.0;
+		}
+		const std::string odd = write_values("odd.f64", actual);
+		CHECK(proxdiff(expected + " " + odd).status == 1);
+		outcome o = proxdiff("--stride 2 " + expected + " " + odd);
+		CHECK(o.status == 0);
+		CHECK(contains(o, "\"compared\": 500,"));
+		o = proxdiff("--offset 8 --stride 2 " + expected + " " + odd);
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"mismatches\": 500, \"first_mismatch\": 0,"));
+		o = proxdiff("--offset 16 --stride 2 " + expected + " " + odd);
+		CHECK(o.status == 0);
+		CHECK(contains(o, "\"compared\": 499,"));
+		CHECK(proxdiff("--offset 4 " + expected + " " + odd).status == 2);
+	}
+
+	SUBCASE("other types")
+	{
+		std::vector<float> floats(values.begin(), values.end());
+		const std::string f32 = write_values("expected.f32", floats);
+		CHECK(proxdiff("--type float " + f32 + " " + f32).status == 0);
+		floats[3] = 0.0f;
+		CHECK(proxdiff("--type float " + f32 + " " + write_values("actual.f32", floats)).status == 1);
+		CHECK(contains(proxdiff("--type half " + f32 + " " + f32), "\"compared\": 2000,"));
+	}
+
+	SUBCASE("length mismatch")
+	{
+		std::vector<double> shorter(values.begin(), values.end() - 1);
+		outcome o = proxdiff(expected + " " + write_values("shorter.f64", shorter));
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"expected_elements\": 1000, \"actual_elements\": 999,"));
+	}
+
+	SUBCASE("missing file")
+	{
+		CHECK(proxdiff(expected + " " + path("missing.f64")).status == 2);
+		// the other pairs are still compared
+		outcome o = proxdiff(path("missing.f64") + " " + expected + " " + expected + " " + expected);
+		CHECK(o.status == 2);
+		CHECK(contains(o, "\"compared\": 1000, \"mismatches\": 0,"));
+	}
+
+	SUBCASE("invalid options")
+	{
+		for (const char* options : {"--n abc", "--n -1", "--n 2x", "--offset 1e3", "--offset -8", "--stride 0", "--stride x",
+			"--threads -1", "--chunk 4k", "--type int", "--column 1=x", "--n",
+			"--offset 18446744073709551608", "--stride 9223372036854775808", "--stride 2305843009213693952"})
+		{
+			CAPTURE(options);
+			CHECK(proxdiff(std::string(options) + " " + expected + " " + expected).status == 2);
+		}
+		CHECK(proxdiff(expected).status == 2);
+		CHECK(proxdiff("--type half --stride 9223372036854775808 " + expected + " " + expected).status == 2);
+		CHECK(proxdiff("--type half --stride 9223372036854775807 " + expected + " " + expected).status == 0);
+	}
+}
+
+TEST_CASE("csv files")
+{
+	const std::string text =
+		"name,pressure,\"note, quoted\"\n"
+		"x,1.5,\"a \"\"b\"\", c\"\n"
+		"y,100.0,\"two\nlines\"\n"
+		"z,nan,nan\n";
+	const std::string expected = write_text("expected.csv", text);
+
+	SUBCASE("identical files")
+	{
+		// NaN fields match themselves, so a file is close to itself
+		outcome o = proxdiff("--csv " + expected + " " + expected);
+		CHECK(o.status == 0);
+		CHECK(contains(o, "\"lines\": 4, \"fields\": 12, \"numeric_fields\": 4, \"mismatches\": 0, \"text_mismatches\": 0, \"shape_mismatches\": 0,"));
+	}
+
+	SUBCASE("quoted fields")
+	{
+		// delimiters, quotes and newlines within quotes are text
+		std::string actual = text;
+		actual.replace(actual.find("c\""), 1, "d");
+		outcome o = proxdiff("--csv " + expected + " " + write_text("quoted.csv", actual));
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"lines\": 4, \"fields\": 12,"));
+		CHECK(contains(o, "\"text_mismatches\": 1, \"shape_mismatches\": 0, \"first_mismatch\": {\"line\": 2, \"column\": 3},"));
+		// quotes are part of the field, so a quoted number is text
+		actual = text;
+		actual.replace(actual.find("1.5"), 3, "\"1.5\"");
+		o = proxdiff("--csv " + expected + " " + write_text("quoted_number.csv", actual));
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"text_mismatches\": 1,"));
+	}
+
+	SUBCASE("crlf line endings")
+	{
+		// the newline within quotes is text, and is left as it is
+		const std::string actual =
+			"name,pressure,\"note, quoted\"\r\n"
+			"x,1.5,\"a \"\"b\"\", c\"\r\n"
+			"y,100.0,\"two\nlines\"\r\n"
+			"z,nan,nan\r\n";
+		outcome o = proxdiff("--csv " + expected + " " + write_text("crlf.csv", actual));
+		CHECK(o.status == 0);
+		CHECK(contains(o, "\"lines\": 4, \"fields\": 12, \"numeric_fields\": 4, \"mismatches\": 0,"));
+	}
+
+	SUBCASE("columns")
+	{
+		std::string actual = text;
+		actual.replace(actual.find("100.0"), 5, "100.1");
+		const std::string changed = write_text("column.csv", actual);
+		outcome o = proxdiff("--csv " + expected + " " + changed);
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"mismatches\": 1, \"text_mismatches\": 0, \"shape_mismatches\": 0, \"first_mismatch\": {\"line\": 3, \"column\": 2},"));
+		CHECK(proxdiff("--csv --column 2=46 " + expected + " " + changed).status == 0);
+		CHECK(proxdiff("--csv --column pressure=46 " + expected + " " + changed).status == 0);
+		CHECK(proxdiff("--csv --column 1=46 " + expected + " " + changed).status == 1);
+		CHECK(proxdiff("--csv --column pressure=40 " + expected + " " + changed).status == 1);
+		CHECK(proxdiff("--csv --column temperature=46 " + expected + " " + changed).status == 2);
+		CHECK(proxdiff("--csv --column 0=46 " + expected + " " + changed).status == 2);
+	}
+
+	SUBCASE("extra fields")
+	{
+		std::string actual = text;
+		actual.insert(actual.find("\nz"), ",extra");
+		outcome o = proxdiff("--csv " + expected + " " + write_text("fields.csv", actual));
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"shape_mismatches\": 1, \"first_mismatch\": {\"line\": 3, \"column\": 3},"));
+		o = proxdiff("--csv " + path("fields.csv") + " " + expected);
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"shape_mismatches\": 1,"));
+	}
+
+	SUBCASE("extra lines")
+	{
+		outcome o = proxdiff("--csv " + expected + " " + write_text("lines.csv", text + "w,1,2\n"));
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"lines\": 5, \"fields\": 12,"));
+		CHECK(contains(o, "\"shape_mismatches\": 1, \"first_mismatch\": {\"line\": 5, \"column\": 0},"));
+		o = proxdiff("--csv " + path("lines.csv") + " " + expected);
+		CHECK(o.status == 1);
+		CHECK(contains(o, "\"shape_mismatches\": 1,"));
+	}
+}
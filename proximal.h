@@ -26,8 +26,21 @@ SOFTWARE.
 #define guard_utils_proximal_h
 
 #include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
 #include <assert.h>
 
+#if defined(__has_include)
+#if __has_include(<bit>)
+#include <bit>
+#endif
+#endif
+
 namespace utils
 {
 	/*
@@ -56,14 +69,139 @@ namespace utils
 	template<class T, int N>
 	static constexpr int exponent_limit = min_implicit_exponent<T> + N;
 
+	/*
+	 *	With C++20 std::bit_cast, the bitwise specializations, ulp, margin and
+	 *	the proximal comparisons are constexpr, so tolerances can be computed
+	 *	and checked at compile time, e.g.
+	 *
+	 *		static_assert(utils::proximal<1>{}(0.1, 1.0 - 0.9), "");
+	 *
+	 *	At run time they compile to the same code as before. With earlier
+	 *	standards, __PROXIMAL_CONSTEXPR__ expands to nothing.
+	 */
+
+	#if defined(__cpp_lib_bit_cast) && (__cpp_lib_bit_cast >= 201806L) && defined(__cpp_lib_is_constant_evaluated)
+	#define __PROXIMAL_HAS_CONSTEXPR__ 1
+	#define __PROXIMAL_CONSTEXPR__ constexpr
+	#else
+	#define __PROXIMAL_HAS_CONSTEXPR__ 0
+	#define __PROXIMAL_CONSTEXPR__
+	#endif
+
+	/*
+	 *	Bit casts between floating point values and their bit patterns. Before
+	 *	C++20 this is a memcpy, which is well defined (unlike reading the
+	 *	inactive member of a union) and which compilers reduce to a register
+	 *	move, so values stay in registers and loops over representations can
+	 *	be vectorized.
+	 */
+	template<class To, class From>
+	__PROXIMAL_CONSTEXPR__ inline To __bit_cast(const From& x)
+	{
+		static_assert(sizeof(To) == sizeof(From), "bit casts require types of the same size");
+		static_assert(std::is_trivially_copyable<To>::value && std::is_trivially_copyable<From>::value, "bit casts require trivially copyable types");
+	#if (__PROXIMAL_HAS_CONSTEXPR__)
+		return std::bit_cast<To>(x);
+	#else
+		To to;
+		// through void*, since To may have constructors (bits80) but is
+		// trivially copyable
+		std::memcpy(static_cast<void*>(&to), &x, sizeof(to));
+		return to;
+	#endif
+	}
+
+	template<class T>
+	__PROXIMAL_CONSTEXPR__ inline T __abs(T x)
+	{
+	#if (__PROXIMAL_HAS_CONSTEXPR__)
+		if (std::is_constant_evaluated())
+		{
+			return x < 0 ? -x : x;
+		}
+	#endif
+		return std::abs(x);
+	}
+
+	template<class T>
+	__PROXIMAL_CONSTEXPR__ inline bool __is_inf_or_nan(T x)
+	{
+	#if (__PROXIMAL_HAS_CONSTEXPR__)
+		if (std::is_constant_evaluated())
+		{
+			return !(x > -std::numeric_limits<T>::infinity() && x < std::numeric_limits<T>::infinity());
+		}
+	#endif
+		return std::isinf(x) || std::isnan(x);
+	}
+
+	template<class T>
+	__PROXIMAL_CONSTEXPR__ inline bool __is_nan(T x)
+	{
+	#if (__PROXIMAL_HAS_CONSTEXPR__)
+		if (std::is_constant_evaluated())
+		{
+			return x != x;
+		}
+	#endif
+		return std::isnan(x);
+	}
+
+	template<class T>
+	constexpr T __infinity()
+	{
+		return std::numeric_limits<T>::infinity();
+	}
+
+	/*
+	 *	IEEE 754 quadruple precision (binary128), where the compiler provides
+	 *	__float128 and 128-bit integers. Neither std::numeric_limits nor the
+	 *	<cmath> classification functions support __float128, so the helpers
+	 *	above are overloaded to work on its bits, and the format is handled
+	 *	only by the bitwise specialization below; there is no generic path.
+	 */
+
+	#if defined(__SIZEOF_FLOAT128__) && defined(__SIZEOF_INT128__)
+	#define __PROXIMAL_HAS_FLOAT128__ 1
+	#else
+	#define __PROXIMAL_HAS_FLOAT128__ 0
+	#endif
+
+	#if (__PROXIMAL_HAS_FLOAT128__)
+
+	using bits128 = unsigned __int128;
+
+	__PROXIMAL_CONSTEXPR__ inline __float128 __abs(__float128 x)
+	{
+		return __bit_cast<__float128>(__bit_cast<bits128>(x) & ~(bits128{1} << 127));
+	}
+
+	__PROXIMAL_CONSTEXPR__ inline bool __is_inf_or_nan(__float128 x)
+	{
+		return (__bit_cast<bits128>(x) & ~(bits128{1} << 127)) >= bits128{0x7FFF} << 112;
+	}
+
+	__PROXIMAL_CONSTEXPR__ inline bool __is_nan(__float128 x)
+	{
+		return (__bit_cast<bits128>(x) & ~(bits128{1} << 127)) > bits128{0x7FFF} << 112;
+	}
+
+	template<>
+	constexpr __float128 __infinity<__float128>()
+	{
+		return static_cast<__float128>(std::numeric_limits<double>::infinity());
+	}
+
+	#endif // __PROXIMAL_HAS_FLOAT128__
+
 	template<class T>
-	static inline T exp2i(int exp)
+	static __PROXIMAL_CONSTEXPR__ inline T exp2i(int exp)
 	{
 		return exp2(static_cast<T>(exp));
 	}
 	
 	template<class T>
-	static inline int ilog2(T x)
+	static __PROXIMAL_CONSTEXPR__ inline int ilog2(T x)
 	{
 		return ilogb(x);
 	}
@@ -73,60 +211,83 @@ namespace utils
 	 *	double precision, and x86 extended precision. These implementations
 	 *	use bitwise operations rather than the library functions, and
 	 *	typically run about twice as fast as the generic implementations.
-	 *	Change the following defines to disable the specializations.
+	 *	Define any of the following as 0 (before including this header, or on
+	 *	the command line) to disable the corresponding specialization.
 	 */
 
+	#ifndef __USE_FLOAT_IEEE754_SPECIALIZATION__
 	#define __USE_FLOAT_IEEE754_SPECIALIZATION__ 1
+	#endif
+	#ifndef __USE_DOUBLE_IEEE754_SPECIALIZATION__
 	#define __USE_DOUBLE_IEEE754_SPECIALIZATION__ 1
+	#endif
+	#ifndef __USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__
 	#define __USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__ 1
+	#endif
 
-	#if (__USE_FLOAT_IEEE754_SPECIALIZATION__) || (__USE_DOUBLE_IEEE754_SPECIALIZATION__) || (__USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__)
+	/*
+	 *	The float and double specializations also provide a branchless
+	 *	comparison engine that works directly on the bit patterns of the
+	 *	operands (see within_margin() below). When this is set, proximal<N>
+	 *	uses it for float and double comparisons. Set it to 0 (here or on the
+	 *	command line) to select the ilog2/exp2i comparison instead.
+	 */
+
+	#ifndef __USE_INTEGER_DOMAIN_COMPARISON__
+	#define __USE_INTEGER_DOMAIN_COMPARISON__ 1
+	#endif
 
 	template<class T>
 	int count_leading_zeros(T u) = delete;
 
-	inline int count_leading_zeros(std::uint32_t u)
+	/*
+	 *	Leading zero counts for the denormal path of ilogb() and for
+	 *	ulp_histogram, using the native instructions (lzcnt, or bsr) through
+	 *	std::countl_zero or the compiler builtins. count_leading_zeros(0) is
+	 *	the width of the argument.
+	 */
+
+	__PROXIMAL_CONSTEXPR__ inline int count_leading_zeros(std::uint32_t u)
 	{
-		if (u == 0) return sizeof(u) * 8; // __builtin_clz(0) is undefined in some implementations
-	#if defined(__has_builtin) && __has_builtin(__builtin_clz)
-		return __builtin_clz(u);
+	#if (__PROXIMAL_HAS_CONSTEXPR__)
+		return std::countl_zero(u);
+	#elif defined(__GNUC__) || defined(__clang__)
+		return u == 0 ? 32 : __builtin_clz(u); // __builtin_clz(0) is undefined
 	#else
-		unsigned n = 0;
-		int i = reinterpret_cast<std::int32_t&>(u);
-		while (1) {
-			if (i < 0) break;
+		int n = 0;
+		for (std::uint32_t bit = std::uint32_t{1} << 31; bit != 0 && !(u & bit); bit >>= 1)
+		{
 			n ++;
-			i <<= 1;
 		}
 		return n;
 	#endif
 	}
 	
-	inline int count_leading_zeros(std::uint64_t u)
+	__PROXIMAL_CONSTEXPR__ inline int count_leading_zeros(std::uint64_t u)
 	{
-		if (u == 0) return sizeof(u) * 8; // __builtin_clz(0) is undefined in some implementations
-	#if defined(__has_builtin) && __has_builtin(__builtin_clz)
-		using bitwords = std::uint32_t[2];
-		bitwords& words = reinterpret_cast<bitwords&>(u);
-		if (words[1] != 0)
-		{
-			return __builtin_clz(words[0]) + 32;
-		}
-		else
-		{
-			return __builtin_clz(words[1]);
-		}
+	#if (__PROXIMAL_HAS_CONSTEXPR__)
+		return std::countl_zero(u);
+	#elif defined(__GNUC__) || defined(__clang__)
+		return u == 0 ? 64 : __builtin_clzll(u); // __builtin_clzll(0) is undefined
 	#else
-		unsigned n = 0;
-		int i = reinterpret_cast<std::int64_t&>(u);
-		while (1) {
-			if (i < 0) break;
+		int n = 0;
+		for (std::uint64_t bit = std::uint64_t{1} << 63; bit != 0 && !(u & bit); bit >>= 1)
+		{
 			n ++;
-			i <<= 1;
 		}
 		return n;
 	#endif
 	}
+
+	#if (__PROXIMAL_HAS_FLOAT128__)
+
+	__PROXIMAL_CONSTEXPR__ inline int count_leading_zeros(bits128 u)
+	{
+		std::uint64_t high = static_cast<std::uint64_t>(u >> 64);
+		return high != 0 ? count_leading_zeros(high) : 64 + count_leading_zeros(static_cast<std::uint64_t>(u));
+	}
+
+	#endif // __PROXIMAL_HAS_FLOAT128__
 	
 	template<class T, class S, class U>
 	class __representation
@@ -150,8 +311,6 @@ namespace utils
 	using bits16 = std::uint16_t;
 	using bits32 = std::uint32_t;
 	using bits64 = std::uint64_t;
-	
-	#endif // (__USE_FLOAT_IEEE754_SPECIALIZATION__) || (__USE_DOUBLE_IEEE754_SPECIALIZATION__) || (__USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__)
 
 	#if (__USE_FLOAT_IEEE754_SPECIALIZATION__)
 
@@ -159,61 +318,71 @@ namespace utils
 	class __representation<float, bits32, bits32>
 	{
 	public:
-		inline __representation()
+		__PROXIMAL_CONSTEXPR__ inline __representation()
 		:
-		data_{}
+		bits_{0}
 		{}
 		
-		inline __representation(float x)
+		__PROXIMAL_CONSTEXPR__ inline __representation(float x)
 		:
-		data_{x}
+		bits_{__bit_cast<bits32>(x)}
 		{}
 
-		inline __representation(bits32 u)
+		__PROXIMAL_CONSTEXPR__ inline __representation(bits32 u)
 		:
-		data_{u}
+		bits_{u}
 		{}
 		
-		inline __representation(int exp, bits32 sig)
+		__PROXIMAL_CONSTEXPR__ inline __representation(int exp, bits32 sig)
 		:
-		data_{exp, sig}
+		bits_{ ((static_cast<bits32>(exp + exp_bias) << exp_shift) & exp_mask) | (sig & sig_mask)}
 		{}
 		
-		inline float value() const
+		__PROXIMAL_CONSTEXPR__ inline float value() const
 		{
-			return data_.value_;
+			return __bit_cast<float>(bits_);
 		}
 		
-		inline int exponent() const
+		__PROXIMAL_CONSTEXPR__ inline int exponent() const
 		{
-			return static_cast<int>((data_.bits_ & exp_mask) >> exp_shift) - exp_bias;
+			return static_cast<int>((bits_ & exp_mask) >> exp_shift) - exp_bias;
 		}
 		
-		inline bits32 significand() const
+		__PROXIMAL_CONSTEXPR__ inline bits32 significand() const
 		{
-			return data_.bits_ & sig_mask;
+			return bits_ & sig_mask;
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bits32 bits() const
+		{
+			return bits_;
 		}
 		
-		inline float exp2(int exp)
+		__PROXIMAL_CONSTEXPR__ inline float exp2(int exp)
 		{
 			if (exp < min_explicit_exponent<float>)
 			{
-				data_.bits_ = sig_integer_bit >> (min_explicit_exponent<float> - exp);
-				return data_.value_;
+				bits_ = sig_integer_bit >> std::min(min_explicit_exponent<float> - exp, 31);
+				return value();
+			}
+			else if (exp > max_explicit_exponent<float>)
+			{
+				bits_ = exp_mask;
+				return value();
 			}
 			else
 			{
-				data_.bits_ = (static_cast<bits32>(exp + exp_bias) << exp_shift) & exp_mask;
-				return data_.value_;
+				bits_ = (static_cast<bits32>(exp + exp_bias) << exp_shift) & exp_mask;
+				return value();
 			}
 		}
 		
-		inline int ilogb() const
+		__PROXIMAL_CONSTEXPR__ inline int ilogb() const
 		{
 			int exp = exponent();
 			if (exp == -exp_bias) // denormalized
 			{
-				return exp - (count_leading_zeros(data_.bits_ & sig_mask) - sig_offset);
+				return exp - (count_leading_zeros(bits_ & sig_mask) - sig_offset);
 			}
 			else
 			{
@@ -221,9 +390,52 @@ namespace utils
 			}
 		}
 		
-		inline void negate()
+		__PROXIMAL_CONSTEXPR__ inline void negate()
+		{
+			bits_ = __bit_cast<bits32>(- value());
+		}
+
+		/*
+		 *	Position among the representable values: zero for both zeros, one
+		 *	step per value, negative for negative values, and infinity one step
+		 *	past the largest finite value.
+		 */
+		__PROXIMAL_CONSTEXPR__ inline std::int64_t ordinal() const
 		{
-			data_.value_ = - data_.value_;
+			std::int64_t position = static_cast<std::int64_t>(bits_ & magnitude_mask);
+			std::int64_t sign = -static_cast<std::int64_t>(bits_ >> 31);
+			return (position ^ sign) - sign;
+		}
+
+		/*
+		 *	Branchless comparison in the integer domain. Both operands are
+		 *	folded to their magnitude bits, so a single unsigned max picks the
+		 *	larger magnitude and a single mask test classifies Inf and NaN.
+		 *	The margin is assembled from the exponent field of the larger
+		 *	magnitude: with E = max(exponent field, 1), the biased exponent of
+		 *	the margin is E - fractional_digits + n, which reproduces the
+		 *	exponent_limit clamp for denormals without counting leading zeros.
+		 *	If that exponent is not positive, the margin is itself denormal
+		 *	(or, for negative n, 0) and is built by shifting the integer bit,
+		 *	by no more than the width of the bits. Only the final
+		 *	subtraction is done in floating point, so the result is identical
+		 *	to the ilog2/exp2i comparison, including the rules for signed
+		 *	zeros, denormals, infinities and NaN.
+		 */
+		static __PROXIMAL_CONSTEXPR__ inline bool within_margin(float a, float b, int n)
+		{
+			bits32 mag_a = __representation{a}.bits() & magnitude_mask;
+			bits32 mag_b = __representation{b}.bits() & magnitude_mask;
+			bool finite = (mag_a < exp_mask) & (mag_b < exp_mask);
+			bits32 mag_max = mag_a > mag_b ? mag_a : mag_b;
+			int exp_field = static_cast<int>(mag_max >> exp_shift);
+			exp_field = exp_field > 1 ? exp_field : 1;
+			int margin_exp = exp_field - fractional_digits<float> + n;
+			margin_exp = margin_exp < exp_field_max ? margin_exp : exp_field_max;
+			bits32 margin_bits = margin_exp > 0
+				? static_cast<bits32>(margin_exp) << exp_shift
+				: sig_integer_bit >> std::min(1 - margin_exp, 31);
+			return (a == b) | (finite & (__abs(a - b) <= __representation{margin_bits}.value()));
 		}
 
 	private:
@@ -233,35 +445,10 @@ namespace utils
 		static constexpr bits32 exp_mask = 0x7F800000;
 		static constexpr bits32 sig_mask = 0x007FFFFF;
 		static constexpr bits32 sig_integer_bit = 0x00800000;
-	
-		union data
-		{
-			inline data()
-			:
-			bits_{0}
-			{}
-			
-			inline data(float x)
-			:
-			value_{x}
-			{}
-
-			inline data(bits32 u)
-			:
-			bits_{u}
-			{}
+		static constexpr bits32 magnitude_mask = 0x7FFFFFFF;
+		static constexpr int exp_field_max = 0xFF;
 
-			inline data(int exp, bits32 sig)
-			:
-			bits_{ ((static_cast<bits32>(exp + exp_bias) << exp_shift) & exp_mask) | (sig & sig_mask)}
-			{}
-			
-			inline ~data()
-			{}
-		
-			bits32 bits_;
-			float value_;
-		} data_;
+		bits32 bits_;
 	};
 	
 	template<>
@@ -270,35 +457,35 @@ namespace utils
 	public:
 		using base = __representation<float, bits32, bits32>;
 	
-		inline representation()
+		__PROXIMAL_CONSTEXPR__ inline representation()
 		:
 		base{}
 		{}
 		
-		inline representation(float x)
+		__PROXIMAL_CONSTEXPR__ inline representation(float x)
 		:
 		base{x}
 		{}
 
-		inline representation(bits32 u)
+		__PROXIMAL_CONSTEXPR__ inline representation(bits32 u)
 		:
 		base{u}
 		{}
 		
-		inline representation(int exp, bits32 sig)
+		__PROXIMAL_CONSTEXPR__ inline representation(int exp, bits32 sig)
 		:
 		base{exp, sig}
 		{}
 	};
 	
 	template<>
-	inline float exp2i<float>(int exp)
+	__PROXIMAL_CONSTEXPR__ inline float exp2i<float>(int exp)
 	{
 		return representation<float>{}.exp2(exp);
 	}
 
 	template<>
-	inline int ilog2<float>(float x)
+	__PROXIMAL_CONSTEXPR__ inline int ilog2<float>(float x)
 	{
 		return representation<float>{x}.ilogb();
 	}
@@ -311,61 +498,71 @@ namespace utils
 	class __representation<double, bits64, bits64>
 	{
 	public:
-		inline __representation()
+		__PROXIMAL_CONSTEXPR__ inline __representation()
 		:
-		data_{}
+		bits_{0}
 		{}
 		
-		inline __representation(double x)
+		__PROXIMAL_CONSTEXPR__ inline __representation(double x)
 		:
-		data_{x}
+		bits_{__bit_cast<bits64>(x)}
 		{}
 
-		inline __representation(bits64 u)
+		__PROXIMAL_CONSTEXPR__ inline __representation(bits64 u)
 		:
-		data_{u}
+		bits_{u}
 		{}
 		
-		inline __representation(int exp, bits64 sig)
+		__PROXIMAL_CONSTEXPR__ inline __representation(int exp, bits64 sig)
 		:
-		data_{exp, sig}
+		bits_{ ((static_cast<bits64>(exp + exp_bias) << exp_shift) & exp_mask) | (sig & sig_mask)}
 		{}
 		
-		inline double value() const
+		__PROXIMAL_CONSTEXPR__ inline double value() const
 		{
-			return data_.value_;
+			return __bit_cast<double>(bits_);
 		}
 		
-		inline int exponent() const
+		__PROXIMAL_CONSTEXPR__ inline int exponent() const
 		{
-			return static_cast<int>((data_.bits_ & exp_mask) >> exp_shift) - exp_bias;
+			return static_cast<int>((bits_ & exp_mask) >> exp_shift) - exp_bias;
 		}
 		
-		inline bits64 significand() const
+		__PROXIMAL_CONSTEXPR__ inline bits64 significand() const
+		{
+			return bits_ & sig_mask;
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bits64 bits() const
 		{
-			return data_.bits_ & sig_mask;
+			return bits_;
 		}
 		
-		inline double exp2(int exp)
+		__PROXIMAL_CONSTEXPR__ inline double exp2(int exp)
 		{
 			if (exp < min_explicit_exponent<double>)
 			{
-				data_.bits_ = sig_integer_bit >> (min_explicit_exponent<double> - exp);
-				return data_.value_;
+				bits_ = sig_integer_bit >> std::min(min_explicit_exponent<double> - exp, 63);
+				return value();
+			}
+			else if (exp > max_explicit_exponent<double>)
+			{
+				bits_ = exp_mask;
+				return value();
 			}
 			else
 			{
-				data_.bits_ = (static_cast<bits64>(exp + exp_bias) << exp_shift) & exp_mask;
-				return data_.value_;
+				bits_ = (static_cast<bits64>(exp + exp_bias) << exp_shift) & exp_mask;
+				return value();
 			}
 		}
-	
-		inline int ilogb() const
+		
+		__PROXIMAL_CONSTEXPR__ inline int ilogb() const
 		{
 			int exp = exponent();
 			if (exp == -exp_bias) // denormalized
 			{
-				return exp - (count_leading_zeros(data_.bits_ & sig_mask) - sig_offset);
+				return exp - (count_leading_zeros(bits_ & sig_mask) - sig_offset);
 			}
 			else
 			{
@@ -373,11 +570,49 @@ namespace utils
 			}
 		}
 		
-		inline void negate()
+		__PROXIMAL_CONSTEXPR__ inline void negate()
 		{
-			data_.value_ = - data_.value_;
+			bits_ = __bit_cast<bits64>(- value());
 		}
-	
+
+		__PROXIMAL_CONSTEXPR__ inline std::int64_t ordinal() const
+		{
+			std::int64_t position = static_cast<std::int64_t>(bits_ & magnitude_mask);
+			std::int64_t sign = -static_cast<std::int64_t>(bits_ >> 63);
+			return (position ^ sign) - sign;
+		}
+
+		/*
+		 *	Branchless comparison in the integer domain. Both operands are
+		 *	folded to their magnitude bits, so a single unsigned max picks the
+		 *	larger magnitude and a single mask test classifies Inf and NaN.
+		 *	The margin is assembled from the exponent field of the larger
+		 *	magnitude: with E = max(exponent field, 1), the biased exponent of
+		 *	the margin is E - fractional_digits + n, which reproduces the
+		 *	exponent_limit clamp for denormals without counting leading zeros.
+		 *	If that exponent is not positive, the margin is itself denormal
+		 *	(or, for negative n, 0) and is built by shifting the integer bit,
+		 *	by no more than the width of the bits. Only the final
+		 *	subtraction is done in floating point, so the result is identical
+		 *	to the ilog2/exp2i comparison, including the rules for signed
+		 *	zeros, denormals, infinities and NaN.
+		 */
+		static __PROXIMAL_CONSTEXPR__ inline bool within_margin(double a, double b, int n)
+		{
+			bits64 mag_a = __representation{a}.bits() & magnitude_mask;
+			bits64 mag_b = __representation{b}.bits() & magnitude_mask;
+			bool finite = (mag_a < exp_mask) & (mag_b < exp_mask);
+			bits64 mag_max = mag_a > mag_b ? mag_a : mag_b;
+			int exp_field = static_cast<int>(mag_max >> exp_shift);
+			exp_field = exp_field > 1 ? exp_field : 1;
+			int margin_exp = exp_field - fractional_digits<double> + n;
+			margin_exp = margin_exp < exp_field_max ? margin_exp : exp_field_max;
+			bits64 margin_bits = margin_exp > 0
+				? static_cast<bits64>(margin_exp) << exp_shift
+				: sig_integer_bit >> std::min(1 - margin_exp, 63);
+			return (a == b) | (finite & (__abs(a - b) <= __representation{margin_bits}.value()));
+		}
+
 	private:
 		static constexpr int exp_bias = 1023;
 		static constexpr int exp_shift = 52;
@@ -385,166 +620,144 @@ namespace utils
 		static constexpr bits64 exp_mask = 0x7FF0000000000000;
 		static constexpr bits64 sig_mask = 0x000FFFFFFFFFFFFF;
 		static constexpr bits64 sig_integer_bit = 0x0010000000000000;
-		
-		union data
-		{
-			inline data()
-			:
-			bits_{0}
-			{}
-			
-			inline data(double x)
-			:
-			value_{x}
-			{}
+		static constexpr bits64 magnitude_mask = 0x7FFFFFFFFFFFFFFF;
+		static constexpr int exp_field_max = 0x7FF;
 
-			inline data(bits64 u)
-			:
-			bits_{u}
-			{}
-
-			inline data(int exp, bits64 sig)
-			:
-			bits_{ ((static_cast<bits64>(exp + exp_bias) << exp_shift) & exp_mask) | (sig & sig_mask)}
-			{}
-			
-			inline ~data()
-			{}
-		
-			bits64 bits_;
-			double value_;
-		} data_;
-	
+		bits64 bits_;
 	};
-
+	
 	template<>
 	class representation<double> : public __representation<double, bits64, bits64>
 	{
 	public:
 		using base = __representation<double, bits64, bits64>;
 	
-		inline representation()
+		__PROXIMAL_CONSTEXPR__ inline representation()
 		:
 		base{}
 		{}
 		
-		inline representation(double x)
+		__PROXIMAL_CONSTEXPR__ inline representation(double x)
 		:
 		base{x}
 		{}
 
-		inline representation(bits64 u)
+		__PROXIMAL_CONSTEXPR__ inline representation(bits64 u)
 		:
 		base{u}
 		{}
 		
-		inline representation(int exp, bits64 sig)
+		__PROXIMAL_CONSTEXPR__ inline representation(int exp, bits64 sig)
 		:
 		base{exp, sig}
 		{}
 	};
-
+	
 	template<>
-	inline double exp2i<double>(int exp)
+	__PROXIMAL_CONSTEXPR__ inline double exp2i<double>(int exp)
 	{
 		return representation<double>{}.exp2(exp);
 	}
 
 	template<>
-	inline int ilog2<double>(double x)
+	__PROXIMAL_CONSTEXPR__ inline int ilog2<double>(double x)
 	{
 		return representation<double>{x}.ilogb();
 	}
-
+	
 	#endif // __USE_DOUBLE_IEEE754_SPECIALIZATION__
 
 	#if (__USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__)
 
 	struct bits80
 	{
-		bits80(const bits80& rhs)
-		:
-		low{rhs.low},
-		high{rhs.high}
-		{}
-		
-		bits80(bits16 hi, bits64 lo)
+		__PROXIMAL_CONSTEXPR__ bits80(bits16 hi, bits64 lo)
 		:
 		low{lo},
-		high{hi}
+		high{hi},
+		padding{}
 		{}
 		
-		bits80()
+		__PROXIMAL_CONSTEXPR__ bits80()
 		:
 		low{0},
-		high{0}
+		high{0},
+		padding{}
 		{}
 		
 		bits64 low;
 		bits16 high;
+		unsigned char padding[sizeof(long double) - sizeof(bits64) - sizeof(bits16)]; // explicit, so that bit casts to long double are fully initialized
 	};
 
 	template<>
 	class __representation<long double, bits64, bits80>
 	{
 	public:
-		inline __representation()
+		__PROXIMAL_CONSTEXPR__ inline __representation()
 		:
-		data_{}
+		bits_{}
 		{}
 		
-		inline __representation(long double x)
+		__PROXIMAL_CONSTEXPR__ inline __representation(long double x)
 		:
-		data_{x}
+		bits_{__bit_cast<bits80>(x)}
 		{}
 
-		inline __representation(const bits80& u)
+		__PROXIMAL_CONSTEXPR__ inline __representation(const bits80& u)
 		:
-		data_{u}
+		bits_{u}
 		{}
 		
-		inline __representation(int exp, std::uint64_t sig)
+		// denormals have the minimum exponent and a clear integer bit, and are encoded with a zero exponent field
+		__PROXIMAL_CONSTEXPR__ inline __representation(int exp, std::uint64_t sig)
 		:
-		data_{exp, sig}
+		bits_{static_cast<bits16>((exp == min_explicit_exponent<long double> && !(sig & sig_integer_bit)) ? 0 : static_cast<bits16>(exp + exp_bias) & exp_mask), sig}
 		{}
 		
-		inline long double value() const
+		__PROXIMAL_CONSTEXPR__ inline long double value() const
 		{
-			return data_.value_;
+			return __bit_cast<long double>(bits_);
 		}
 		
-		inline int exponent() const
+		__PROXIMAL_CONSTEXPR__ inline int exponent() const
 		{
-			return static_cast<int>((data_.bits_.high & exp_mask) >> exp_shift) - exp_bias;
+			return static_cast<int>((bits_.high & exp_mask) >> exp_shift) - exp_bias;
 		}
 		
-		inline std::uint64_t significand() const
+		__PROXIMAL_CONSTEXPR__ inline std::uint64_t significand() const
 		{
-			return data_.bits_.low & sig_mask;
+			return bits_.low & sig_mask;
 		}
 		
-		inline long double exp2(int exp)
+		__PROXIMAL_CONSTEXPR__ inline long double exp2(int exp)
 		{
 			if (exp < min_explicit_exponent<long double>)
 			{
-				data_.bits_.high = 0;
-				data_.bits_.low = sig_integer_bit >> (min_explicit_exponent<long double> - exp);
-				return data_.value_;
+				bits_.high = 0;
+				bits_.low = min_explicit_exponent<long double> - exp < 64 ? sig_integer_bit >> (min_explicit_exponent<long double> - exp) : 0;
+				return value();
+			}
+			else if (exp > max_explicit_exponent<long double>)
+			{
+				bits_.high = exp_mask;
+				bits_.low = sig_integer_bit;
+				return value();
 			}
 			else
 			{
-				data_.bits_.high = static_cast<bits16>(exp + exp_bias) & exp_mask;
-				data_.bits_.low = sig_integer_bit;
-				return data_.value_;
+				bits_.high = static_cast<bits16>(exp + exp_bias) & exp_mask;
+				bits_.low = sig_integer_bit;
+				return value();
 			}
 		}
 		
-		inline int ilogb() const
+		__PROXIMAL_CONSTEXPR__ inline int ilogb() const
 		{
 			int exp = exponent();
 			if (exp == -exp_bias) // denormalized
 			{
-				return exp - (count_leading_zeros(data_.bits_.low & sig_mask) - sig_offset);
+				return exp - (count_leading_zeros(bits_.low & sig_mask) - sig_offset);
 			}
 			else
 			{
@@ -552,10 +765,27 @@ namespace utils
 			}
 		}
 
-		inline void negate()
+		__PROXIMAL_CONSTEXPR__ inline void negate()
 		{
-			data_.value_ = - data_.value_;
+			bits_ = __bit_cast<bits80>(- value());
 		}
+
+	#if defined(__SIZEOF_INT128__)
+
+		/*
+		 *	Positions need 79 bits. A zero exponent field holds denormals (and
+		 *	pseudo-denormals, whose integer bit is set) at their significand.
+		 */
+		__PROXIMAL_CONSTEXPR__ inline __int128 ordinal() const
+		{
+			bits16 exp_field = bits_.high & exp_mask;
+			__int128 position = exp_field == 0
+				? static_cast<__int128>(bits_.low)
+				: (static_cast<__int128>(exp_field) << 63) + static_cast<__int128>(bits_.low & ~sig_integer_bit);
+			return (bits_.high & ~exp_mask) ? -position : position;
+		}
+
+	#endif
 	
 	private:
 		static constexpr int exp_bias = 16383;
@@ -565,35 +795,7 @@ namespace utils
 		static constexpr bits64 sig_mask = 0xFFFFFFFFFFFFFFFF;
 		static constexpr bits64 sig_integer_bit = 0x8000000000000000;
 	
-		union data
-		{
-			inline data()
-			:
-			bits_{}
-			{}
-			
-			inline data(long double x)
-			:
-			value_{x}
-			{}
-
-			inline data(const bits80& u)
-			:
-			bits_{u}
-			{}
-
-			inline data(int exp, bits64 sig)
-			:
-			bits_{static_cast<bits16>(static_cast<bits16>(exp + exp_bias) & exp_mask), sig}
-			{}
-			
-			inline ~data()
-			{}
-		
-			bits80 bits_;
-			long double value_;
-		} data_;
-	
+		bits80 bits_;
 	};
 
 	template<>
@@ -602,196 +804,2284 @@ namespace utils
 	public:
 		using base = __representation<long double, bits64, bits80>;
 	
-		inline representation()
+		__PROXIMAL_CONSTEXPR__ inline representation()
 		:
 		base{}
 		{}
 		
-		inline representation(long double x)
+		__PROXIMAL_CONSTEXPR__ inline representation(long double x)
 		:
 		base{x}
 		{}
 
-		inline representation(const bits80& u)
+		__PROXIMAL_CONSTEXPR__ inline representation(const bits80& u)
 		:
 		base{u}
 		{}
 		
-		inline representation(int exp, std::uint64_t sig)
+		__PROXIMAL_CONSTEXPR__ inline representation(int exp, std::uint64_t sig)
 		:
 		base{exp, sig}
 		{}
 	};
 	
 	template<>
-	inline long double exp2i<long double>(int exp)
+	__PROXIMAL_CONSTEXPR__ inline long double exp2i<long double>(int exp)
 	{
 		return representation<long double>{}.exp2(exp);
 	}
 
 	template<>
-	inline int ilog2<long double>(long double x)
+	__PROXIMAL_CONSTEXPR__ inline int ilog2<long double>(long double x)
 	{
 		return representation<long double>{x}.ilogb();
 	}
 	
 	#endif // __USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__
-	
-	template<class T>
-	static inline T ulp(T x)
-	{
-		if (isinf(x) || isnan(x))
-		{
-			return static_cast<T>(0.0);
-		}
-		else
-		{
-			return exp2i<T>(std::max(ilog2(x) - fractional_precision<T, 0>, exponent_limit<T, 0>));
-		}
-	}
-	
-	template<int N, class T>
-	static inline T margin(T x)
+
+	#if (__PROXIMAL_HAS_FLOAT128__)
+
+	template<>
+	constexpr int fractional_digits<__float128> = 112;
+
+	template<>
+	constexpr int min_explicit_exponent<__float128> = -16382;
+
+	template<>
+	constexpr int max_explicit_exponent<__float128> = 16383;
+
+	/*
+	 *	binary128 has the layout of double with a 15-bit exponent and a 112-bit
+	 *	fraction, and is handled in the same way on unsigned __int128 bits. The
+	 *	arithmetic of __float128 is done in software, so avoiding it matters
+	 *	even more than for double: only the final subtraction of
+	 *	within_margin() is done in floating point.
+	 */
+	template<>
+	class __representation<__float128, bits128, bits128>
 	{
-		if (isinf(x) || isnan(x))
+	public:
+		__PROXIMAL_CONSTEXPR__ inline __representation()
+		:
+		bits_{0}
+		{}
+		
+		__PROXIMAL_CONSTEXPR__ inline __representation(__float128 x)
+		:
+		bits_{__bit_cast<bits128>(x)}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline __representation(bits128 u)
+		:
+		bits_{u}
+		{}
+		
+		__PROXIMAL_CONSTEXPR__ inline __representation(int exp, bits128 sig)
+		:
+		bits_{ ((static_cast<bits128>(exp + exp_bias) << exp_shift) & exp_mask) | (sig & sig_mask)}
+		{}
+		
+		__PROXIMAL_CONSTEXPR__ inline __float128 value() const
 		{
-			return static_cast<T>(0.0);
+			return __bit_cast<__float128>(bits_);
 		}
-		else
+		
+		__PROXIMAL_CONSTEXPR__ inline int exponent() const
 		{
-			return exp2i<T>(std::max(ilog2(x) - fractional_precision<T, N>, exponent_limit<T, N>));
+			return static_cast<int>((bits_ & exp_mask) >> exp_shift) - exp_bias;
 		}
-	}
-
-	template<int N = 1>
-	class proximal
-	{
-	private:
-	
-		template<class T>
-		static inline T _ulp(T x)
+		
+		__PROXIMAL_CONSTEXPR__ inline bits128 significand() const
 		{
-			T exp_ulp_x = ilog2(x) - fractional_precision<T, 0>;
-			return exp2i<T>(exp_ulp_x > exponent_limit<T, 0> ? exp_ulp_x : exponent_limit<T, 0>);
+			return bits_ & sig_mask;
 		}
 
-		template<class T>
-		static inline T _margin(T x)
+		__PROXIMAL_CONSTEXPR__ inline bits128 bits() const
 		{
-			int margin_exp = ilog2(x) - fractional_precision<T, N>;
-			return exp2i<T>(margin_exp > exponent_limit<T, N> ? margin_exp : exponent_limit<T, N>);
+			return bits_;
 		}
-	
-		template<class T>
-		static inline bool _within_margin(T a, T b)
+		
+		__PROXIMAL_CONSTEXPR__ inline __float128 exp2(int exp)
 		{
-			if (a == b)
+			if (exp < min_explicit_exponent<__float128>)
 			{
-				return true;
+				bits_ = sig_integer_bit >> std::min(min_explicit_exponent<__float128> - exp, 127);
+				return value();
 			}
-			
-			if (isinf(a) || isinf(b) || isnan(a) || isnan(b))
+			else if (exp > max_explicit_exponent<__float128>)
 			{
-				return false;
+				bits_ = exp_mask;
+				return value();
+			}
+			else
+			{
+				bits_ = (static_cast<bits128>(exp + exp_bias) << exp_shift) & exp_mask;
+				return value();
 			}
- 			return std::abs(a - b) <= _margin(std::max(std::abs(a), std::abs(b)));
 		}
 		
-	public:
-	
-		inline float ulp(float x) const
+		__PROXIMAL_CONSTEXPR__ inline int ilogb() const
 		{
-			if (isinf(x) || isnan(x))
+			int exp = exponent();
+			if (exp == -exp_bias) // denormalized
 			{
-				return static_cast<float>(0.0);
+				return exp - (count_leading_zeros(bits_ & sig_mask) - sig_offset);
 			}
-			if (x == 0.0)
+			else
 			{
-				return exp2i<float>(exponent_limit<float, 0>);
+				return exp;
 			}
-			return _ulp(x);
 		}
-	
-		inline double ulp(double x) const
+		
+		__PROXIMAL_CONSTEXPR__ inline void negate()
 		{
-			if (isinf(x) || isnan(x))
-			{
-				return static_cast<double>(0.0);
-			}
-			if (x == 0.0)
-			{
-				return exp2i<double>(exponent_limit<double, 0>);
+			bits_ ^= sign_bit;
+		}
+
+		/*
+		 *	Positions need 128 bits, as for the x87 format.
+		 */
+		__PROXIMAL_CONSTEXPR__ inline __int128 ordinal() const
+		{
+			__int128 position = static_cast<__int128>(bits_ & magnitude_mask);
+			return (bits_ & sign_bit) ? -position : position;
+		}
+
+		/*
+		 *	The integer domain comparison of double (see there).
+		 */
+		static __PROXIMAL_CONSTEXPR__ inline bool within_margin(__float128 a, __float128 b, int n)
+		{
+			bits128 mag_a = __representation{a}.bits() & magnitude_mask;
+			bits128 mag_b = __representation{b}.bits() & magnitude_mask;
+			bool finite = (mag_a < exp_mask) & (mag_b < exp_mask);
+			bits128 mag_max = mag_a > mag_b ? mag_a : mag_b;
+			int exp_field = static_cast<int>(mag_max >> exp_shift);
+			exp_field = exp_field > 1 ? exp_field : 1;
+			int margin_exp = exp_field - fractional_digits<__float128> + n;
+			margin_exp = margin_exp < exp_field_max ? margin_exp : exp_field_max;
+			bits128 margin_bits = margin_exp > 0
+				? static_cast<bits128>(margin_exp) << exp_shift
+				: sig_integer_bit >> std::min(1 - margin_exp, 127);
+			return (a == b) | (finite & (__abs(a - b) <= __representation{margin_bits}.value()));
+		}
+
+	private:
+		static constexpr int exp_bias = 16383;
+		static constexpr int exp_shift = 112;
+		static constexpr int sig_offset = 16;
+		static constexpr bits128 exp_mask = bits128{0x7FFF} << 112;
+		static constexpr bits128 sig_mask = (bits128{1} << 112) - 1;
+		static constexpr bits128 sig_integer_bit = bits128{1} << 112;
+		static constexpr bits128 sign_bit = bits128{1} << 127;
+		static constexpr bits128 magnitude_mask = sign_bit - 1;
+		static constexpr int exp_field_max = 0x7FFF;
+
+		bits128 bits_;
+	};
+	
+	template<>
+	class representation<__float128> : public __representation<__float128, bits128, bits128>
+	{
+	public:
+		using base = __representation<__float128, bits128, bits128>;
+	
+		__PROXIMAL_CONSTEXPR__ inline representation()
+		:
+		base{}
+		{}
+		
+		__PROXIMAL_CONSTEXPR__ inline representation(__float128 x)
+		:
+		base{x}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline representation(bits128 u)
+		:
+		base{u}
+		{}
+		
+		__PROXIMAL_CONSTEXPR__ inline representation(int exp, bits128 sig)
+		:
+		base{exp, sig}
+		{}
+	};
+	
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline __float128 exp2i<__float128>(int exp)
+	{
+		return representation<__float128>{}.exp2(exp);
+	}
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline int ilog2<__float128>(__float128 x)
+	{
+		return representation<__float128>{x}.ilogb();
+	}
+
+	#endif // __PROXIMAL_HAS_FLOAT128__
+
+	/*
+	 *	IEEE 754 half precision (binary16). utils::half is _Float16 where the
+	 *	compiler provides it, and otherwise a 16-bit storage type with explicit
+	 *	conversions to and from float. proximal never does arithmetic in half:
+	 *	values are classified by their bit patterns and widened exactly to float,
+	 *	so both forms give identical results. There is no generic path for half,
+	 *	so this does not depend on the specialization switches.
+	 */
+
+	/*
+	 *	Exact conversion of half bits to float. Half denormals are normal as
+	 *	floats, and are normalized with a leading zero count.
+	 */
+	__PROXIMAL_CONSTEXPR__ inline float __half_bits_to_float(bits16 h)
+	{
+		bits32 sign = static_cast<bits32>(h & 0x8000) << 16;
+		int exp_field = (h >> 10) & 0x1F;
+		bits32 sig = h & 0x03FF;
+		if (exp_field == 0x1F)
+		{
+			return __bit_cast<float>(sign | 0x7F800000 | (sig << 13));
+		}
+		if (exp_field == 0)
+		{
+			if (sig == 0)
+			{
+				return __bit_cast<float>(sign);
+			}
+			int shift = count_leading_zeros(sig) - 21;
+			sig <<= shift;
+			exp_field = 1 - shift;
+		}
+		return __bit_cast<float>(sign | (static_cast<bits32>(exp_field + 112) << 23) | ((sig & 0x03FF) << 13));
+	}
+
+	/*
+	 *	Conversion of float to half bits, rounding to nearest even.
+	 */
+	__PROXIMAL_CONSTEXPR__ inline bits16 __float_to_half_bits(float x)
+	{
+		bits32 f = __bit_cast<bits32>(x);
+		bits16 sign = static_cast<bits16>((f >> 16) & 0x8000);
+		bits32 mag = f & 0x7FFFFFFF;
+		if (mag > 0x7F800000) // NaN, kept quiet
+		{
+			return static_cast<bits16>(sign | 0x7E00 | ((mag >> 13) & 0x03FF));
+		}
+		if (mag >= 0x477FF000) // at least 65520, which rounds to infinity
+		{
+			return static_cast<bits16>(sign | 0x7C00);
+		}
+		if (mag <= 0x33000000) // at most 2^-25, which rounds to zero
+		{
+			return sign;
+		}
+		bits32 result;
+		bits32 rest;
+		bits32 halfway;
+		if (mag < 0x38800000) // denormal as a half: a multiple of 2^-24
+		{
+			int shift = 126 - static_cast<int>(mag >> 23);
+			bits32 sig = (mag & 0x007FFFFF) | 0x00800000;
+			result = sig >> shift;
+			rest = sig & ((bits32{1} << shift) - 1);
+			halfway = bits32{1} << (shift - 1);
+		}
+		else
+		{
+			bits32 rebiased = mag - (bits32{112} << 23);
+			result = rebiased >> 13;
+			rest = rebiased & 0x1FFF;
+			halfway = 0x1000;
+		}
+		// a carry out of the significand correctly increments the exponent
+		result += (rest > halfway) | ((rest == halfway) & (result & 1));
+		return static_cast<bits16>(sign | result);
+	}
+
+	#if defined(__FLT16_MANT_DIG__)
+
+	#define __PROXIMAL_HAS_FLOAT16__ 1
+
+	using half = _Float16;
+
+	#else
+
+	#define __PROXIMAL_HAS_FLOAT16__ 0
+
+	struct half
+	{
+		bits16 bits;
+
+		half() = default;
+
+		explicit __PROXIMAL_CONSTEXPR__ inline half(float x)
+		:
+		bits{__float_to_half_bits(x)}
+		{}
+
+		explicit __PROXIMAL_CONSTEXPR__ inline operator float() const
+		{
+			return __half_bits_to_float(bits);
+		}
+	};
+
+	#endif // defined(__FLT16_MANT_DIG__)
+
+	// std::numeric_limits is not specialized for _Float16
+	template<>
+	constexpr int fractional_digits<half> = 10;
+
+	template<>
+	constexpr int min_explicit_exponent<half> = -14;
+
+	template<>
+	constexpr int max_explicit_exponent<half> = 15;
+
+	template<>
+	class __representation<half, bits16, bits16>
+	{
+	public:
+		__PROXIMAL_CONSTEXPR__ inline __representation()
+		:
+		bits_{0}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline __representation(half x)
+		:
+		bits_{__bit_cast<bits16>(x)}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline __representation(bits16 u)
+		:
+		bits_{u}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline __representation(int exp, bits16 sig)
+		:
+		bits_{static_cast<bits16>(((static_cast<bits16>(exp + exp_bias) << exp_shift) & exp_mask) | (sig & sig_mask))}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline half value() const
+		{
+			return __bit_cast<half>(bits_);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline int exponent() const
+		{
+			return static_cast<int>((bits_ & exp_mask) >> exp_shift) - exp_bias;
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bits16 significand() const
+		{
+			return bits_ & sig_mask;
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bits16 bits() const
+		{
+			return bits_;
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline float to_float() const
+		{
+			return __half_bits_to_float(bits_);
+		}
+
+		/*
+		 *	As for the wider formats, exponents past the largest finite value
+		 *	give infinity, which margins for moderate N already reach in half.
+		 */
+		__PROXIMAL_CONSTEXPR__ inline half exp2(int exp)
+		{
+			if (exp < min_explicit_exponent<half>)
+			{
+				bits_ = static_cast<bits16>(sig_integer_bit >> std::min(min_explicit_exponent<half> - exp, 15));
+			}
+			else if (exp > max_explicit_exponent<half>)
+			{
+				bits_ = exp_mask;
+			}
+			else
+			{
+				bits_ = static_cast<bits16>(exp + exp_bias) << exp_shift;
+			}
+			return value();
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline int ilogb() const
+		{
+			int exp = exponent();
+			if (exp == -exp_bias) // denormalized
+			{
+				return exp - (count_leading_zeros(static_cast<bits32>(bits_ & sig_mask)) - sig_offset);
+			}
+			else
+			{
+				return exp;
+			}
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline void negate()
+		{
+			bits_ ^= sign_bit;
+		}
+
+		/*
+		 *	Position among the representable values, as for float.
+		 */
+		__PROXIMAL_CONSTEXPR__ inline std::int64_t ordinal() const
+		{
+			std::int64_t position = static_cast<std::int64_t>(bits_ & magnitude_mask);
+			std::int64_t sign = -static_cast<std::int64_t>(bits_ >> 15);
+			return (position ^ sign) - sign;
+		}
+
+		/*
+		 *	The margin of x for exponent n (the ulp for n = 0), from the
+		 *	exponent field as in within_margin() below; zero for Inf and NaN.
+		 */
+		static __PROXIMAL_CONSTEXPR__ inline half margin(half x, int n)
+		{
+			int exp_field = (__representation{x}.bits() & exp_mask) >> exp_shift;
+			if (exp_field == exp_field_max)
+			{
+				return __representation{}.value();
+			}
+			exp_field = exp_field > 1 ? exp_field : 1;
+			return __representation{}.exp2(exp_field - exp_bias - fractional_digits<half> + n);
+		}
+
+		/*
+		 *	The comparison of float, on the operands widened to float: the
+		 *	margin is 2^(max(E, 1) - exp_bias - fractional_digits + n) for the
+		 *	exponent field E of the larger magnitude, infinite when that is past
+		 *	the range of half, and the difference is taken in float. The batch
+		 *	kernels evaluate exactly the same expression.
+		 */
+		static __PROXIMAL_CONSTEXPR__ inline bool within_margin(half a, half b, int n)
+		{
+			bits16 bits_a = __representation{a}.bits();
+			bits16 bits_b = __representation{b}.bits();
+			bits16 mag_a = bits_a & magnitude_mask;
+			bits16 mag_b = bits_b & magnitude_mask;
+			bool finite = (mag_a < exp_mask) & (mag_b < exp_mask);
+			bits16 mag_max = mag_a > mag_b ? mag_a : mag_b;
+			int exp_field = mag_max >> exp_shift;
+			exp_field = exp_field > 1 ? exp_field : 1;
+			int margin_exp = exp_field - exp_bias - fractional_digits<half> + n;
+			float margin = margin_exp > max_explicit_exponent<half>
+				? std::numeric_limits<float>::infinity()
+				: __bit_cast<float>(margin_exp > -127
+					? static_cast<bits32>(margin_exp + 127) << 23
+					: bits32{0x00400000} >> std::min(-127 - margin_exp, 31));
+			float fa = __half_bits_to_float(bits_a);
+			float fb = __half_bits_to_float(bits_b);
+			return (fa == fb) | (finite & (__abs(fa - fb) <= margin));
+		}
+
+	private:
+		static constexpr int exp_bias = 15;
+		static constexpr int exp_shift = 10;
+		static constexpr int sig_offset = 22;
+		static constexpr bits16 exp_mask = 0x7C00;
+		static constexpr bits16 sig_mask = 0x03FF;
+		static constexpr bits16 sig_integer_bit = 0x0400;
+		static constexpr bits16 sign_bit = 0x8000;
+		static constexpr bits16 magnitude_mask = 0x7FFF;
+		static constexpr int exp_field_max = 0x1F;
+
+		bits16 bits_;
+	};
+
+	template<>
+	class representation<half> : public __representation<half, bits16, bits16>
+	{
+	public:
+		using base = __representation<half, bits16, bits16>;
+
+		__PROXIMAL_CONSTEXPR__ inline representation()
+		:
+		base{}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline representation(half x)
+		:
+		base{x}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline representation(bits16 u)
+		:
+		base{u}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline representation(int exp, bits16 sig)
+		:
+		base{exp, sig}
+		{}
+	};
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline half exp2i<half>(int exp)
+	{
+		return representation<half>{}.exp2(exp);
+	}
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline int ilog2<half>(half x)
+	{
+		return representation<half>{x}.ilogb();
+	}
+
+	/*
+	 *	bfloat16: the upper half of a float, with its 8-bit exponent and a 7-bit
+	 *	fraction. utils::bfloat16 is a 16-bit storage type with explicit
+	 *	conversions to and from float; as for half, values are classified by
+	 *	their bit patterns and widened exactly to float, so margins are counted
+	 *	in bfloat16 ulps while the arithmetic runs at float speed.
+	 */
+
+	/*
+	 *	Conversion of float to bfloat16 bits, rounding to nearest even.
+	 */
+	__PROXIMAL_CONSTEXPR__ inline bits16 __float_to_bfloat16_bits(float x)
+	{
+		bits32 f = __bit_cast<bits32>(x);
+		if ((f & 0x7FFFFFFF) > 0x7F800000) // NaN, kept quiet
+		{
+			return static_cast<bits16>((f >> 16) | 0x0040);
+		}
+		// a carry out of the significand correctly increments the exponent
+		return static_cast<bits16>((f + 0x7FFF + ((f >> 16) & 1)) >> 16);
+	}
+
+	struct bfloat16
+	{
+		bits16 bits;
+
+		bfloat16() = default;
+
+		explicit __PROXIMAL_CONSTEXPR__ inline bfloat16(float x)
+		:
+		bits{__float_to_bfloat16_bits(x)}
+		{}
+
+		explicit __PROXIMAL_CONSTEXPR__ inline operator float() const
+		{
+			return __bit_cast<float>(static_cast<bits32>(bits) << 16);
+		}
+	};
+
+	template<>
+	constexpr int fractional_digits<bfloat16> = 7;
+
+	template<>
+	constexpr int min_explicit_exponent<bfloat16> = -126;
+
+	template<>
+	constexpr int max_explicit_exponent<bfloat16> = 127;
+
+	template<>
+	class __representation<bfloat16, bits16, bits16>
+	{
+	public:
+		__PROXIMAL_CONSTEXPR__ inline __representation()
+		:
+		bits_{0}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline __representation(bfloat16 x)
+		:
+		bits_{x.bits}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline __representation(bits16 u)
+		:
+		bits_{u}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline __representation(int exp, bits16 sig)
+		:
+		bits_{static_cast<bits16>(((static_cast<bits16>(exp + exp_bias) << exp_shift) & exp_mask) | (sig & sig_mask))}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline bfloat16 value() const
+		{
+			return __bit_cast<bfloat16>(bits_);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline int exponent() const
+		{
+			return static_cast<int>((bits_ & exp_mask) >> exp_shift) - exp_bias;
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bits16 significand() const
+		{
+			return bits_ & sig_mask;
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bits16 bits() const
+		{
+			return bits_;
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline float to_float() const
+		{
+			return __bit_cast<float>(static_cast<bits32>(bits_) << 16);
+		}
+
+		/*
+		 *	As for half, exponents past the largest finite value give infinity.
+		 */
+		__PROXIMAL_CONSTEXPR__ inline bfloat16 exp2(int exp)
+		{
+			if (exp < min_explicit_exponent<bfloat16>)
+			{
+				bits_ = static_cast<bits16>(sig_integer_bit >> std::min(min_explicit_exponent<bfloat16> - exp, 15));
+			}
+			else if (exp > max_explicit_exponent<bfloat16>)
+			{
+				bits_ = exp_mask;
+			}
+			else
+			{
+				bits_ = static_cast<bits16>(exp + exp_bias) << exp_shift;
+			}
+			return value();
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline int ilogb() const
+		{
+			int exp = exponent();
+			if (exp == -exp_bias) // denormalized
+			{
+				return exp - (count_leading_zeros(static_cast<bits32>(bits_ & sig_mask)) - sig_offset);
+			}
+			else
+			{
+				return exp;
+			}
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline void negate()
+		{
+			bits_ ^= sign_bit;
+		}
+
+		/*
+		 *	Position among the representable values, as for float.
+		 */
+		__PROXIMAL_CONSTEXPR__ inline std::int64_t ordinal() const
+		{
+			std::int64_t position = static_cast<std::int64_t>(bits_ & magnitude_mask);
+			std::int64_t sign = -static_cast<std::int64_t>(bits_ >> 15);
+			return (position ^ sign) - sign;
+		}
+
+		/*
+		 *	The margin of x for exponent n (the ulp for n = 0); zero for Inf
+		 *	and NaN.
+		 */
+		static __PROXIMAL_CONSTEXPR__ inline bfloat16 margin(bfloat16 x, int n)
+		{
+			int exp_field = (x.bits & exp_mask) >> exp_shift;
+			if (exp_field == exp_field_max)
+			{
+				return __representation{}.value();
+			}
+			exp_field = exp_field > 1 ? exp_field : 1;
+			return __representation{}.exp2(exp_field - exp_bias - fractional_digits<bfloat16> + n);
+		}
+
+		/*
+		 *	The comparison of half, with the exponent range of float: the
+		 *	margin is 2^(max(E, 1) - exp_bias - fractional_digits + n), infinite
+		 *	past the range of float, and the difference is taken in float. The
+		 *	batch kernels are those of float, with this margin.
+		 */
+		static __PROXIMAL_CONSTEXPR__ inline bool within_margin(bfloat16 a, bfloat16 b, int n)
+		{
+			bits16 mag_a = a.bits & magnitude_mask;
+			bits16 mag_b = b.bits & magnitude_mask;
+			bool finite = (mag_a < exp_mask) & (mag_b < exp_mask);
+			bits16 mag_max = mag_a > mag_b ? mag_a : mag_b;
+			int exp_field = mag_max >> exp_shift;
+			exp_field = exp_field > 1 ? exp_field : 1;
+			int margin_exp = exp_field - exp_bias - fractional_digits<bfloat16> + n;
+			float margin = margin_exp > max_explicit_exponent<bfloat16>
+				? std::numeric_limits<float>::infinity()
+				: __bit_cast<float>(margin_exp > -127
+					? static_cast<bits32>(margin_exp + 127) << 23
+					: bits32{0x00400000} >> std::min(-127 - margin_exp, 31));
+			float fa = static_cast<float>(a);
+			float fb = static_cast<float>(b);
+			return (fa == fb) | (finite & (__abs(fa - fb) <= margin));
+		}
+
+	private:
+		static constexpr int exp_bias = 127;
+		static constexpr int exp_shift = 7;
+		static constexpr int sig_offset = 25;
+		static constexpr bits16 exp_mask = 0x7F80;
+		static constexpr bits16 sig_mask = 0x007F;
+		static constexpr bits16 sig_integer_bit = 0x0080;
+		static constexpr bits16 sign_bit = 0x8000;
+		static constexpr bits16 magnitude_mask = 0x7FFF;
+		static constexpr int exp_field_max = 0xFF;
+
+		bits16 bits_;
+	};
+
+	template<>
+	class representation<bfloat16> : public __representation<bfloat16, bits16, bits16>
+	{
+	public:
+		using base = __representation<bfloat16, bits16, bits16>;
+
+		__PROXIMAL_CONSTEXPR__ inline representation()
+		:
+		base{}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline representation(bfloat16 x)
+		:
+		base{x}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline representation(bits16 u)
+		:
+		base{u}
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline representation(int exp, bits16 sig)
+		:
+		base{exp, sig}
+		{}
+	};
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline bfloat16 exp2i<bfloat16>(int exp)
+	{
+		return representation<bfloat16>{}.exp2(exp);
+	}
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline int ilog2<bfloat16>(bfloat16 x)
+	{
+		return representation<bfloat16>{x}.ilogb();
+	}
+	
+	template<class T>
+	static __PROXIMAL_CONSTEXPR__ inline T ulp(T x)
+	{
+		if (__is_inf_or_nan(x))
+		{
+			return static_cast<T>(0.0);
+		}
+		else
+		{
+			return exp2i<T>(std::max(ilog2(x) - fractional_precision<T, 0>, exponent_limit<T, 0>));
+		}
+	}
+	
+	template<int N, class T>
+	static __PROXIMAL_CONSTEXPR__ inline T margin(T x)
+	{
+		if (__is_inf_or_nan(x))
+		{
+			return static_cast<T>(0.0);
+		}
+		else
+		{
+			return exp2i<T>(std::max(ilog2(x) - fractional_precision<T, N>, exponent_limit<T, N>));
+		}
+	}
+
+	/*
+	 *	Margins by table. For float and double, margin<N>(x) depends only on
+	 *	the exponent field of x: denormals and the smallest normal binade share
+	 *	the smallest margin, and Inf and NaN have none. A table of the bit
+	 *	patterns of the margins, indexed by the exponent field, is built at
+	 *	compile time for each N, so that ulp() and margin<N>() are a shift, a
+	 *	mask and a load, without the branches of ilog2() and exp2i(). (The
+	 *	batch kernels build margins from the exponent field with vector
+	 *	instructions instead.) Margins past the range of the type are
+	 *	infinite, and margins below the smallest denormal (for negative N)
+	 *	are 0. The tables depend on the IEEE 754 layout, so they are only
+	 *	used along with the bitwise specialization of the type; set the
+	 *	following define to 0 to compute the margins with ilog2() and exp2i()
+	 *	regardless.
+	 */
+
+	#ifndef __USE_EXPONENT_TABLES__
+	#define __USE_EXPONENT_TABLES__ 1
+	#endif
+
+	#if (__USE_EXPONENT_TABLES__)
+
+	template<class U, int FractionalDigits, int ExponentBits, int N>
+	struct __exponent_table
+	{
+		static constexpr int size = 1 << ExponentBits;
+		static constexpr int bias = size / 2 - 1;
+
+		U entries[size];
+
+		constexpr __exponent_table()
+		:
+		entries{}
+		{
+			for (int e = 0; e < size - 1; ++e)
+			{
+				int k = (e > 1 ? e : 1) - bias - FractionalDigits + N;
+				entries[e] = k + bias >= size - 1 ? static_cast<U>(size - 1) << FractionalDigits
+					: k > -bias ? static_cast<U>(k + bias) << FractionalDigits
+					: k + bias - 1 + FractionalDigits >= 0 ? U{1} << (k + bias - 1 + FractionalDigits)
+					: U{0};
+			}
+		}
+	};
+
+	#if (__USE_FLOAT_IEEE754_SPECIALIZATION__)
+
+	template<int N>
+	struct __float_margins
+	{
+		static constexpr __exponent_table<bits32, 23, 8, N> table{};
+	};
+
+	template<int N>
+	constexpr __exponent_table<bits32, 23, 8, N> __float_margins<N>::table;
+
+	template<int N>
+	static __PROXIMAL_CONSTEXPR__ inline float __table_margin(float x)
+	{
+		return __bit_cast<float>(__float_margins<N>::table.entries[(__bit_cast<bits32>(x) >> 23) & 0xFF]);
+	}
+
+	static __PROXIMAL_CONSTEXPR__ inline float ulp(float x)
+	{
+		return __table_margin<0>(x);
+	}
+
+	template<int N>
+	static __PROXIMAL_CONSTEXPR__ inline float margin(float x)
+	{
+		return __table_margin<N>(x);
+	}
+
+	#endif // __USE_FLOAT_IEEE754_SPECIALIZATION__
+
+	#if (__USE_DOUBLE_IEEE754_SPECIALIZATION__)
+
+	template<int N>
+	struct __double_margins
+	{
+		static constexpr __exponent_table<bits64, 52, 11, N> table{};
+	};
+
+	template<int N>
+	constexpr __exponent_table<bits64, 52, 11, N> __double_margins<N>::table;
+
+	template<int N>
+	static __PROXIMAL_CONSTEXPR__ inline double __table_margin(double x)
+	{
+		return __bit_cast<double>(__double_margins<N>::table.entries[(__bit_cast<bits64>(x) >> 52) & 0x7FF]);
+	}
+
+	static __PROXIMAL_CONSTEXPR__ inline double ulp(double x)
+	{
+		return __table_margin<0>(x);
+	}
+
+	template<int N>
+	static __PROXIMAL_CONSTEXPR__ inline double margin(double x)
+	{
+		return __table_margin<N>(x);
+	}
+
+	#endif // __USE_DOUBLE_IEEE754_SPECIALIZATION__
+
+	#endif // __USE_EXPONENT_TABLES__
+
+	static __PROXIMAL_CONSTEXPR__ inline half ulp(half x)
+	{
+		return representation<half>::margin(x, 0);
+	}
+
+	template<int N>
+	static __PROXIMAL_CONSTEXPR__ inline half margin(half x)
+	{
+		return representation<half>::margin(x, N);
+	}
+
+	static __PROXIMAL_CONSTEXPR__ inline bfloat16 ulp(bfloat16 x)
+	{
+		return representation<bfloat16>::margin(x, 0);
+	}
+
+	template<int N>
+	static __PROXIMAL_CONSTEXPR__ inline bfloat16 margin(bfloat16 x)
+	{
+		return representation<bfloat16>::margin(x, N);
+	}
+
+	/*
+	 *	b - a, clamped to the range of std::int64_t. The overflow test is
+	 *	rarely true, unlike tests of the signs of a and b.
+	 */
+	static __PROXIMAL_CONSTEXPR__ inline std::int64_t __saturating_difference(std::int64_t a, std::int64_t b)
+	{
+	#if defined(__GNUC__) || defined(__clang__)
+		std::int64_t difference = 0;
+		if (__builtin_sub_overflow(b, a, &difference))
+		{
+			return a < 0 ? std::numeric_limits<std::int64_t>::max() : std::numeric_limits<std::int64_t>::min();
+		}
+		return difference;
+	#else
+		if (a < 0 && b > std::numeric_limits<std::int64_t>::max() + a)
+		{
+			return std::numeric_limits<std::int64_t>::max();
+		}
+		if (a > 0 && b < std::numeric_limits<std::int64_t>::min() + a)
+		{
+			return std::numeric_limits<std::int64_t>::min();
+		}
+		return b - a;
+	#endif
+	}
+
+	/*
+	 *	Generic positions among the representable values of T (see
+	 *	representation<float>::ordinal()): the position of a magnitude is
+	 *	(exp - min_explicit_exponent) * 2^fractional_digits + scaled, where
+	 *	exp is its exponent clamped to the normal range and scaled its value
+	 *	times 2^(fractional_digits - exp), an integer. Infinity is the value
+	 *	2^(max_explicit_exponent + 1).
+	 */
+	template<class T>
+	static inline void __position(T mag, int& exp, long double& scaled)
+	{
+		if (std::isinf(mag))
+		{
+			exp = max_explicit_exponent<T> + 1;
+			scaled = std::ldexp(1.0L, fractional_digits<T>);
+		}
+		else
+		{
+			exp = std::max(ilog2(mag), min_explicit_exponent<T>);
+			scaled = std::ldexp(static_cast<long double>(mag), fractional_digits<T> - exp);
+		}
+	}
+
+	template<class T>
+	static inline std::int64_t __generic_ulp_distance(T a, T b)
+	{
+		if (std::isnan(a) || std::isnan(b))
+		{
+			return std::numeric_limits<std::int64_t>::max();
+		}
+		int exp_a, exp_b;
+		long double scaled_a, scaled_b;
+		__position(std::abs(a), exp_a, scaled_a);
+		__position(std::abs(b), exp_b, scaled_b);
+		bool negative_a = std::signbit(a) && a != 0;
+		bool negative_b = std::signbit(b) && b != 0;
+		// the parts are exact, and so is the sum whenever it fits in 64 bits
+		// with an x87 or quad long double
+		long double distance;
+		if (negative_a == negative_b)
+		{
+			distance = std::ldexp(static_cast<long double>(exp_b - exp_a), fractional_digits<T>) + (scaled_b - scaled_a);
+			distance = negative_a ? -distance : distance;
+		}
+		else
+		{
+			distance = std::ldexp(static_cast<long double>(exp_a + exp_b - 2 * min_explicit_exponent<T>), fractional_digits<T>) + (scaled_a + scaled_b);
+			distance = negative_b ? -distance : distance;
+		}
+		const long double limit = std::ldexp(1.0L, 63);
+		return distance >= limit ? std::numeric_limits<std::int64_t>::max()
+			: distance <= -limit ? std::numeric_limits<std::int64_t>::min()
+			: static_cast<std::int64_t>(distance);
+	}
+
+	/*
+	 *	The signed number of representable values from a to b: positive if
+	 *	b > a, one for neighbouring values (e.g. the largest finite value and
+	 *	infinity), and zero for equal values, including zeros of opposite sign,
+	 *	which count as a single value. Results beyond the range of
+	 *	std::int64_t saturate, and NaN operands give its maximum.
+	 */
+	template<class T>
+	static inline std::int64_t ulp_distance(T a, T b)
+	{
+		return __generic_ulp_distance(a, b);
+	}
+
+	#if (__USE_FLOAT_IEEE754_SPECIALIZATION__)
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline std::int64_t ulp_distance<float>(float a, float b)
+	{
+		if (__is_nan(a) || __is_nan(b))
+		{
+			return std::numeric_limits<std::int64_t>::max();
+		}
+		return representation<float>{b}.ordinal() - representation<float>{a}.ordinal();
+	}
+
+	#endif // __USE_FLOAT_IEEE754_SPECIALIZATION__
+
+	#if (__USE_DOUBLE_IEEE754_SPECIALIZATION__)
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline std::int64_t ulp_distance<double>(double a, double b)
+	{
+		if (__is_nan(a) || __is_nan(b))
+		{
+			return std::numeric_limits<std::int64_t>::max();
+		}
+		return __saturating_difference(representation<double>{a}.ordinal(), representation<double>{b}.ordinal());
+	}
+
+	#endif // __USE_DOUBLE_IEEE754_SPECIALIZATION__
+
+	#if (__USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__) && defined(__SIZEOF_INT128__)
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline std::int64_t ulp_distance<long double>(long double a, long double b)
+	{
+		if (__is_nan(a) || __is_nan(b))
+		{
+			return std::numeric_limits<std::int64_t>::max();
+		}
+		__int128 distance = representation<long double>{b}.ordinal() - representation<long double>{a}.ordinal();
+		return distance > std::numeric_limits<std::int64_t>::max() ? std::numeric_limits<std::int64_t>::max()
+			: distance < std::numeric_limits<std::int64_t>::min() ? std::numeric_limits<std::int64_t>::min()
+			: static_cast<std::int64_t>(distance);
+	}
+
+	#endif // (__USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__) && defined(__SIZEOF_INT128__)
+
+	#if (__PROXIMAL_HAS_FLOAT128__)
+
+	/*
+	 *	Ordinals of opposite signs are clamped first, so that their difference
+	 *	cannot overflow; the result saturates all the same.
+	 */
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline std::int64_t ulp_distance<__float128>(__float128 a, __float128 b)
+	{
+		if (__is_nan(a) || __is_nan(b))
+		{
+			return std::numeric_limits<std::int64_t>::max();
+		}
+		__int128 position_a = representation<__float128>{a}.ordinal();
+		__int128 position_b = representation<__float128>{b}.ordinal();
+		if ((position_a < 0) != (position_b < 0))
+		{
+			const __int128 limit = __int128{1} << 64;
+			position_a = std::max(-limit, std::min(position_a, limit));
+			position_b = std::max(-limit, std::min(position_b, limit));
+		}
+		__int128 distance = position_b - position_a;
+		return distance > std::numeric_limits<std::int64_t>::max() ? std::numeric_limits<std::int64_t>::max()
+			: distance < std::numeric_limits<std::int64_t>::min() ? std::numeric_limits<std::int64_t>::min()
+			: static_cast<std::int64_t>(distance);
+	}
+
+	#endif // __PROXIMAL_HAS_FLOAT128__
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline std::int64_t ulp_distance<half>(half a, half b)
+	{
+		representation<half> ra{a};
+		representation<half> rb{b};
+		if ((ra.bits() & 0x7FFF) > 0x7C00 || (rb.bits() & 0x7FFF) > 0x7C00)
+		{
+			return std::numeric_limits<std::int64_t>::max();
+		}
+		return rb.ordinal() - ra.ordinal();
+	}
+
+	template<>
+	__PROXIMAL_CONSTEXPR__ inline std::int64_t ulp_distance<bfloat16>(bfloat16 a, bfloat16 b)
+	{
+		representation<bfloat16> ra{a};
+		representation<bfloat16> rb{b};
+		if ((ra.bits() & 0x7FFF) > 0x7F80 || (rb.bits() & 0x7FFF) > 0x7F80)
+		{
+			return std::numeric_limits<std::int64_t>::max();
+		}
+		return rb.ordinal() - ra.ordinal();
+	}
+
+	/*
+	 *	Statistics of a batch comparison, gathered in a single pass by the
+	 *	stats() members of proximal<N> and proximal_dynamic. The error of a
+	 *	pair is |a - b|: zero for equal pairs, and infinite where either is
+	 *	infinite or NaN. The error in ulps is the error divided by
+	 *	ulp(max(|a|, |b|)). Indices are npos when there is no such element.
+	 */
+	template<class T>
+	struct proximal_stats
+	{
+		static constexpr std::size_t npos = ~std::size_t{0};
+
+		std::size_t count = 0;
+		std::size_t mismatches = 0;
+		std::size_t first_mismatch = npos;
+		T max_error = 0;
+		T max_ulps = 0;
+		std::size_t worst = npos;
+
+		/*
+		 *	Fold in the statistics of another range of elements, e.g. another
+		 *	chunk of the same arrays. The result does not depend on the order
+		 *	in which chunks are merged: ties go to the lower index.
+		 */
+		inline void merge(const proximal_stats& other)
+		{
+			count += other.count;
+			mismatches += other.mismatches;
+			first_mismatch = std::min(first_mismatch, other.first_mismatch);
+			max_error = std::max(max_error, other.max_error);
+			if (other.max_ulps > max_ulps || (other.max_ulps == max_ulps && other.worst < worst))
+			{
+				max_ulps = other.max_ulps;
+				worst = other.worst;
+			}
+		}
+
+		/*
+		 *	Fold in the pair at index, in increasing index order.
+		 */
+		inline void add(std::size_t index, T a, T b, bool close)
+		{
+			add(index, a, b, close, ulp(std::max(__abs(a), __abs(b))));
+		}
+
+		/*
+		 *	As above, given the ulp of the larger magnitude, so that pairs of a
+		 *	narrower format widened to T are measured in their own ulps.
+		 */
+		inline void add(std::size_t index, T a, T b, bool close, T unit)
+		{
+			++count;
+			if (!close && mismatches++ == 0)
+			{
+				first_mismatch = index;
+			}
+			if (a == b)
+			{
+				return;
+			}
+			T error = __infinity<T>();
+			T ulps = error;
+			if (!__is_inf_or_nan(a) && !__is_inf_or_nan(b))
+			{
+				error = __abs(a - b);
+				ulps = error / unit;
+			}
+			max_error = std::max(max_error, error);
+			if (ulps > max_ulps)
+			{
+				max_ulps = ulps;
+				worst = index;
+			}
+		}
+	};
+
+	template<class T>
+	constexpr std::size_t proximal_stats<T>::npos;
+
+	/*
+	 *	How complex values are compared: componentwise requires the real parts
+	 *	and the imaginary parts each to be close enough; modulus requires
+	 *	|a - b| <= margin(max(|a|, |b|)), so that the tolerance of each part
+	 *	scales with the whole value rather than with the part alone.
+	 */
+	enum class complex_margin
+	{
+		componentwise,
+		modulus
+	};
+
+	/*
+	 *	The modulus comparison of a = ar + i ai and b = br + i bi, with
+	 *	scale = 2^(n - fractional digits). The parts are first scaled by
+	 *	2^-e, where 2^e is the exponent of the largest part (clamped to the
+	 *	smallest normal), so that their squares neither overflow nor lose
+	 *	precision to underflow. The margin then comes from the exponent of the
+	 *	scaled larger modulus, which is at least 2^0 except when every part is
+	 *	denormal, and the squared distance is compared with its square. Equal
+	 *	values are close, and otherwise parts that are infinite or NaN are
+	 *	close to nothing. The batch kernels evaluate the same operations in
+	 *	the same order, lane by lane.
+	 */
+	template<class T>
+	inline bool __close_modulus(T ar, T ai, T br, T bi, T scale)
+	{
+		const T inf = __infinity<T>();
+		const T min_normal = std::numeric_limits<T>::min();
+		T abs_ar = __abs(ar);
+		T abs_ai = __abs(ai);
+		T abs_br = __abs(br);
+		T abs_bi = __abs(bi);
+		bool equal = (ar == br) & (ai == bi);
+		if (!((abs_ar < inf) & (abs_ai < inf) & (abs_br < inf) & (abs_bi < inf)))
+		{
+			return equal;
+		}
+		T big = std::max(std::max(abs_ar, abs_ai), std::max(abs_br, abs_bi));
+		T pow = big > min_normal ? exp2i<T>(ilog2(big)) : min_normal;
+		T inv = static_cast<T>(1) / pow;
+		T sar = ar * inv;
+		T sai = ai * inv;
+		T sbr = br * inv;
+		T sbi = bi * inv;
+		T dr = (ar - br) * inv;
+		T di = (ai - bi) * inv;
+		T sa = sar * sar + sai * sai;
+		T sb = sbr * sbr + sbi * sbi;
+		T sd = dr * dr + di * di;
+		using std::sqrt;
+		T smag = sqrt(std::max(sa, sb));
+		T ms = (smag > static_cast<T>(1) ? exp2i<T>(ilog2(smag)) : static_cast<T>(1)) * scale;
+		return equal | (sd <= ms * ms);
+	}
+
+}
+
+#include "proximal_simd.h"
+
+namespace utils
+{
+	/*
+	 *	Complex comparisons (see complex_margin). Arrays of std::complex<T>
+	 *	are arrays of interleaved real and imaginary parts, so the
+	 *	componentwise batch forms run the ordinary kernels over the parts,
+	 *	and the modulus forms run kernels that split the parts in registers.
+	 */
+
+	template<class T>
+	inline const T* __parts(const std::complex<T>* z)
+	{
+		return reinterpret_cast<const T*>(z);
+	}
+
+	/*
+	 *	Bit k of the result is set if bit 2k or 2k + 1 of x is set.
+	 */
+	inline std::uint64_t __pair_bits(std::uint64_t x)
+	{
+		x = (x | (x >> 1)) & 0x5555555555555555;
+		x = (x | (x >> 1)) & 0x3333333333333333;
+		x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0F;
+		x = (x | (x >> 4)) & 0x00FF00FF00FF00FF;
+		x = (x | (x >> 8)) & 0x0000FFFF0000FFFF;
+		return (x | (x >> 16)) & 0x00000000FFFFFFFF;
+	}
+
+	/*
+	 *	Componentwise mismatches of complex values: the mismatch mask of the
+	 *	parts, a block at a time, with the bits of each value's two parts
+	 *	combined.
+	 */
+	template<class P, class T>
+	inline std::size_t __complex_mismatches(const P& close_enough, const std::complex<T>* a, const std::complex<T>* b, std::size_t count, std::uint64_t* mask)
+	{
+		constexpr std::size_t block = 2048;
+		std::uint64_t parts[2 * block / 64];
+		std::size_t total = 0;
+		for (std::size_t i = 0; i < count; i += block)
+		{
+			const std::size_t n = std::min(block, count - i);
+			const std::size_t words = (2 * n + 63) / 64;
+			close_enough.mismatches(__parts(a + i), __parts(b + i), 2 * n, parts);
+			for (std::size_t w = 0; w < (n + 63) / 64; ++w)
+			{
+				std::uint64_t high = 2 * w + 1 < words ? parts[2 * w + 1] : 0;
+				std::uint64_t word = __pair_bits(parts[2 * w]) | (__pair_bits(high) << 32);
+				mask[i / 64 + w] = word;
+				total += simd::__popcount(word);
+			}
+		}
+		return total;
+	}
+
+	template<class T>
+	inline bool __complex_all_close_modulus(const std::complex<T>* a, const std::complex<T>* b, std::size_t count, T scale)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if (!__close_modulus(a[i].real(), a[i].imag(), b[i].real(), b[i].imag(), scale))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template<class T>
+	inline std::size_t __complex_mismatches_modulus(const std::complex<T>* a, const std::complex<T>* b, std::size_t count, T scale, std::uint64_t* mask)
+	{
+		std::size_t total = 0;
+		for (std::size_t i = 0; i < count; i += 64)
+		{
+			std::uint64_t word = 0;
+			for (std::size_t j = 0; j < 64 && i + j < count; ++j)
+			{
+				word |= static_cast<std::uint64_t>(!__close_modulus(a[i + j].real(), a[i + j].imag(), b[i + j].real(), b[i + j].imag(), scale)) << j;
+			}
+			mask[i / 64] = word;
+			total += simd::__popcount(word);
+		}
+		return total;
+	}
+
+	/*
+	 *	Array forms of ulp and margin: result[i] = ulp(x[i]) or margin<N>(x[i]).
+	 *	Float and double arrays are processed by the SIMD kernels, which take the
+	 *	exponent field of each lane and rebuild the result from it, with zero
+	 *	for infinite and NaN lanes.
+	 */
+
+	template<class T>
+	static inline void ulp(const T* x, T* result, std::size_t count)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			result[i] = ulp(x[i]);
+		}
+	}
+
+	static inline void ulp(const float* x, float* result, std::size_t count)
+	{
+		simd::margins(x, result, count, 0);
+	}
+
+	static inline void ulp(const double* x, double* result, std::size_t count)
+	{
+		simd::margins(x, result, count, 0);
+	}
+
+	template<int N, class T>
+	static inline void margin(const T* x, T* result, std::size_t count)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			result[i] = margin<N>(x[i]);
+		}
+	}
+
+	template<int N>
+	static inline void margin(const float* x, float* result, std::size_t count)
+	{
+		simd::margins(x, result, count, N);
+	}
+
+	template<int N>
+	static inline void margin(const double* x, double* result, std::size_t count)
+	{
+		simd::margins(x, result, count, N);
+	}
+
+	template<int N = 1>
+	class proximal
+	{
+	private:
+	
+		template<class T>
+		static __PROXIMAL_CONSTEXPR__ inline T _ulp(T x)
+		{
+			int exp_ulp_x = ilog2(x) - fractional_precision<T, 0>;
+			return exp2i<T>(exp_ulp_x > exponent_limit<T, 0> ? exp_ulp_x : exponent_limit<T, 0>);
+		}
+
+		template<class T>
+		static __PROXIMAL_CONSTEXPR__ inline T _margin(T x)
+		{
+			int margin_exp = ilog2(x) - fractional_precision<T, N>;
+			return exp2i<T>(margin_exp > exponent_limit<T, N> ? margin_exp : exponent_limit<T, N>);
+		}
+	
+		template<class T>
+		static __PROXIMAL_CONSTEXPR__ inline bool _within_margin(T a, T b)
+		{
+			if (a == b)
+			{
+				return true;
+			}
+			
+			if (__is_inf_or_nan(a) || __is_inf_or_nan(b))
+			{
+				return false;
+			}
+ 			return __abs(a - b) <= _margin(std::max(__abs(a), __abs(b)));
+		}
+		
+	public:
+	
+		__PROXIMAL_CONSTEXPR__ inline float ulp(float x) const
+		{
+		#if (__USE_EXPONENT_TABLES__ && __USE_FLOAT_IEEE754_SPECIALIZATION__)
+			return __table_margin<0>(x);
+		#else
+			if (__is_inf_or_nan(x))
+			{
+				return static_cast<float>(0.0);
+			}
+			if (x == 0.0)
+			{
+				return exp2i<float>(exponent_limit<float, 0>);
+			}
+			return _ulp(x);
+		#endif
+		}
+	
+		__PROXIMAL_CONSTEXPR__ inline double ulp(double x) const
+		{
+		#if (__USE_EXPONENT_TABLES__ && __USE_DOUBLE_IEEE754_SPECIALIZATION__)
+			return __table_margin<0>(x);
+		#else
+			if (__is_inf_or_nan(x))
+			{
+				return static_cast<double>(0.0);
+			}
+			if (x == 0.0)
+			{
+				return exp2i<double>(exponent_limit<double, 0>);
+			}
+			return _ulp(x);
+		#endif
+		}
+	
+		__PROXIMAL_CONSTEXPR__ inline long double ulp(long double x) const
+		{
+			if (__is_inf_or_nan(x))
+			{
+				return static_cast<long double>(0.0);
+			}
+			if (x == 0.0)
+			{
+				return exp2i<long double>(exponent_limit<long double, 0>);
+			}
+			return _ulp(x);
+		}
+		
+		__PROXIMAL_CONSTEXPR__ inline float margin(float x) const
+		{
+		#if (__USE_EXPONENT_TABLES__ && __USE_FLOAT_IEEE754_SPECIALIZATION__)
+			return __table_margin<N>(x);
+		#else
+			if (__is_inf_or_nan(x))
+			{
+				return static_cast<float>(0.0);
+			}
+			if (x == 0.0)
+			{
+				return exp2i<float>(exponent_limit<float, N>);
+			}
+			return _margin(x);
+		#endif
+		}
+	
+		__PROXIMAL_CONSTEXPR__ inline double margin(double x) const
+		{
+		#if (__USE_EXPONENT_TABLES__ && __USE_DOUBLE_IEEE754_SPECIALIZATION__)
+			return __table_margin<N>(x);
+		#else
+			if (__is_inf_or_nan(x))
+			{
+				return static_cast<double>(0.0);
+			}
+			if (x == 0.0)
+			{
+				return exp2i<double>(exponent_limit<double, N>);
+			}
+			return _margin(x);
+		#endif
+		}
+	
+		__PROXIMAL_CONSTEXPR__ inline long double margin(long double x) const
+		{
+			if (__is_inf_or_nan(x))
+			{
+				return static_cast<long double>(0.0);
+			}
+			if (x == 0.0)
+			{
+				return exp2i<long double>(exponent_limit<long double, N>);
+			}
+			return _margin(x);
+		}
+	
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(float a, float b) const
+		{
+		#if (__USE_INTEGER_DOMAIN_COMPARISON__) && (__USE_FLOAT_IEEE754_SPECIALIZATION__)
+			return representation<float>::within_margin(a, b, N);
+		#else
+			return _within_margin(a, b);
+		#endif
+		}
+		
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(double a, double b) const
+		{
+		#if (__USE_INTEGER_DOMAIN_COMPARISON__) && (__USE_DOUBLE_IEEE754_SPECIALIZATION__)
+			return representation<double>::within_margin(a, b, N);
+		#else
+			return _within_margin(a, b);
+		#endif
+		}
+		
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(long double a, long double b) const
+		{
+			return _within_margin(a, b);
+		}
+		
+		/*
+		 *	Batch comparison of count pairs of elements, true if every pair is
+		 *	close enough. Float and double arrays are compared by the SIMD
+		 *	kernels of the best instruction set available at run time.
+		 */
+
+		inline bool all_close(const float* a, const float* b, std::size_t count) const
+		{
+			return simd::all_close(a, b, count, N);
+		}
+
+		inline bool all_close(const double* a, const double* b, std::size_t count) const
+		{
+			return simd::all_close(a, b, count, N);
+		}
+
+		inline bool all_close(const long double* a, const long double* b, std::size_t count) const
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if (!_within_margin(a[i], b[i]))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/*
+		 *	Batch comparison that records which pairs are not close enough: bit
+		 *	i % 64 of mask[i / 64] is set if a[i] and b[i] are not close enough.
+		 *	mask must hold (count + 63) / 64 words; unused bits of the last word
+		 *	are cleared. Returns the number of mismatches.
+		 */
+
+		inline std::size_t mismatches(const float* a, const float* b, std::size_t count, std::uint64_t* mask) const
+		{
+			return simd::mismatches(a, b, count, N, mask);
+		}
+
+		inline std::size_t mismatches(const double* a, const double* b, std::size_t count, std::uint64_t* mask) const
+		{
+			return simd::mismatches(a, b, count, N, mask);
+		}
+
+		inline std::size_t mismatches(const long double* a, const long double* b, std::size_t count, std::uint64_t* mask) const
+		{
+			std::size_t total = 0;
+			for (std::size_t i = 0; i < count; i += 64)
+			{
+				std::uint64_t word = 0;
+				for (std::size_t j = 0; j < 64 && i + j < count; ++j)
+				{
+					word |= static_cast<std::uint64_t>(!_within_margin(a[i + j], b[i + j])) << j;
+				}
+				mask[i / 64] = word;
+				total += simd::__popcount(word);
+			}
+			return total;
+		}
+
+		/*
+		 *	Mismatch count, first mismatch, maximum error and maximum error in
+		 *	ulps of count pairs, in one pass (see proximal_stats). Indices are
+		 *	reported from first_index, so that the statistics of chunks of
+		 *	larger arrays can be merged.
+		 */
+
+		inline proximal_stats<float> stats(const float* a, const float* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			return simd::stats(a, b, count, N, first_index);
+		}
+
+		inline proximal_stats<double> stats(const double* a, const double* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			return simd::stats(a, b, count, N, first_index);
+		}
+
+		inline proximal_stats<long double> stats(const long double* a, const long double* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			proximal_stats<long double> s;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				s.add(first_index + i, a[i], b[i], _within_margin(a[i], b[i]));
+			}
+			return s;
+		}
+
+	#if (__PROXIMAL_HAS_FLOAT128__)
+
+		/*
+		 *	__float128 values and arrays (see representation<__float128>).
+		 *	Arrays are compared one pair at a time, as for long double.
+		 */
+
+		__PROXIMAL_CONSTEXPR__ inline __float128 ulp(__float128 x) const
+		{
+			if (__is_inf_or_nan(x))
+			{
+				return static_cast<__float128>(0.0);
+			}
+			if (x == 0)
+			{
+				return exp2i<__float128>(exponent_limit<__float128, 0>);
+			}
+			return _ulp(x);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline __float128 margin(__float128 x) const
+		{
+			if (__is_inf_or_nan(x))
+			{
+				return static_cast<__float128>(0.0);
+			}
+			if (x == 0)
+			{
+				return exp2i<__float128>(exponent_limit<__float128, N>);
+			}
+			return _margin(x);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(__float128 a, __float128 b) const
+		{
+		#if (__USE_INTEGER_DOMAIN_COMPARISON__)
+			return representation<__float128>::within_margin(a, b, N);
+		#else
+			return _within_margin(a, b);
+		#endif
+		}
+
+		inline bool all_close(const __float128* a, const __float128* b, std::size_t count) const
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if (!(*this)(a[i], b[i]))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		inline std::size_t mismatches(const __float128* a, const __float128* b, std::size_t count, std::uint64_t* mask) const
+		{
+			std::size_t total = 0;
+			for (std::size_t i = 0; i < count; i += 64)
+			{
+				std::uint64_t word = 0;
+				for (std::size_t j = 0; j < 64 && i + j < count; ++j)
+				{
+					word |= static_cast<std::uint64_t>(!(*this)(a[i + j], b[i + j])) << j;
+				}
+				mask[i / 64] = word;
+				total += simd::__popcount(word);
+			}
+			return total;
+		}
+
+		inline proximal_stats<__float128> stats(const __float128* a, const __float128* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			proximal_stats<__float128> s;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				s.add(first_index + i, a[i], b[i], (*this)(a[i], b[i]));
+			}
+			return s;
+		}
+
+	#endif // __PROXIMAL_HAS_FLOAT128__
+
+		/*
+		 *	Half values and arrays (see representation<half>). Arrays of half are
+		 *	widened to float in registers as they are compared, and their
+		 *	statistics are reported in float.
+		 */
+
+		__PROXIMAL_CONSTEXPR__ inline half ulp(half x) const
+		{
+			return representation<half>::margin(x, 0);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline half margin(half x) const
+		{
+			return representation<half>::margin(x, N);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(half a, half b) const
+		{
+			return representation<half>::within_margin(a, b, N);
+		}
+
+		inline bool all_close(const half* a, const half* b, std::size_t count) const
+		{
+			return simd::all_close(a, b, count, N);
+		}
+
+		inline std::size_t mismatches(const half* a, const half* b, std::size_t count, std::uint64_t* mask) const
+		{
+			return simd::mismatches(a, b, count, N, mask);
+		}
+
+		inline proximal_stats<float> stats(const half* a, const half* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			return simd::stats(a, b, count, N, first_index);
+		}
+
+		/*
+		 *	bfloat16 values and arrays, likewise widened to float.
+		 */
+
+		__PROXIMAL_CONSTEXPR__ inline bfloat16 ulp(bfloat16 x) const
+		{
+			return representation<bfloat16>::margin(x, 0);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bfloat16 margin(bfloat16 x) const
+		{
+			return representation<bfloat16>::margin(x, N);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(bfloat16 a, bfloat16 b) const
+		{
+			return representation<bfloat16>::within_margin(a, b, N);
+		}
+
+		inline bool all_close(const bfloat16* a, const bfloat16* b, std::size_t count) const
+		{
+			return simd::all_close(a, b, count, N);
+		}
+
+		inline std::size_t mismatches(const bfloat16* a, const bfloat16* b, std::size_t count, std::uint64_t* mask) const
+		{
+			return simd::mismatches(a, b, count, N, mask);
+		}
+
+		inline proximal_stats<float> stats(const bfloat16* a, const bfloat16* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			return simd::stats(a, b, count, N, first_index);
+		}
+
+		/*
+		 *	Complex values, compared componentwise or by modulus (see
+		 *	complex_margin). The batch forms take arrays of std::complex, whose
+		 *	parts are interleaved in memory; float and double arrays are
+		 *	compared by the SIMD kernels without copying the parts apart.
+		 */
+
+		inline bool operator()(const std::complex<float>& a, const std::complex<float>& b, complex_margin mode = complex_margin::componentwise) const
+		{
+			if (mode == complex_margin::componentwise)
+			{
+				return (*this)(a.real(), b.real()) & (*this)(a.imag(), b.imag());
+			}
+			return __close_modulus(a.real(), a.imag(), b.real(), b.imag(), exp2i<float>(N - fractional_digits<float>));
+		}
+
+		inline bool operator()(const std::complex<double>& a, const std::complex<double>& b, complex_margin mode = complex_margin::componentwise) const
+		{
+			if (mode == complex_margin::componentwise)
+			{
+				return (*this)(a.real(), b.real()) & (*this)(a.imag(), b.imag());
+			}
+			return __close_modulus(a.real(), a.imag(), b.real(), b.imag(), exp2i<double>(N - fractional_digits<double>));
+		}
+
+		inline bool operator()(const std::complex<long double>& a, const std::complex<long double>& b, complex_margin mode = complex_margin::componentwise) const
+		{
+			if (mode == complex_margin::componentwise)
+			{
+				return (*this)(a.real(), b.real()) & (*this)(a.imag(), b.imag());
+			}
+			return __close_modulus(a.real(), a.imag(), b.real(), b.imag(), exp2i<long double>(N - fractional_digits<long double>));
+		}
+
+		inline bool all_close(const std::complex<float>* a, const std::complex<float>* b, std::size_t count, complex_margin mode = complex_margin::componentwise) const
+		{
+			return mode == complex_margin::componentwise ? all_close(__parts(a), __parts(b), 2 * count) : simd::all_close_modulus(__parts(a), __parts(b), count, N);
+		}
+
+		inline std::size_t mismatches(const std::complex<float>* a, const std::complex<float>* b, std::size_t count, std::uint64_t* mask,
+			complex_margin mode = complex_margin::componentwise) const
+		{
+			return mode == complex_margin::componentwise ? __complex_mismatches(*this, a, b, count, mask) : simd::mismatches_modulus(__parts(a), __parts(b), count, N, mask);
+		}
+
+		inline bool all_close(const std::complex<double>* a, const std::complex<double>* b, std::size_t count, complex_margin mode = complex_margin::componentwise) const
+		{
+			return mode == complex_margin::componentwise ? all_close(__parts(a), __parts(b), 2 * count) : simd::all_close_modulus(__parts(a), __parts(b), count, N);
+		}
+
+		inline std::size_t mismatches(const std::complex<double>* a, const std::complex<double>* b, std::size_t count, std::uint64_t* mask,
+			complex_margin mode = complex_margin::componentwise) const
+		{
+			return mode == complex_margin::componentwise ? __complex_mismatches(*this, a, b, count, mask) : simd::mismatches_modulus(__parts(a), __parts(b), count, N, mask);
+		}
+
+		inline bool all_close(const std::complex<long double>* a, const std::complex<long double>* b, std::size_t count, complex_margin mode = complex_margin::componentwise) const
+		{
+			return mode == complex_margin::componentwise ? all_close(__parts(a), __parts(b), 2 * count) : __complex_all_close_modulus(a, b, count, exp2i<long double>(N - fractional_digits<long double>));
+		}
+
+		inline std::size_t mismatches(const std::complex<long double>* a, const std::complex<long double>* b, std::size_t count, std::uint64_t* mask,
+			complex_margin mode = complex_margin::componentwise) const
+		{
+			return mode == complex_margin::componentwise ? __complex_mismatches(*this, a, b, count, mask) : __complex_mismatches_modulus(a, b, count, exp2i<long double>(N - fractional_digits<long double>), mask);
+		}
+
+		template<class T>
+		inline T ulp(T value) const = delete;
+
+		template<class T>
+		inline T margin(T value) const = delete;
+
+		template<class T, class U>
+		inline bool operator()(T a, U b) const = delete;
+
+		template<class T, class U>
+		inline bool all_close(const T* a, const U* b, std::size_t count) const = delete;
+
+		template<class T, class U>
+		inline std::size_t mismatches(const T* a, const U* b, std::size_t count, std::uint64_t* mask) const = delete;
+
+		template<class T, class U>
+		inline void stats(const T* a, const U* b, std::size_t count, std::size_t first_index = 0) const = delete;
+	};
+
+	/*
+	 *	proximal_dynamic compares values exactly as proximal<N> does, with N
+	 *	given at construction (e.g. read from configuration) rather than as a
+	 *	template parameter. The constants that proximal<N> takes from the
+	 *	fractional_precision and exponent_limit templates are computed once
+	 *	per floating point type in the constructor. The integer-domain engine
+	 *	and the batch kernels take N as an ordinary argument, so for float
+	 *	and double the only difference from proximal<N> is that N is held in
+	 *	a register rather than folded into an immediate.
+	 *
+	 *	Any int is accepted. N is clamped to [-max_n(), max_n()], past which the
+	 *	margins of every type are already 0 or infinite, so that the
+	 *	exponent arithmetic cannot overflow; n() returns the clamped value.
+	 */
+	class proximal_dynamic
+	{
+	public:
+
+		static constexpr inline int max_n()
+		{
+			return 1 << 16;
+		}
+
+	private:
+
+		struct limits
+		{
+			int fractional_precision;
+			int exponent_limit;
+		};
+
+		template<class T>
+		static __PROXIMAL_CONSTEXPR__ inline limits _make_limits(int n)
+		{
+			return limits{fractional_digits<T> - n, min_implicit_exponent<T> + n};
+		}
+
+		template<class T>
+		static __PROXIMAL_CONSTEXPR__ inline T _margin(T x, const limits& lim)
+		{
+			int margin_exp = ilog2(x) - lim.fractional_precision;
+			return exp2i<T>(margin_exp > lim.exponent_limit ? margin_exp : lim.exponent_limit);
+		}
+
+		template<class T>
+		static __PROXIMAL_CONSTEXPR__ inline T _margin_checked(T x, const limits& lim)
+		{
+			if (__is_inf_or_nan(x))
+			{
+				return static_cast<T>(0.0);
+			}
+			if (x == 0.0)
+			{
+				return exp2i<T>(lim.exponent_limit);
+			}
+			return _margin(x, lim);
+		}
+
+		template<class T>
+		static __PROXIMAL_CONSTEXPR__ inline bool _within_margin(T a, T b, const limits& lim)
+		{
+			if (a == b)
+			{
+				return true;
+			}
+
+			if (__is_inf_or_nan(a) || __is_inf_or_nan(b))
+			{
+				return false;
+			}
+			return __abs(a - b) <= _margin(std::max(__abs(a), __abs(b)), lim);
+		}
+
+	public:
+
+		explicit __PROXIMAL_CONSTEXPR__ inline proximal_dynamic(int n = 1)
+		:
+		n_{n < -max_n() ? -max_n() : n > max_n() ? max_n() : n},
+		float_limits_{_make_limits<float>(n_)},
+		double_limits_{_make_limits<double>(n_)},
+		long_double_limits_{_make_limits<long double>(n_)}
+	#if (__PROXIMAL_HAS_FLOAT128__)
+		,
+		float128_limits_{_make_limits<__float128>(n_)}
+	#endif
+		{}
+
+		__PROXIMAL_CONSTEXPR__ inline int n() const
+		{
+			return n_;
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline float ulp(float x) const
+		{
+			return proximal<0>{}.ulp(x);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline double ulp(double x) const
+		{
+			return proximal<0>{}.ulp(x);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline long double ulp(long double x) const
+		{
+			return proximal<0>{}.ulp(x);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline float margin(float x) const
+		{
+			return _margin_checked(x, float_limits_);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline double margin(double x) const
+		{
+			return _margin_checked(x, double_limits_);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline long double margin(long double x) const
+		{
+			return _margin_checked(x, long_double_limits_);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(float a, float b) const
+		{
+		#if (__USE_INTEGER_DOMAIN_COMPARISON__) && (__USE_FLOAT_IEEE754_SPECIALIZATION__)
+			return representation<float>::within_margin(a, b, n_);
+		#else
+			return _within_margin(a, b, float_limits_);
+		#endif
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(double a, double b) const
+		{
+		#if (__USE_INTEGER_DOMAIN_COMPARISON__) && (__USE_DOUBLE_IEEE754_SPECIALIZATION__)
+			return representation<double>::within_margin(a, b, n_);
+		#else
+			return _within_margin(a, b, double_limits_);
+		#endif
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(long double a, long double b) const
+		{
+			return _within_margin(a, b, long_double_limits_);
+		}
+
+		inline bool all_close(const float* a, const float* b, std::size_t count) const
+		{
+			return simd::all_close(a, b, count, n_);
+		}
+
+		inline bool all_close(const double* a, const double* b, std::size_t count) const
+		{
+			return simd::all_close(a, b, count, n_);
+		}
+
+		inline bool all_close(const long double* a, const long double* b, std::size_t count) const
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if (!_within_margin(a[i], b[i], long_double_limits_))
+				{
+					return false;
+				}
 			}
-			return _ulp(x);
+			return true;
 		}
-	
-		inline long double ulp(long double x) const
+
+		inline std::size_t mismatches(const float* a, const float* b, std::size_t count, std::uint64_t* mask) const
+		{
+			return simd::mismatches(a, b, count, n_, mask);
+		}
+
+		inline std::size_t mismatches(const double* a, const double* b, std::size_t count, std::uint64_t* mask) const
+		{
+			return simd::mismatches(a, b, count, n_, mask);
+		}
+
+		inline std::size_t mismatches(const long double* a, const long double* b, std::size_t count, std::uint64_t* mask) const
 		{
-			if (isinf(x) || isnan(x))
+			std::size_t total = 0;
+			for (std::size_t i = 0; i < count; i += 64)
 			{
-				return static_cast<long double>(0.0);
+				std::uint64_t word = 0;
+				for (std::size_t j = 0; j < 64 && i + j < count; ++j)
+				{
+					word |= static_cast<std::uint64_t>(!_within_margin(a[i + j], b[i + j], long_double_limits_)) << j;
+				}
+				mask[i / 64] = word;
+				total += simd::__popcount(word);
 			}
-			if (x == 0.0)
+			return total;
+		}
+
+		inline proximal_stats<float> stats(const float* a, const float* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			return simd::stats(a, b, count, n_, first_index);
+		}
+
+		inline proximal_stats<double> stats(const double* a, const double* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			return simd::stats(a, b, count, n_, first_index);
+		}
+
+		inline proximal_stats<long double> stats(const long double* a, const long double* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			proximal_stats<long double> s;
+			for (std::size_t i = 0; i < count; ++i)
 			{
-				return exp2i<long double>(exponent_limit<long double, 0>);
+				s.add(first_index + i, a[i], b[i], _within_margin(a[i], b[i], long_double_limits_));
 			}
-			return _ulp(x);
+			return s;
 		}
-		
-		inline float margin(float x) const
+	#if (__PROXIMAL_HAS_FLOAT128__)
+
+		/*
+		 *	__float128 values and arrays (see representation<__float128>).
+		 *	Arrays are compared one pair at a time, as for long double.
+		 */
+
+		__PROXIMAL_CONSTEXPR__ inline __float128 ulp(__float128 x) const
+		{
+			return proximal<0>{}.ulp(x);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline __float128 margin(__float128 x) const
 		{
-			if (isinf(x) || isnan(x))
+			return _margin_checked(x, float128_limits_);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(__float128 a, __float128 b) const
+		{
+		#if (__USE_INTEGER_DOMAIN_COMPARISON__)
+			return representation<__float128>::within_margin(a, b, n_);
+		#else
+			return _within_margin(a, b, float128_limits_);
+		#endif
+		}
+
+		inline bool all_close(const __float128* a, const __float128* b, std::size_t count) const
+		{
+			for (std::size_t i = 0; i < count; ++i)
 			{
-				return static_cast<float>(0.0);
+				if (!(*this)(a[i], b[i]))
+				{
+					return false;
+				}
 			}
-			if (x == 0.0)
+			return true;
+		}
+
+		inline std::size_t mismatches(const __float128* a, const __float128* b, std::size_t count, std::uint64_t* mask) const
+		{
+			std::size_t total = 0;
+			for (std::size_t i = 0; i < count; i += 64)
 			{
-				return exp2i<float>(exponent_limit<float, N>);
+				std::uint64_t word = 0;
+				for (std::size_t j = 0; j < 64 && i + j < count; ++j)
+				{
+					word |= static_cast<std::uint64_t>(!(*this)(a[i + j], b[i + j])) << j;
+				}
+				mask[i / 64] = word;
+				total += simd::__popcount(word);
 			}
-			return _margin(x);
+			return total;
 		}
-	
-		inline double margin(double x) const
+
+		inline proximal_stats<__float128> stats(const __float128* a, const __float128* b, std::size_t count, std::size_t first_index = 0) const
 		{
-			if (isinf(x) || isnan(x))
+			proximal_stats<__float128> s;
+			for (std::size_t i = 0; i < count; ++i)
 			{
-				return static_cast<double>(0.0);
+				s.add(first_index + i, a[i], b[i], (*this)(a[i], b[i]));
 			}
-			if (x == 0.0)
+			return s;
+		}
+
+	#endif // __PROXIMAL_HAS_FLOAT128__
+
+		/*
+		 *	Half values and arrays (see representation<half>). Arrays of half are
+		 *	widened to float in registers as they are compared, and their
+		 *	statistics are reported in float.
+		 */
+
+		__PROXIMAL_CONSTEXPR__ inline half ulp(half x) const
+		{
+			return representation<half>::margin(x, 0);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline half margin(half x) const
+		{
+			return representation<half>::margin(x, n_);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(half a, half b) const
+		{
+			return representation<half>::within_margin(a, b, n_);
+		}
+
+		inline bool all_close(const half* a, const half* b, std::size_t count) const
+		{
+			return simd::all_close(a, b, count, n_);
+		}
+
+		inline std::size_t mismatches(const half* a, const half* b, std::size_t count, std::uint64_t* mask) const
+		{
+			return simd::mismatches(a, b, count, n_, mask);
+		}
+
+		inline proximal_stats<float> stats(const half* a, const half* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			return simd::stats(a, b, count, n_, first_index);
+		}
+
+		/*
+		 *	bfloat16 values and arrays, likewise widened to float.
+		 */
+
+		__PROXIMAL_CONSTEXPR__ inline bfloat16 ulp(bfloat16 x) const
+		{
+			return representation<bfloat16>::margin(x, 0);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bfloat16 margin(bfloat16 x) const
+		{
+			return representation<bfloat16>::margin(x, n_);
+		}
+
+		__PROXIMAL_CONSTEXPR__ inline bool operator()(bfloat16 a, bfloat16 b) const
+		{
+			return representation<bfloat16>::within_margin(a, b, n_);
+		}
+
+		inline bool all_close(const bfloat16* a, const bfloat16* b, std::size_t count) const
+		{
+			return simd::all_close(a, b, count, n_);
+		}
+
+		inline std::size_t mismatches(const bfloat16* a, const bfloat16* b, std::size_t count, std::uint64_t* mask) const
+		{
+			return simd::mismatches(a, b, count, n_, mask);
+		}
+
+		inline proximal_stats<float> stats(const bfloat16* a, const bfloat16* b, std::size_t count, std::size_t first_index = 0) const
+		{
+			return simd::stats(a, b, count, n_, first_index);
+		}
+
+		/*
+		 *	Complex values, compared componentwise or by modulus (see
+		 *	complex_margin). The batch forms take arrays of std::complex, whose
+		 *	parts are interleaved in memory; float and double arrays are
+		 *	compared by the SIMD kernels without copying the parts apart.
+		 */
+
+		inline bool operator()(const std::complex<float>& a, const std::complex<float>& b, complex_margin mode = complex_margin::componentwise) const
+		{
+			if (mode == complex_margin::componentwise)
 			{
-				return exp2i<double>(exponent_limit<double, N>);
+				return (*this)(a.real(), b.real()) & (*this)(a.imag(), b.imag());
 			}
-			return _margin(x);
+			return __close_modulus(a.real(), a.imag(), b.real(), b.imag(), exp2i<float>(n_ - fractional_digits<float>));
 		}
-	
-		inline long double margin(long double x) const
+
+		inline bool operator()(const std::complex<double>& a, const std::complex<double>& b, complex_margin mode = complex_margin::componentwise) const
 		{
-			if (isinf(x) || isnan(x))
+			if (mode == complex_margin::componentwise)
 			{
-				return static_cast<long double>(0.0);
+				return (*this)(a.real(), b.real()) & (*this)(a.imag(), b.imag());
 			}
-			if (x == 0.0)
+			return __close_modulus(a.real(), a.imag(), b.real(), b.imag(), exp2i<double>(n_ - fractional_digits<double>));
+		}
+
+		inline bool operator()(const std::complex<long double>& a, const std::complex<long double>& b, complex_margin mode = complex_margin::componentwise) const
+		{
+			if (mode == complex_margin::componentwise)
 			{
-				return exp2i<long double>(exponent_limit<long double, N>);
+				return (*this)(a.real(), b.real()) & (*this)(a.imag(), b.imag());
 			}
-			return _margin(x);
+			return __close_modulus(a.real(), a.imag(), b.real(), b.imag(), exp2i<long double>(n_ - fractional_digits<long double>));
 		}
-	
-		inline bool operator()(float a, float b) const
+
+		inline bool all_close(const std::complex<float>* a, const std::complex<float>* b, std::size_t count, complex_margin mode = complex_margin::componentwise) const
 		{
-			return _within_margin(a, b);
+			return mode == complex_margin::componentwise ? all_close(__parts(a), __parts(b), 2 * count) : simd::all_close_modulus(__parts(a), __parts(b), count, n_);
 		}
-		
-		inline bool operator()(double a, double b) const
+
+		inline std::size_t mismatches(const std::complex<float>* a, const std::complex<float>* b, std::size_t count, std::uint64_t* mask,
+			complex_margin mode = complex_margin::componentwise) const
 		{
-			return _within_margin(a, b);
+			return mode == complex_margin::componentwise ? __complex_mismatches(*this, a, b, count, mask) : simd::mismatches_modulus(__parts(a), __parts(b), count, n_, mask);
 		}
-		
-		inline bool operator()(long double a, long double b) const
+
+		inline bool all_close(const std::complex<double>* a, const std::complex<double>* b, std::size_t count, complex_margin mode = complex_margin::componentwise) const
 		{
-			return _within_margin(a, b);
+			return mode == complex_margin::componentwise ? all_close(__parts(a), __parts(b), 2 * count) : simd::all_close_modulus(__parts(a), __parts(b), count, n_);
 		}
-		
+
+		inline std::size_t mismatches(const std::complex<double>* a, const std::complex<double>* b, std::size_t count, std::uint64_t* mask,
+			complex_margin mode = complex_margin::componentwise) const
+		{
+			return mode == complex_margin::componentwise ? __complex_mismatches(*this, a, b, count, mask) : simd::mismatches_modulus(__parts(a), __parts(b), count, n_, mask);
+		}
+
+		inline bool all_close(const std::complex<long double>* a, const std::complex<long double>* b, std::size_t count, complex_margin mode = complex_margin::componentwise) const
+		{
+			return mode == complex_margin::componentwise ? all_close(__parts(a), __parts(b), 2 * count) : __complex_all_close_modulus(a, b, count, exp2i<long double>(n_ - fractional_digits<long double>));
+		}
+
+		inline std::size_t mismatches(const std::complex<long double>* a, const std::complex<long double>* b, std::size_t count, std::uint64_t* mask,
+			complex_margin mode = complex_margin::componentwise) const
+		{
+			return mode == complex_margin::componentwise ? __complex_mismatches(*this, a, b, count, mask) : __complex_mismatches_modulus(a, b, count, exp2i<long double>(n_ - fractional_digits<long double>), mask);
+		}
+
 		template<class T>
 		inline T ulp(T value) const = delete;
 
@@ -800,6 +3090,318 @@ namespace utils
 
 		template<class T, class U>
 		inline bool operator()(T a, U b) const = delete;
+
+		template<class T, class U>
+		inline bool all_close(const T* a, const U* b, std::size_t count) const = delete;
+
+		template<class T, class U>
+		inline std::size_t mismatches(const T* a, const U* b, std::size_t count, std::uint64_t* mask) const = delete;
+
+		template<class T, class U>
+		inline void stats(const T* a, const U* b, std::size_t count, std::size_t first_index = 0) const = delete;
+
+	private:
+		int n_;
+		limits float_limits_;
+		limits double_limits_;
+		limits long_double_limits_;
+	#if (__PROXIMAL_HAS_FLOAT128__)
+		limits float128_limits_;
+	#endif
+	};
+
+	/*
+	 *	proximal_cross compares results computed in a narrower floating point
+	 *	type with references computed in a wider one: float with double or long
+	 *	double, and double with long double. Each reference is rounded to the
+	 *	type of the result, and the pair is then compared as proximal<N>
+	 *	compares values of that type, so margins and errors are in ulps of the
+	 *	result. A correctly rounded result has an error of 0 ulps.
+	 *
+	 *	References past the range of the result round to infinity, and match
+	 *	only an infinite result of the same sign; references in the range of
+	 *	its denormals round to denormals or zero, where the margin is that of
+	 *	the smallest normal values. Reference arrays are read as they are:
+	 *	double references are rounded to float in registers by the batch
+	 *	kernels, and long double references one at a time.
+	 */
+	template<int N = 1>
+	class proximal_cross
+	{
+	public:
+		inline bool operator()(float result, double reference) const
+		{
+			return close_enough_(result, static_cast<float>(reference));
+		}
+
+		inline bool operator()(float result, long double reference) const
+		{
+			return close_enough_(result, static_cast<float>(reference));
+		}
+
+		inline bool operator()(double result, long double reference) const
+		{
+			return close_enough_(result, static_cast<double>(reference));
+		}
+
+		inline bool all_close(const float* result, const double* reference, std::size_t count) const
+		{
+			return simd::all_close(result, reference, count, N);
+		}
+
+		template<class T, class R>
+		inline bool all_close(const T* result, const R* reference, std::size_t count) const
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				if (!(*this)(result[i], reference[i]))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/*
+		 *	As proximal<N>::mismatches(): bit i % 64 of mask[i / 64] is set if
+		 *	result[i] is not close enough to reference[i].
+		 */
+
+		inline std::size_t mismatches(const float* result, const double* reference, std::size_t count, std::uint64_t* mask) const
+		{
+			return simd::mismatches(result, reference, count, N, mask);
+		}
+
+		template<class T, class R>
+		inline std::size_t mismatches(const T* result, const R* reference, std::size_t count, std::uint64_t* mask) const
+		{
+			std::size_t total = 0;
+			for (std::size_t i = 0; i < count; i += 64)
+			{
+				std::uint64_t word = 0;
+				for (std::size_t j = 0; j < 64 && i + j < count; ++j)
+				{
+					word |= static_cast<std::uint64_t>(!(*this)(result[i + j], reference[i + j])) << j;
+				}
+				mask[i / 64] = word;
+				total += simd::__popcount(word);
+			}
+			return total;
+		}
+
+		/*
+		 *	As proximal<N>::stats(), with errors measured from the rounded
+		 *	references, in the type of the results.
+		 */
+
+		inline proximal_stats<float> stats(const float* result, const double* reference, std::size_t count, std::size_t first_index = 0) const
+		{
+			return simd::stats(result, reference, count, N, first_index);
+		}
+
+		template<class T, class R>
+		inline proximal_stats<T> stats(const T* result, const R* reference, std::size_t count, std::size_t first_index = 0) const
+		{
+			proximal_stats<T> s;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				s.add(first_index + i, result[i], static_cast<T>(reference[i]), (*this)(result[i], reference[i]));
+			}
+			return s;
+		}
+
+		template<class T, class R>
+		inline bool operator()(T result, R reference) const = delete;
+
+	private:
+		proximal<N> close_enough_;
+	};
+
+	/*
+	 *	Distribution of ulp distances, for choosing N from data rather than by
+	 *	guessing. Distances are counted by magnitude in logarithmic buckets:
+	 *	bucket 0 holds equal pairs, bucket k (1 to 64) distances d with
+	 *	2^(k-1) <= |d| < 2^k, and nan_bucket pairs involving NaN.
+	 *
+	 *	The counters are atomic, so a histogram can be fed from many threads
+	 *	without locks. To feed billions of pairs, give each thread an
+	 *	accumulator, which counts in plain integers and adds its counts to the
+	 *	histogram when flushed or destroyed.
+	 */
+	class ulp_histogram
+	{
+	public:
+		enum : int
+		{
+			nan_bucket = 65,
+			buckets = 66
+		};
+
+		static inline int bucket(std::int64_t distance)
+		{
+			// branchless, since the sign and size of distances are unpredictable
+			std::uint64_t u = static_cast<std::uint64_t>(distance);
+			std::uint64_t sign = std::uint64_t{0} - (u >> 63);
+			std::uint64_t magnitude = (u ^ sign) - sign;
+			return 64 - count_leading_zeros(magnitude | 1) - static_cast<int>(magnitude == 0);
+		}
+
+		template<class T>
+		static inline int bucket(T a, T b)
+		{
+			return __is_nan(a) || __is_nan(b) ? nan_bucket : bucket(ulp_distance(a, b));
+		}
+
+		/*
+		 *	The largest distance counted in bucket k.
+		 */
+		static inline std::uint64_t bucket_limit(int k)
+		{
+			return k == 0 ? 0 : k < 64 ? (std::uint64_t{1} << k) - 1 : std::uint64_t{1} << 63;
+		}
+
+		class accumulator
+		{
+		public:
+			explicit inline accumulator(ulp_histogram& target)
+			:
+			target_{target},
+			counts_{}
+			{}
+
+			accumulator(const accumulator&) = delete;
+			accumulator& operator=(const accumulator&) = delete;
+
+			inline ~accumulator()
+			{
+				flush();
+			}
+
+			template<class T>
+			inline void add(T a, T b)
+			{
+				++counts_[bucket(a, b)];
+			}
+
+			/*
+			 *	Most pairs land in a few buckets, so consecutive pairs are counted
+			 *	in separate sets of counters: increments of the same counter would
+			 *	otherwise wait for each other.
+			 */
+			template<class T>
+			inline void add(const T* a, const T* b, std::size_t count)
+			{
+				std::uint64_t lanes[4][buckets] = {};
+				std::size_t i = 0;
+				for (; i + 4 <= count; i += 4)
+				{
+					++lanes[0][bucket(a[i], b[i])];
+					++lanes[1][bucket(a[i + 1], b[i + 1])];
+					++lanes[2][bucket(a[i + 2], b[i + 2])];
+					++lanes[3][bucket(a[i + 3], b[i + 3])];
+				}
+				for (std::size_t j = 0; j < count - i; ++j)
+				{
+					++lanes[j][bucket(a[i + j], b[i + j])];
+				}
+				for (int k = 0; k < buckets; ++k)
+				{
+					counts_[k] += lanes[0][k] + lanes[1][k] + lanes[2][k] + lanes[3][k];
+				}
+			}
+
+			inline void flush()
+			{
+				for (int k = 0; k < buckets; ++k)
+				{
+					if (counts_[k] != 0)
+					{
+						target_.counts_[k].fetch_add(counts_[k], std::memory_order_relaxed);
+						counts_[k] = 0;
+					}
+				}
+			}
+
+		private:
+			ulp_histogram& target_;
+			std::uint64_t counts_[buckets];
+		};
+
+		inline ulp_histogram()
+		:
+		counts_{}
+		{}
+
+		ulp_histogram(const ulp_histogram&) = delete;
+		ulp_histogram& operator=(const ulp_histogram&) = delete;
+
+		template<class T>
+		inline void add(T a, T b)
+		{
+			counts_[bucket(a, b)].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		template<class T>
+		inline void add(const T* a, const T* b, std::size_t count)
+		{
+			accumulator{*this}.add(a, b, count);
+		}
+
+		inline void merge(const ulp_histogram& other)
+		{
+			for (int k = 0; k < buckets; ++k)
+			{
+				counts_[k].fetch_add(other.count(k), std::memory_order_relaxed);
+			}
+		}
+
+		inline void reset()
+		{
+			for (auto& c : counts_)
+			{
+				c.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		inline std::uint64_t count(int k) const
+		{
+			return counts_[k].load(std::memory_order_relaxed);
+		}
+
+		inline std::uint64_t total() const
+		{
+			std::uint64_t sum = 0;
+			for (int k = 0; k < buckets; ++k)
+			{
+				sum += count(k);
+			}
+			return sum;
+		}
+
+		/*
+		 *	The smallest bucket k such that a fraction q of all pairs are at
+		 *	most bucket_limit(k) apart, or nan_bucket if that includes NaN pairs.
+		 *	Since margin<N>(x) is 2^N ulps of x, N = quantile_bucket(q) accepts
+		 *	about a fraction q of the pairs (distances that cross a power of two
+		 *	can count up to twice as many values as the margin's ulps).
+		 */
+		inline int quantile_bucket(double q) const
+		{
+			const double threshold = q * static_cast<double>(total());
+			std::uint64_t cumulative = 0;
+			for (int k = 0; k < nan_bucket; ++k)
+			{
+				cumulative += count(k);
+				if (static_cast<double>(cumulative) >= threshold)
+				{
+					return k;
+				}
+			}
+			return nan_bucket;
+		}
+
+	private:
+		std::atomic<std::uint64_t> counts_[buckets];
 	};
 }
 
@@ -0,0 +1,233 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef guard_utils_proximal_doctest_h
+#define guard_utils_proximal_doctest_h
+
+#include "proximal.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ *	doctest assertions over whole arrays:
+ *
+ *		CHECK_ALL_CLOSE(N, a, b)					proximal<N> over two containers
+ *		CHECK_ALL_CLOSE_N(N, a, b, count)			proximal<N> over two pointers
+ *		CHECK_ALL_CLOSE_WITH(close_enough, a, b)	any comparator with all_close(),
+ *													mismatches() and stats() members
+ *
+ *	with REQUIRE_ and WARN_ forms of each. Containers are C arrays or have
+ *	data() and size(), and must have the same size. A passing assertion is a
+ *	single all_close() call, so an array of millions of elements is checked
+ *	at the speed of the batch kernels; a failing one takes two more passes,
+ *	stats() and mismatches(), and reports the number of mismatches, the
+ *	largest error, and the first __PROXIMAL_DOCTEST_REPORTED__ mismatches
+ *	and the worst one with their ulp distances, rather than one line per
+ *	element. Include doctest.h first.
+ */
+
+#ifndef DOCTEST_VERSION_STR
+#error "include doctest.h before proximal_doctest.h"
+#endif
+
+#ifndef __PROXIMAL_DOCTEST_REPORTED__
+#define __PROXIMAL_DOCTEST_REPORTED__ 8
+#endif
+
+namespace utils
+{
+	template<class T>
+	static inline T __printable(T x)
+	{
+		return x;
+	}
+
+	static inline float __printable(half x)
+	{
+		return static_cast<float>(x);
+	}
+
+	static inline float __printable(bfloat16 x)
+	{
+		return static_cast<float>(x);
+	}
+
+#if (__PROXIMAL_HAS_FLOAT128__)
+	static inline long double __printable(__float128 x)
+	{
+		return static_cast<long double>(x);
+	}
+#endif
+
+	template<class T>
+	static inline void __print_value(std::ostream& out, T x)
+	{
+		auto printable = __printable(x);
+		out.precision(std::numeric_limits<decltype(printable)>::max_digits10);
+		out << printable;
+	}
+
+	template<class T, class R>
+	static inline void __print_mismatch(std::ostream& out, const T* a, const R* b, std::size_t i)
+	{
+		out << "\n  [" << i << "] ";
+		__print_value(out, a[i]);
+		out << " vs ";
+		__print_value(out, b[i]);
+		std::int64_t distance = ulp_distance(a[i], static_cast<T>(b[i]));
+		if (distance == std::numeric_limits<std::int64_t>::max())
+		{
+			out << ", unordered or too far apart";
+		}
+		else
+		{
+			out << ", " << distance << " ulps apart";
+		}
+	}
+
+	/*
+	 *	The result of an assertion: passed, or a description of the mismatches.
+	 */
+	template<class C, class T, class R>
+	static inline doctest::detail::Result __all_close_result(const C& close_enough, const T* a, const R* b, std::size_t count)
+	{
+		if (close_enough.all_close(a, b, count))
+		{
+			return doctest::detail::Result{true};
+		}
+		auto s = close_enough.stats(a, b, count);
+		std::vector<std::uint64_t> mask((count + 63) / 64);
+		close_enough.mismatches(a, b, count, mask.data());
+
+		std::ostringstream out;
+		out << s.mismatches << " of " << count << " elements not close enough, max error ";
+		__print_value(out, s.max_error);
+		out << " (";
+		__print_value(out, s.max_ulps);
+		out << " ulps) at [" << s.worst << "]";
+		std::size_t reported = 0;
+		bool worst_reported = false;
+		for (std::size_t w = 0; w < mask.size() && reported < __PROXIMAL_DOCTEST_REPORTED__; ++w)
+		{
+			for (std::uint64_t word = mask[w]; word != 0 && reported < __PROXIMAL_DOCTEST_REPORTED__; word &= word - 1)
+			{
+				std::uint64_t lowest = word & (~word + 1);
+				std::size_t i = 64 * w + static_cast<std::size_t>(63 - count_leading_zeros(lowest));
+				__print_mismatch(out, a, b, i);
+				worst_reported |= i == s.worst;
+				++reported;
+			}
+		}
+		if (s.mismatches > reported)
+		{
+			out << "\n  ... " << s.mismatches - reported << " more";
+		}
+		if (!worst_reported && s.worst != s.npos)
+		{
+			out << "\n  worst:";
+			__print_mismatch(out, a, b, s.worst);
+		}
+		return doctest::detail::Result{false, out.str().c_str()};
+	}
+
+	template<class T, std::size_t Size>
+	static inline const T* __array_data(const T (&a)[Size])
+	{
+		return a;
+	}
+
+	template<class T, std::size_t Size>
+	static inline std::size_t __array_size(const T (&)[Size])
+	{
+		return Size;
+	}
+
+	template<class C>
+	static inline auto __array_data(const C& a) -> decltype(a.data())
+	{
+		return a.data();
+	}
+
+	template<class C>
+	static inline auto __array_size(const C& a) -> decltype(a.size())
+	{
+		return a.size();
+	}
+
+	template<class C, class A, class B>
+	static inline doctest::detail::Result __all_close_result(const C& close_enough, const A& a, const B& b)
+	{
+		std::size_t count = __array_size(a);
+		if (__array_size(b) != count)
+		{
+			std::ostringstream out;
+			out << "sizes differ: " << count << " and " << __array_size(b);
+			return doctest::detail::Result{false, out.str().c_str()};
+		}
+		return __all_close_result(close_enough, __array_data(a), __array_data(b), count);
+	}
+}
+
+#ifndef DOCTEST_CONFIG_DISABLE
+
+#define __PROXIMAL_ASSERT_ALL_CLOSE__(text, result, assert_type)										\
+	do																									\
+	{																									\
+		doctest::detail::ResultBuilder _DOCTEST_RB(doctest::detail::assertType::assert_type, __FILE__, __LINE__, text);	\
+		DOCTEST_WRAP_IN_TRY(_DOCTEST_RB.setResult(result))												\
+		DOCTEST_ASSERT_LOG_AND_REACT(_DOCTEST_RB);														\
+	} while ((void)0, 0)
+
+#else
+
+#define __PROXIMAL_ASSERT_ALL_CLOSE__(text, result, assert_type) ((void)0)
+
+#endif // DOCTEST_CONFIG_DISABLE
+
+#define CHECK_ALL_CLOSE(N, a, b) \
+	__PROXIMAL_ASSERT_ALL_CLOSE__("proximal<" #N ">.all_close(" #a ", " #b ")", ::utils::__all_close_result(::utils::proximal<N>{}, a, b), DT_CHECK)
+#define REQUIRE_ALL_CLOSE(N, a, b) \
+	__PROXIMAL_ASSERT_ALL_CLOSE__("proximal<" #N ">.all_close(" #a ", " #b ")", ::utils::__all_close_result(::utils::proximal<N>{}, a, b), DT_REQUIRE)
+#define WARN_ALL_CLOSE(N, a, b) \
+	__PROXIMAL_ASSERT_ALL_CLOSE__("proximal<" #N ">.all_close(" #a ", " #b ")", ::utils::__all_close_result(::utils::proximal<N>{}, a, b), DT_WARN)
+
+#define CHECK_ALL_CLOSE_N(N, a, b, count) \
+	__PROXIMAL_ASSERT_ALL_CLOSE__("proximal<" #N ">.all_close(" #a ", " #b ", " #count ")", ::utils::__all_close_result(::utils::proximal<N>{}, a, b, count), DT_CHECK)
+#define REQUIRE_ALL_CLOSE_N(N, a, b, count) \
+	__PROXIMAL_ASSERT_ALL_CLOSE__("proximal<" #N ">.all_close(" #a ", " #b ", " #count ")", ::utils::__all_close_result(::utils::proximal<N>{}, a, b, count), DT_REQUIRE)
+#define WARN_ALL_CLOSE_N(N, a, b, count) \
+	__PROXIMAL_ASSERT_ALL_CLOSE__("proximal<" #N ">.all_close(" #a ", " #b ", " #count ")", ::utils::__all_close_result(::utils::proximal<N>{}, a, b, count), DT_WARN)
+
+#define CHECK_ALL_CLOSE_WITH(close_enough, a, b) \
+	__PROXIMAL_ASSERT_ALL_CLOSE__(#close_enough ".all_close(" #a ", " #b ")", ::utils::__all_close_result(close_enough, a, b), DT_CHECK)
+#define REQUIRE_ALL_CLOSE_WITH(close_enough, a, b) \
+	__PROXIMAL_ASSERT_ALL_CLOSE__(#close_enough ".all_close(" #a ", " #b ")", ::utils::__all_close_result(close_enough, a, b), DT_REQUIRE)
+#define WARN_ALL_CLOSE_WITH(close_enough, a, b) \
+	__PROXIMAL_ASSERT_ALL_CLOSE__(#close_enough ".all_close(" #a ", " #b ")", ::utils::__all_close_result(close_enough, a, b), DT_WARN)
+
+#endif // guard_utils_proximal_doctest_h
@@ -0,0 +1,304 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef guard_utils_proximal_geometry_h
+#define guard_utils_proximal_geometry_h
+
+#include "proximal.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+
+/*
+ *	Comparisons of small fixed-size objects: points and vectors as
+ *	std::array<T, K>, matrices as arrays of rows (or flat arrays), and
+ *	quaternions as std::array<T, 4>, for float, double and long double.
+ *
+ *	geometry_margin::componentwise compares each component with proximal<N>,
+ *	so the tolerance of a component scales with that component alone; a
+ *	component that should be zero must then be nearly exactly zero.
+ *	geometry_margin::norm compares the Euclidean (for matrices, Frobenius)
+ *	norm of the difference with margin<N> of the larger norm of the two
+ *	operands, so the tolerance scales with the object as a whole. In both,
+ *	objects that are equal component by component are close, and otherwise
+ *	NaN or infinite components are close to nothing.
+ *
+ *	The loops over components are unrolled at compile time, and their
+ *	results are combined without branches, so the comparisons of an object
+ *	are independent and can overlap; the batch forms combine the results of
+ *	64 objects at a time in the same way. q and -q are the same rotation, so
+ *	same_rotation() accepts either sign of the second operand.
+ */
+
+namespace utils
+{
+	enum class geometry_margin
+	{
+		componentwise,
+		norm
+	};
+
+	template<class T>
+	struct __geometry_scalar
+	{
+		using type = T;
+	};
+
+	template<class T, std::size_t K>
+	struct __geometry_scalar<std::array<T, K>>
+	{
+		using type = typename __geometry_scalar<T>::type;
+	};
+
+	template<int N = 1, geometry_margin M = geometry_margin::componentwise>
+	class proximal_geometry
+	{
+	private:
+
+		/*
+		 *	The largest magnitude of any component of a or b, and whether every
+		 *	component is finite and every component is equal.
+		 */
+		template<class T>
+		struct bounds
+		{
+			T big = 0;
+			bool finite = true;
+			bool equal = true;
+		};
+
+		/*
+		 *	The sums, over all components, of the squares of a - b, a and b,
+		 *	each component scaled by inv.
+		 */
+		template<class T>
+		struct sums
+		{
+			T difference = 0;
+			T a = 0;
+			T b = 0;
+		};
+
+		template<class T>
+		static inline bool _componentwise(T a, T b)
+		{
+			return proximal<N>{}(a, b);
+		}
+
+		template<class T, std::size_t K, std::size_t... I>
+		static inline bool _componentwise(const std::array<T, K>& a, const std::array<T, K>& b, std::index_sequence<I...>)
+		{
+			bool close = true;
+			(void)std::initializer_list<int>{(close &= _componentwise(a[I], b[I]), 0)...};
+			return close;
+		}
+
+		template<class T, std::size_t K>
+		static inline bool _componentwise(const std::array<T, K>& a, const std::array<T, K>& b)
+		{
+			return _componentwise(a, b, std::make_index_sequence<K>{});
+		}
+
+		template<class T>
+		static inline void _bound(T a, T b, bounds<T>& r)
+		{
+			T abs_a = __abs(a);
+			T abs_b = __abs(b);
+			r.big = std::max(r.big, std::max(abs_a, abs_b));
+			r.finite &= (abs_a < __infinity<T>()) & (abs_b < __infinity<T>());
+			r.equal &= a == b;
+		}
+
+		template<class T, std::size_t K, std::size_t... I>
+		static inline void _bound(const std::array<T, K>& a, const std::array<T, K>& b,
+			bounds<typename __geometry_scalar<T>::type>& r, std::index_sequence<I...>)
+		{
+			(void)std::initializer_list<int>{(_bound(a[I], b[I], r), 0)...};
+		}
+
+		template<class T, std::size_t K>
+		static inline void _bound(const std::array<T, K>& a, const std::array<T, K>& b, bounds<typename __geometry_scalar<T>::type>& r)
+		{
+			_bound(a, b, r, std::make_index_sequence<K>{});
+		}
+
+		template<class T>
+		static inline void _accumulate(T a, T b, T inv, sums<T>& s)
+		{
+			T d = (a - b) * inv;
+			T sa = a * inv;
+			T sb = b * inv;
+			s.difference += d * d;
+			s.a += sa * sa;
+			s.b += sb * sb;
+		}
+
+		template<class T, std::size_t K, std::size_t... I>
+		static inline void _accumulate(const std::array<T, K>& a, const std::array<T, K>& b, typename __geometry_scalar<T>::type inv,
+			sums<typename __geometry_scalar<T>::type>& s, std::index_sequence<I...>)
+		{
+			(void)std::initializer_list<int>{(_accumulate(a[I], b[I], inv, s), 0)...};
+		}
+
+		template<class T, std::size_t K>
+		static inline void _accumulate(const std::array<T, K>& a, const std::array<T, K>& b, typename __geometry_scalar<T>::type inv,
+			sums<typename __geometry_scalar<T>::type>& s)
+		{
+			_accumulate(a, b, inv, s, std::make_index_sequence<K>{});
+		}
+
+		/*
+		 *	As __close_modulus() does for complex values, the components are
+		 *	scaled by 2^-e, where 2^e is the exponent of the largest component
+		 *	(clamped to the smallest normal), so that the squares neither
+		 *	overflow nor underflow, and the margin is taken from the exponent
+		 *	of the larger scaled norm, at least 2^0, which is margin<N>() of
+		 *	the unscaled norm.
+		 */
+		template<class A>
+		static inline bool _norm(const A& a, const A& b)
+		{
+			using T = typename __geometry_scalar<A>::type;
+			bounds<T> r;
+			_bound(a, b, r);
+			if (r.equal | !r.finite)
+			{
+				return r.equal;
+			}
+			const T min_normal = std::numeric_limits<T>::min();
+			T pow = r.big > min_normal ? exp2i<T>(ilog2(r.big)) : min_normal;
+			sums<T> s;
+			_accumulate(a, b, static_cast<T>(1) / pow, s);
+			using std::sqrt;
+			T norm = sqrt(std::max(s.a, s.b));
+			T m = (norm > static_cast<T>(1) ? exp2i<T>(ilog2(norm)) : static_cast<T>(1)) * exp2i<T>(N - fractional_digits<T>);
+			return s.difference <= m * m;
+		}
+
+		template<class T, std::size_t K, std::size_t... I>
+		static inline std::array<T, K> _negate(const std::array<T, K>& a, std::index_sequence<I...>)
+		{
+			return {{-a[I]...}};
+		}
+
+	public:
+
+		template<class T, std::size_t K>
+		inline bool operator()(const std::array<T, K>& a, const std::array<T, K>& b) const
+		{
+			static_assert(std::is_floating_point<typename __geometry_scalar<T>::type>::value, "proximal_geometry compares arrays of floating point values");
+			return M == geometry_margin::componentwise ? _componentwise(a, b) : _norm(a, b);
+		}
+
+		/*
+		 *	Whether the unit quaternions q and r are close enough to represent
+		 *	the same rotation: q is compared with r and with -r.
+		 */
+		template<class T>
+		inline bool same_rotation(const std::array<T, 4>& q, const std::array<T, 4>& r) const
+		{
+			return (*this)(q, r) | (*this)(q, _negate(r, std::make_index_sequence<4>{}));
+		}
+
+		/*
+		 *	Batch comparisons over arrays of objects, with the layout of
+		 *	proximal::all_close() and proximal::mismatches(): bit i % 64 of
+		 *	mask[i / 64] is set if a[i] and b[i] are not close enough.
+		 */
+
+		template<class T, std::size_t K>
+		inline bool all_close(const std::array<T, K>* a, const std::array<T, K>* b, std::size_t count) const
+		{
+			return _all(a, b, count, [this](const std::array<T, K>& x, const std::array<T, K>& y) { return (*this)(x, y); });
+		}
+
+		template<class T, std::size_t K>
+		inline std::size_t mismatches(const std::array<T, K>* a, const std::array<T, K>* b, std::size_t count, std::uint64_t* mask) const
+		{
+			return _mismatches(a, b, count, mask, [this](const std::array<T, K>& x, const std::array<T, K>& y) { return (*this)(x, y); });
+		}
+
+		template<class T>
+		inline bool all_same_rotation(const std::array<T, 4>* q, const std::array<T, 4>* r, std::size_t count) const
+		{
+			return _all(q, r, count, [this](const std::array<T, 4>& x, const std::array<T, 4>& y) { return same_rotation(x, y); });
+		}
+
+		template<class T>
+		inline std::size_t rotation_mismatches(const std::array<T, 4>* q, const std::array<T, 4>* r, std::size_t count, std::uint64_t* mask) const
+		{
+			return _mismatches(q, r, count, mask, [this](const std::array<T, 4>& x, const std::array<T, 4>& y) { return same_rotation(x, y); });
+		}
+
+	private:
+
+		/*
+		 *	The objects are compared in blocks of 64, whose results are combined
+		 *	without branches, and the scan stops after the first block that
+		 *	mismatches.
+		 */
+		template<class A, class F>
+		static inline bool _all(const A* a, const A* b, std::size_t count, F close)
+		{
+			for (std::size_t i = 0; i < count; i += 64)
+			{
+				bool all = true;
+				for (std::size_t j = i; j < std::min(count, i + 64); ++j)
+				{
+					all &= close(a[j], b[j]);
+				}
+				if (!all)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		template<class A, class F>
+		static inline std::size_t _mismatches(const A* a, const A* b, std::size_t count, std::uint64_t* mask, F close)
+		{
+			std::size_t total = 0;
+			for (std::size_t i = 0; i < count; i += 64)
+			{
+				std::uint64_t word = 0;
+				for (std::size_t j = i; j < std::min(count, i + 64); ++j)
+				{
+					word |= static_cast<std::uint64_t>(!close(a[j], b[j])) << (j - i);
+				}
+				mask[i / 64] = word;
+				total += simd::__popcount(word);
+			}
+			return total;
+		}
+	};
+}
+
+#endif // guard_utils_proximal_geometry_h
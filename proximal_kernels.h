@@ -0,0 +1,343 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ *	Instruction-set independent batch kernels. There is deliberately no include
+ *	guard: proximal_simd.h includes this file once per instruction set, with
+ *	__PROXIMAL_KERNEL_NAMESPACE__ naming the namespace to define the kernels in.
+ *	The kernels are templates over a vector operations type V, which provides:
+ *
+ *		value_type, vec, mask, params	element, register, comparison mask and
+ *										precomputed constants
+ *		storage_type					element of the compared arrays: value_type,
+ *										or a narrower type that load() widens
+ *		width, all_bits					lanes per register, lanes() of an all-true mask
+ *		make_params(n)					constants for margin exponent n
+ *		load(p)							unaligned load of width elements of storage_type
+ *		store(p, v)						unaligned store of width elements
+ *		margin_of(mag, params)			margin for non-negative finite magnitudes
+ *		margins(x, params)				margin of each lane, 0 for Inf and NaN
+ *		close(a, b, params)				lanes that are close enough
+ *		both(m, m)						lanes true in both masks
+ *		lanes(m)						mask as an integer, one bit per lane
+ *		splat(x), max(v, v)				broadcast, lane-wise maximum
+ *		greater(v, v)					lanes where the first operand is greater
+ *		errors(a, b, params, e, u)		error |a - b| of each lane, and the error in
+ *										ulps for params made with n = 0
+ *		deinterleave(v0, v1, re, im)	split 2 * width interleaved parts of complex
+ *										values into real and imaginary parts
+ *		close_modulus(ar, ai, br, bi, p)	lanes whose complex values are close
+ *										enough in modulus (see __close_modulus())
+ *
+ *	all_close(), mismatches() and stats() take a second operations type R for
+ *	the second array, V by default. R differs from V only in storage_type and
+ *	load(), e.g. to round double references to float as they are loaded.
+ */
+
+namespace utils
+{
+	namespace simd
+	{
+		namespace __PROXIMAL_KERNEL_NAMESPACE__
+		{
+			/*
+			 *	Load the last partial register, padding it with zeros, which
+			 *	compare as close enough.
+			 */
+			template<class V>
+			inline typename V::vec load_tail(const typename V::storage_type* p, std::size_t count)
+			{
+				typename V::storage_type buffer[V::width] = {};
+				std::memcpy(buffer, p, count * sizeof(*p));
+				return V::load(buffer);
+			}
+
+			/*
+			 *	result[i] = margin of x[i] with exponent n (the ulp for n = 0).
+			 */
+			template<class V>
+			inline void margins(const typename V::value_type* x, typename V::value_type* result, std::size_t count, int n)
+			{
+				constexpr std::size_t w = V::width;
+				const typename V::params p = V::make_params(n);
+				std::size_t i = 0;
+				for (; i + 2 * w <= count; i += 2 * w)
+				{
+					V::store(result + i, V::margins(V::load(x + i), p));
+					V::store(result + i + w, V::margins(V::load(x + i + w), p));
+				}
+				for (; i + w <= count; i += w)
+				{
+					V::store(result + i, V::margins(V::load(x + i), p));
+				}
+				if (i < count)
+				{
+					typename V::value_type buffer[w];
+					V::store(buffer, V::margins(load_tail<V>(x + i, count - i), p));
+					std::memcpy(result + i, buffer, (count - i) * sizeof(*result));
+				}
+			}
+
+			template<class V, class R = V>
+			inline bool all_close(const typename V::storage_type* a, const typename R::storage_type* b, std::size_t count, int n)
+			{
+				constexpr std::size_t w = V::width;
+				const typename V::params p = V::make_params(n);
+				std::size_t i = 0;
+				for (; i + 4 * w <= count; i += 4 * w)
+				{
+					typename V::mask m0 = V::close(V::load(a + i), R::load(b + i), p);
+					typename V::mask m1 = V::close(V::load(a + i + w), R::load(b + i + w), p);
+					typename V::mask m2 = V::close(V::load(a + i + 2 * w), R::load(b + i + 2 * w), p);
+					typename V::mask m3 = V::close(V::load(a + i + 3 * w), R::load(b + i + 3 * w), p);
+					if (V::lanes(V::both(V::both(m0, m1), V::both(m2, m3))) != V::all_bits)
+					{
+						return false;
+					}
+				}
+				for (; i + w <= count; i += w)
+				{
+					if (V::lanes(V::close(V::load(a + i), R::load(b + i), p)) != V::all_bits)
+					{
+						return false;
+					}
+				}
+				if (i < count)
+				{
+					typename V::mask m = V::close(load_tail<V>(a + i, count - i), load_tail<R>(b + i, count - i), p);
+					return V::lanes(m) == V::all_bits;
+				}
+				return true;
+			}
+
+			/*
+			 *	Write one bit per element, set where the pair is not close enough,
+			 *	packed into 64-bit words in element order (bit i % 64 of word i / 64).
+			 *	Bits past count in the last word are cleared. Returns the number of
+			 *	bits set.
+			 */
+			template<class V, class R = V>
+			inline std::size_t mismatches(const typename V::storage_type* a, const typename R::storage_type* b, std::size_t count, int n, std::uint64_t* mask)
+			{
+				constexpr std::size_t w = V::width;
+				const typename V::params p = V::make_params(n);
+				std::size_t total = 0;
+				std::size_t i = 0;
+				for (; i + 64 <= count; i += 64)
+				{
+					std::uint64_t word = 0;
+					for (std::size_t j = 0; j < 64; j += w)
+					{
+						unsigned lanes = V::lanes(V::close(V::load(a + i + j), R::load(b + i + j), p));
+						word |= static_cast<std::uint64_t>(~lanes & V::all_bits) << j;
+					}
+					*mask++ = word;
+					total += __popcount(word);
+				}
+				if (i < count)
+				{
+					std::uint64_t word = 0;
+					std::size_t j = 0;
+					for (; i + j + w <= count; j += w)
+					{
+						unsigned lanes = V::lanes(V::close(V::load(a + i + j), R::load(b + i + j), p));
+						word |= static_cast<std::uint64_t>(~lanes & V::all_bits) << j;
+					}
+					if (i + j < count)
+					{
+						std::size_t rest = count - i - j;
+						unsigned lanes = V::lanes(V::close(load_tail<V>(a + i + j, rest), load_tail<R>(b + i + j, rest), p));
+						word |= static_cast<std::uint64_t>(~lanes & V::all_bits) << j;
+					}
+					*mask = word;
+					total += __popcount(word);
+				}
+				return total;
+			}
+
+			template<class V>
+			inline void __accumulate(typename V::vec a, typename V::vec b, std::size_t index, const typename V::params& p, const typename V::params& unit,
+				typename V::vec& max_error, typename V::vec& max_ulps, proximal_stats<typename V::value_type>& s)
+			{
+				unsigned failed = ~V::lanes(V::close(a, b, p)) & V::all_bits;
+				if (failed != 0)
+				{
+					if (s.mismatches == 0)
+					{
+						s.first_mismatch = index + __lowest_bit(failed);
+					}
+					s.mismatches += __popcount(failed);
+				}
+				typename V::vec error;
+				typename V::vec ulps;
+				V::errors(a, b, unit, error, ulps);
+				max_error = V::max(max_error, error);
+				if (V::lanes(V::greater(ulps, max_ulps)) != 0)
+				{
+					typename V::value_type buffer[V::width];
+					V::store(buffer, ulps);
+					for (std::size_t j = 0; j < V::width; ++j)
+					{
+						if (buffer[j] > s.max_ulps)
+						{
+							s.max_ulps = buffer[j];
+							s.worst = index + j;
+						}
+					}
+					max_ulps = V::splat(s.max_ulps);
+				}
+			}
+
+			/*
+			 *	Mismatch count, first mismatch, maximum error and maximum error in
+			 *	ulps, in one pass; element i is reported as index first_index + i.
+			 *	The maximum in ulps rarely increases after the first few registers,
+			 *	so a register that raises it is resolved lane by lane in element
+			 *	order, and the worst index is the first at which the maximum occurs.
+			 */
+			template<class V, class R = V>
+			inline proximal_stats<typename V::value_type> stats(const typename V::storage_type* a, const typename R::storage_type* b, std::size_t count, int n, std::size_t first_index)
+			{
+				using T = typename V::value_type;
+				constexpr std::size_t w = V::width;
+				const typename V::params p = V::make_params(n);
+				const typename V::params unit = V::make_params(0);
+				proximal_stats<T> s;
+				typename V::vec max_error = V::splat(0);
+				typename V::vec max_ulps = V::splat(0);
+				std::size_t i = 0;
+				for (; i + w <= count; i += w)
+				{
+					__accumulate<V>(V::load(a + i), R::load(b + i), first_index + i, p, unit, max_error, max_ulps, s);
+				}
+				if (i < count)
+				{
+					__accumulate<V>(load_tail<V>(a + i, count - i), load_tail<R>(b + i, count - i), first_index + i, p, unit, max_error, max_ulps, s);
+				}
+				T buffer[w];
+				V::store(buffer, max_error);
+				for (std::size_t j = 0; j < w; ++j)
+				{
+					s.max_error = buffer[j] > s.max_error ? buffer[j] : s.max_error;
+				}
+				s.count = count;
+				return s;
+			}
+
+			/*
+			 *	Complex kernels, over count values stored as interleaved real and
+			 *	imaginary parts (the layout of std::complex arrays). Each step
+			 *	loads two registers of parts, and deinterleave() turns them into
+			 *	registers of real and imaginary parts for width values.
+			 */
+			template<class V>
+			inline typename V::mask __close_modulus(typename V::vec a0, typename V::vec a1, typename V::vec b0, typename V::vec b1, const typename V::params& p)
+			{
+				typename V::vec ar, ai, br, bi;
+				V::deinterleave(a0, a1, ar, ai);
+				V::deinterleave(b0, b1, br, bi);
+				return V::close_modulus(ar, ai, br, bi, p);
+			}
+
+			/*
+			 *	The last count (< width) values, padded with zeros.
+			 */
+			template<class V>
+			inline typename V::mask __close_modulus_tail(const typename V::value_type* a, const typename V::value_type* b, std::size_t count, const typename V::params& p)
+			{
+				constexpr std::size_t w = V::width;
+				const std::size_t parts = 2 * count;
+				typename V::vec a0 = load_tail<V>(a, parts < w ? parts : w);
+				typename V::vec b0 = load_tail<V>(b, parts < w ? parts : w);
+				typename V::vec a1 = parts > w ? load_tail<V>(a + w, parts - w) : V::splat(0);
+				typename V::vec b1 = parts > w ? load_tail<V>(b + w, parts - w) : V::splat(0);
+				return __close_modulus<V>(a0, a1, b0, b1, p);
+			}
+
+			template<class V>
+			inline bool all_close_modulus(const typename V::value_type* a, const typename V::value_type* b, std::size_t count, int n)
+			{
+				constexpr std::size_t w = V::width;
+				const typename V::params p = V::make_params(n);
+				std::size_t i = 0;
+				for (; i + 2 * w <= count; i += 2 * w)
+				{
+					const typename V::value_type* x = a + 2 * i;
+					const typename V::value_type* y = b + 2 * i;
+					typename V::mask m0 = __close_modulus<V>(V::load(x), V::load(x + w), V::load(y), V::load(y + w), p);
+					typename V::mask m1 = __close_modulus<V>(V::load(x + 2 * w), V::load(x + 3 * w), V::load(y + 2 * w), V::load(y + 3 * w), p);
+					if (V::lanes(V::both(m0, m1)) != V::all_bits)
+					{
+						return false;
+					}
+				}
+				for (; i + w <= count; i += w)
+				{
+					const typename V::value_type* x = a + 2 * i;
+					const typename V::value_type* y = b + 2 * i;
+					if (V::lanes(__close_modulus<V>(V::load(x), V::load(x + w), V::load(y), V::load(y + w), p)) != V::all_bits)
+					{
+						return false;
+					}
+				}
+				if (i < count)
+				{
+					return V::lanes(__close_modulus_tail<V>(a + 2 * i, b + 2 * i, count - i, p)) == V::all_bits;
+				}
+				return true;
+			}
+
+			/*
+			 *	As mismatches(), one bit per complex value.
+			 */
+			template<class V>
+			inline std::size_t mismatches_modulus(const typename V::value_type* a, const typename V::value_type* b, std::size_t count, int n, std::uint64_t* mask)
+			{
+				constexpr std::size_t w = V::width;
+				const typename V::params p = V::make_params(n);
+				std::size_t total = 0;
+				for (std::size_t i = 0; i < count; i += 64)
+				{
+					std::uint64_t word = 0;
+					std::size_t j = 0;
+					for (; j < 64 && i + j + w <= count; j += w)
+					{
+						const typename V::value_type* x = a + 2 * (i + j);
+						const typename V::value_type* y = b + 2 * (i + j);
+						unsigned lanes = V::lanes(__close_modulus<V>(V::load(x), V::load(x + w), V::load(y), V::load(y + w), p));
+						word |= static_cast<std::uint64_t>(~lanes & V::all_bits) << j;
+					}
+					if (j < 64 && i + j < count)
+					{
+						unsigned lanes = V::lanes(__close_modulus_tail<V>(a + 2 * (i + j), b + 2 * (i + j), count - i - j, p));
+						word |= static_cast<std::uint64_t>(~lanes & V::all_bits) << j;
+					}
+					*mask++ = word;
+					total += __popcount(word);
+				}
+				return total;
+			}
+		}
+	}
+}
@@ -0,0 +1,537 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef guard_utils_proximal_parallel_h
+#define guard_utils_proximal_parallel_h
+
+#include "proximal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *	Multithreaded forms of the batch comparisons. The arrays are split into
+ *	chunks small enough to stay in cache, and the chunks are processed by a
+ *	pool of worker threads that steal work from each other when their own
+ *	share runs out. all_close() stops every worker as soon as one chunk
+ *	mismatches.
+ *
+ *	On Linux, a pool can also place work NUMA-locally: its threads are pinned
+ *	to processors, and each chunk is first assigned to a thread on the node
+ *	that holds the chunk's memory. Set the following define to 0 to disable
+ *	the placement code (chunks are then assigned in address order).
+ */
+
+#ifndef __USE_NUMA_PLACEMENT__
+#if defined(__linux__)
+#define __USE_NUMA_PLACEMENT__ 1
+#else
+#define __USE_NUMA_PLACEMENT__ 0
+#endif
+#endif
+
+#if (__USE_NUMA_PLACEMENT__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace utils
+{
+	namespace parallel
+	{
+	#if (__USE_NUMA_PLACEMENT__)
+
+		/*
+		 *	The node of the processor the calling thread is running on, or -1.
+		 */
+		inline int __current_node()
+		{
+			unsigned cpu = 0;
+			unsigned node = 0;
+			return syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 ? static_cast<int>(node) : -1;
+		}
+
+		/*
+		 *	Pin the calling thread to the index-th processor it is allowed to run on.
+		 */
+		inline void __pin_thread(unsigned index)
+		{
+			cpu_set_t allowed;
+			CPU_ZERO(&allowed);
+			if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+			{
+				return;
+			}
+			unsigned target = index % static_cast<unsigned>(CPU_COUNT(&allowed));
+			for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			{
+				if (CPU_ISSET(cpu, &allowed) && target-- == 0)
+				{
+					cpu_set_t one;
+					CPU_ZERO(&one);
+					CPU_SET(cpu, &one);
+					sched_setaffinity(0, sizeof(one), &one);
+					return;
+				}
+			}
+		}
+
+		/*
+		 *	The node holding the page at base + i * stride, for each i < count,
+		 *	or -1 where that is unknown (the page is not yet mapped, or the kernel
+		 *	has no NUMA support). move_pages() with no target nodes only reports.
+		 */
+		inline std::vector<int> __page_nodes(const void* base, std::size_t stride, std::size_t count)
+		{
+			std::vector<void*> pages(count);
+			std::vector<int> status(count, -1);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				pages[i] = const_cast<char*>(static_cast<const char*>(base)) + i * stride;
+			}
+			if (syscall(SYS_move_pages, 0, count, pages.data(), nullptr, status.data(), 0) != 0)
+			{
+				std::fill(status.begin(), status.end(), -1);
+			}
+			return status;
+		}
+
+	#else
+
+		inline int __current_node()
+		{
+			return -1;
+		}
+
+		inline void __pin_thread(unsigned)
+		{
+		}
+
+		inline std::vector<int> __page_nodes(const void*, std::size_t, std::size_t count)
+		{
+			return std::vector<int>(count, -1);
+		}
+
+	#endif // __USE_NUMA_PLACEMENT__
+
+		/*
+		 *	A fixed set of worker threads that run chunked jobs. The calling thread
+		 *	takes part in each job, so a pool of size n starts n - 1 threads.
+		 *
+		 *	Each participant owns a range of chunks, and takes chunks from the
+		 *	front of it. When its range is empty it steals the back half of the
+		 *	range of another participant. Jobs run one at a time; a task must not
+		 *	throw, and must not start another job on the same pool.
+		 */
+		class pool
+		{
+		public:
+
+			/*
+			 *	threads is the number of participants, including the caller (0 for
+			 *	one per hardware thread). With numa_local, the worker threads are
+			 *	pinned to processors, and jobs given the address of their data
+			 *	assign each chunk to a participant on the node that holds it.
+			 */
+			explicit inline pool(unsigned threads = 0, bool numa_local = false)
+			:
+			numa_local_{numa_local}
+			{
+				if (threads == 0)
+				{
+					threads = std::max(1u, std::thread::hardware_concurrency());
+				}
+				for (unsigned i = 0; i < threads; ++i)
+				{
+					slots_.emplace_back(new slot);
+				}
+				for (unsigned i = 1; i < threads; ++i)
+				{
+					threads_.emplace_back([this, i] { _worker(i); });
+				}
+				std::unique_lock<std::mutex> lock{state_lock_};
+				done_.wait(lock, [this] { return ready_ == threads_.size(); });
+			}
+
+			inline ~pool()
+			{
+				{
+					std::lock_guard<std::mutex> lock{state_lock_};
+					shutdown_ = true;
+				}
+				start_.notify_all();
+				for (auto& t : threads_)
+				{
+					t.join();
+				}
+			}
+
+			pool(const pool&) = delete;
+			pool& operator=(const pool&) = delete;
+
+			inline unsigned size() const
+			{
+				return static_cast<unsigned>(slots_.size());
+			}
+
+			inline bool numa_local() const
+			{
+				return numa_local_;
+			}
+
+			/*
+			 *	Call task(i) for each chunk i in [0, chunks). A task returns false to
+			 *	cancel the job: chunks not yet started are skipped. Returns false if
+			 *	the job was cancelled. For NUMA placement, chunk i starts at
+			 *	base + i * stride bytes.
+			 */
+			template<class F>
+			inline bool run(std::size_t chunks, F&& task, const void* base = nullptr, std::size_t stride = 0)
+			{
+				using task_type = typename std::remove_reference<F>::type;
+				std::lock_guard<std::mutex> job{run_lock_};
+				_distribute(chunks, base, stride);
+				cancel_.store(false, std::memory_order_relaxed);
+				task_ = &task;
+				call_ = [](void* t, std::size_t i) -> bool { return (*static_cast<task_type*>(t))(i); };
+				if (!threads_.empty())
+				{
+					{
+						std::lock_guard<std::mutex> lock{state_lock_};
+						busy_ = threads_.size();
+						++generation_;
+					}
+					start_.notify_all();
+				}
+				_work(0);
+				if (!threads_.empty())
+				{
+					std::unique_lock<std::mutex> lock{state_lock_};
+					done_.wait(lock, [this] { return busy_ == 0; });
+				}
+				return !cancel_.load(std::memory_order_relaxed);
+			}
+
+		private:
+
+			struct slot
+			{
+				std::mutex lock;
+				std::size_t begin = 0;
+				std::size_t end = 0;
+				int node = -1;
+			};
+
+			inline void _worker(unsigned index)
+			{
+				if (numa_local_)
+				{
+					__pin_thread(index);
+					slots_[index]->node = __current_node();
+				}
+				std::uint64_t seen = 0;
+				{
+					std::lock_guard<std::mutex> lock{state_lock_};
+					++ready_;
+				}
+				done_.notify_one();
+				for (;;)
+				{
+					{
+						std::unique_lock<std::mutex> lock{state_lock_};
+						start_.wait(lock, [&] { return shutdown_ || generation_ != seen; });
+						if (shutdown_)
+						{
+							return;
+						}
+						seen = generation_;
+					}
+					_work(index);
+					std::lock_guard<std::mutex> lock{state_lock_};
+					if (--busy_ == 0)
+					{
+						done_.notify_one();
+					}
+				}
+			}
+
+			inline bool _take(unsigned index, std::size_t& k)
+			{
+				slot& own = *slots_[index];
+				std::lock_guard<std::mutex> lock{own.lock};
+				if (own.begin == own.end)
+				{
+					return false;
+				}
+				k = own.begin++;
+				return true;
+			}
+
+			inline bool _steal(unsigned index, std::size_t& k)
+			{
+				const unsigned n = size();
+				for (unsigned v = 1; v < n; ++v)
+				{
+					slot& victim = *slots_[(index + v) % n];
+					std::size_t first;
+					std::size_t last;
+					{
+						std::lock_guard<std::mutex> lock{victim.lock};
+						std::size_t available = victim.end - victim.begin;
+						if (available == 0)
+						{
+							continue;
+						}
+						last = victim.end;
+						first = last - (available + 1) / 2;
+						victim.end = first;
+					}
+					slot& own = *slots_[index];
+					std::lock_guard<std::mutex> lock{own.lock};
+					own.begin = first + 1;
+					own.end = last;
+					k = first;
+					return true;
+				}
+				return false;
+			}
+
+			inline void _work(unsigned index)
+			{
+				std::size_t k;
+				while (!cancel_.load(std::memory_order_relaxed) && (_take(index, k) || _steal(index, k)))
+				{
+					if (!call_(task_, order_.empty() ? k : order_[k]))
+					{
+						cancel_.store(true, std::memory_order_relaxed);
+					}
+				}
+			}
+
+			/*
+			 *	Give each participant its initial range. Without placement, the
+			 *	chunks are split into equal consecutive ranges. With placement, the
+			 *	chunks on each node are shared among that node's participants, and
+			 *	the rest among everyone; order_ maps range positions to chunks.
+			 */
+			inline void _distribute(std::size_t chunks, const void* base, std::size_t stride)
+			{
+				const unsigned n = size();
+				order_.clear();
+				if (numa_local_ && base != nullptr)
+				{
+					slots_[0]->node = __current_node();
+					std::vector<int> nodes = __page_nodes(base, stride, chunks);
+					std::vector<std::vector<std::size_t>> assigned(n);
+					std::vector<std::size_t> unplaced;
+					std::vector<unsigned> local;
+					std::vector<std::size_t> turn;
+					for (std::size_t c = 0; c < chunks; ++c)
+					{
+						local.clear();
+						for (unsigned i = 0; i < n; ++i)
+						{
+							if (nodes[c] >= 0 && slots_[i]->node == nodes[c])
+							{
+								local.push_back(i);
+							}
+						}
+						if (local.empty())
+						{
+							unplaced.push_back(c);
+							continue;
+						}
+						if (turn.size() <= static_cast<std::size_t>(nodes[c]))
+						{
+							turn.resize(nodes[c] + 1, 0);
+						}
+						assigned[local[turn[nodes[c]]++ % local.size()]].push_back(c);
+					}
+					for (std::size_t j = 0; j < unplaced.size(); ++j)
+					{
+						assigned[j * n / unplaced.size()].push_back(unplaced[j]);
+					}
+					for (unsigned i = 0; i < n; ++i)
+					{
+						slots_[i]->begin = order_.size();
+						order_.insert(order_.end(), assigned[i].begin(), assigned[i].end());
+						slots_[i]->end = order_.size();
+					}
+					return;
+				}
+				for (unsigned i = 0; i < n; ++i)
+				{
+					slots_[i]->begin = chunks * i / n;
+					slots_[i]->end = chunks * (i + 1) / n;
+				}
+			}
+
+			bool numa_local_;
+			std::vector<std::unique_ptr<slot>> slots_;
+			std::vector<std::thread> threads_;
+			std::vector<std::size_t> order_;
+			std::mutex run_lock_;
+			std::mutex state_lock_;
+			std::condition_variable start_;
+			std::condition_variable done_;
+			std::uint64_t generation_ = 0;
+			std::size_t busy_ = 0;
+			std::size_t ready_ = 0;
+			bool shutdown_ = false;
+			std::atomic<bool> cancel_{false};
+			bool (*call_)(void*, std::size_t) = nullptr;
+			void* task_ = nullptr;
+		};
+
+		/*
+		 *	The pools used when options::workers is not set, one thread per
+		 *	hardware thread, created on first use.
+		 */
+		inline pool& default_pool(bool numa_local = false)
+		{
+			if (numa_local)
+			{
+				static pool pinned{0, true};
+				return pinned;
+			}
+			static pool shared{0, false};
+			return shared;
+		}
+
+		struct options
+		{
+			/*
+			 *	Bytes of both operands per chunk. The default keeps a chunk of each
+			 *	array in a typical L2 cache.
+			 */
+			std::size_t chunk_bytes = 256 * 1024;
+
+			/*
+			 *	Use the NUMA-placing default pool. Ignored when workers is set; the
+			 *	pool's own setting applies.
+			 */
+			bool numa_local = false;
+
+			pool* workers = nullptr;
+		};
+
+		/*
+		 *	Elements per chunk: a multiple of 64, so that every chunk of a
+		 *	mismatch mask starts on a word boundary.
+		 */
+		template<class T>
+		inline std::size_t __chunk_elements(const options& opts)
+		{
+			return std::max<std::size_t>(1, opts.chunk_bytes / (2 * sizeof(T) * 64)) * 64;
+		}
+
+		inline pool& __pool_for(const options& opts)
+		{
+			return opts.workers ? *opts.workers : default_pool(opts.numa_local);
+		}
+
+		/*
+		 *	close_enough.all_close(a, b, count), for proximal<N> or
+		 *	proximal_dynamic, with the chunks spread over a pool.
+		 */
+		template<class P, class T>
+		inline bool all_close(const P& close_enough, const T* a, const T* b, std::size_t count, const options& opts = options{})
+		{
+			const std::size_t chunk = __chunk_elements<T>(opts);
+			const std::size_t chunks = (count + chunk - 1) / chunk;
+			if (chunks <= 1)
+			{
+				return close_enough.all_close(a, b, count);
+			}
+			return __pool_for(opts).run(chunks, [&](std::size_t i)
+			{
+				const std::size_t first = i * chunk;
+				return close_enough.all_close(a + first, b + first, std::min(chunk, count - first));
+			}, a, chunk * sizeof(T));
+		}
+
+		/*
+		 *	close_enough.mismatches(a, b, count, mask), with the chunks spread over
+		 *	a pool. The mask has the same layout as the sequential form.
+		 */
+		template<class P, class T>
+		inline std::size_t mismatches(const P& close_enough, const T* a, const T* b, std::size_t count, std::uint64_t* mask, const options& opts = options{})
+		{
+			const std::size_t chunk = __chunk_elements<T>(opts);
+			const std::size_t chunks = (count + chunk - 1) / chunk;
+			if (chunks <= 1)
+			{
+				return close_enough.mismatches(a, b, count, mask);
+			}
+			std::atomic<std::size_t> total{0};
+			__pool_for(opts).run(chunks, [&](std::size_t i)
+			{
+				const std::size_t first = i * chunk;
+				total.fetch_add(close_enough.mismatches(a + first, b + first, std::min(chunk, count - first), mask + first / 64), std::memory_order_relaxed);
+				return true;
+			}, a, chunk * sizeof(T));
+			return total.load(std::memory_order_relaxed);
+		}
+
+		/*
+		 *	close_enough.stats(a, b, count), with the chunks spread over a pool
+		 *	and their statistics merged.
+		 */
+		template<class P, class T>
+		inline auto stats(const P& close_enough, const T* a, const T* b, std::size_t count, const options& opts = options{})
+			-> decltype(close_enough.stats(a, b, count))
+		{
+			using stats_type = decltype(close_enough.stats(a, b, count));
+			const std::size_t chunk = __chunk_elements<T>(opts);
+			const std::size_t chunks = (count + chunk - 1) / chunk;
+			if (chunks <= 1)
+			{
+				return close_enough.stats(a, b, count);
+			}
+			std::vector<stats_type> partial(chunks);
+			__pool_for(opts).run(chunks, [&](std::size_t i)
+			{
+				const std::size_t first = i * chunk;
+				partial[i] = close_enough.stats(a + first, b + first, std::min(chunk, count - first), first);
+				return true;
+			}, a, chunk * sizeof(T));
+			stats_type total;
+			for (const auto& s : partial)
+			{
+				total.merge(s);
+			}
+			return total;
+		}
+	}
+}
+
+#endif /* guard_utils_proximal_parallel_h */
@@ -0,0 +1,412 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef guard_utils_proximal_search_h
+#define guard_utils_proximal_search_h
+
+#include "proximal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/*
+ *	Searches of sorted arrays (in ascending order, without NaN) for the
+ *	elements close enough to a value x, as proximal<N> defines it.
+ *
+ *	An element y can only be close to x if |y - x| <= margin<N + 1>(x): the
+ *	margin of y is at most twice that of x, since y is at most one binade
+ *	above it. A search finds the start of that window with a binary search,
+ *	and scans the window for the first and last elements that are close
+ *	enough. The range returned runs from the first to the last of them, so it
+ *	holds every close element. Within a binade the close elements are
+ *	contiguous, but just below a power of two, where the margin doubles, an
+ *	element may be farther from x than one past the power of two; such an
+ *	element lies inside the range without being close. If no element is close,
+ *	the range is empty, at the position where x would be inserted.
+ *
+ *	The binary search is branchless: each step is a conditional move, whose
+ *	cost does not depend on how predictable the data is, and the probes of
+ *	the next steps are prefetched. proximal_eytzinger stores a copy of the
+ *	table in Eytzinger (breadth-first) order, in which the next levels of a
+ *	search share cache lines and can be prefetched. Both have batch forms
+ *	that advance a group of searches in lockstep, so that the memory
+ *	accesses of the group overlap, and return the same ranges as the
+ *	single searches.
+ */
+
+namespace utils
+{
+	inline void __prefetch(const void* p)
+	{
+	#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(p);
+	#else
+		(void)p;
+	#endif
+	}
+
+	/*
+	 *	The first element of [first, first + count) that is not less than
+	 *	value, without branches on the data. A branchless step can't start
+	 *	loading the next probe until the comparison is done, which a
+	 *	predicted branch would have guessed, so the four elements the next
+	 *	two steps may read are prefetched, so that on tables larger than the
+	 *	cache their misses overlap with the current one. Once the rest of the
+	 *	search fits in a few cache lines they no longer help.
+	 */
+	template<class I, class T>
+	inline I __branchless_lower_bound(I first, std::size_t count, const T& value)
+	{
+		constexpr std::size_t prefetched = 256 / sizeof(T);
+		while (count > prefetched)
+		{
+			std::size_t half = count / 2;
+			std::size_t next = (count - half) / 2;
+			std::size_t after = (count - half - next) / 2;
+			__prefetch(&first[next + after - 1]);
+			__prefetch(&first[after - 1]);
+			__prefetch(&first[half + after - 1]);
+			__prefetch(&first[half + next + after - 1]);
+			// a multiply rather than a conditional, which compilers turn into a branch
+			first += static_cast<std::ptrdiff_t>(half * static_cast<std::size_t>(first[half - 1] < value));
+			count -= half;
+		}
+		while (count > 1)
+		{
+			std::size_t half = count / 2;
+			first += static_cast<std::ptrdiff_t>(half * static_cast<std::size_t>(first[half - 1] < value));
+			count -= half;
+		}
+		return first + static_cast<std::ptrdiff_t>(count == 1 && *first < value);
+	}
+
+	/*
+	 *	The range of the elements close to x among those from lo, the first
+	 *	element of [first, last) not less than x - margin<N + 1>(x), to the end
+	 *	of the window.
+	 */
+	template<int N, class I, class T>
+	inline std::pair<I, I> __proximal_scan(I lo, I last, const T& x)
+	{
+		const T upper = x + margin<N + 1>(x);
+		I begin = last;
+		I end = last;
+		I insertion = last;
+		bool found = false;
+		bool placed = false;
+		for (; lo != last && !(upper < *lo); ++lo)
+		{
+			if (!placed && !(*lo < x))
+			{
+				insertion = lo;
+				placed = true;
+			}
+			if (proximal<N>{}(*lo, x))
+			{
+				begin = found ? begin : lo;
+				end = std::next(lo);
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			insertion = placed ? insertion : lo;
+			return {insertion, insertion};
+		}
+		return {begin, end};
+	}
+
+	/*
+	 *	The range from the first to the last element of [first, last) that is
+	 *	close enough to x (see above), or an empty range where x would be
+	 *	inserted. NaN is close to nothing, and gives an empty range at last.
+	 */
+	template<int N = 1, class I>
+	inline std::pair<I, I> proximal_equal_range(I first, I last, const typename std::iterator_traits<I>::value_type& x)
+	{
+		if (__is_nan(x))
+		{
+			return {last, last};
+		}
+		const std::size_t count = static_cast<std::size_t>(std::distance(first, last));
+		I lo = __branchless_lower_bound(first, count, x - margin<N + 1>(x));
+		return __proximal_scan<N>(lo, last, x);
+	}
+
+	template<int N = 1, class I>
+	inline I proximal_lower_bound(I first, I last, const typename std::iterator_traits<I>::value_type& x)
+	{
+		return proximal_equal_range<N>(first, last, x).first;
+	}
+
+	template<int N = 1, class I>
+	inline I proximal_upper_bound(I first, I last, const typename std::iterator_traits<I>::value_type& x)
+	{
+		return proximal_equal_range<N>(first, last, x).second;
+	}
+
+	/*
+	 *	The element of [first, last) nearest to x among those close enough to
+	 *	it (the first of equals), or last.
+	 */
+	template<int N = 1, class I>
+	inline I proximal_find(I first, I last, const typename std::iterator_traits<I>::value_type& x)
+	{
+		std::pair<I, I> range = proximal_equal_range<N>(first, last, x);
+		I nearest = last;
+		for (I it = range.first; it != range.second; ++it)
+		{
+			if (proximal<N>{}(*it, x) && (nearest == last || __abs(*it - x) < __abs(*nearest - x)))
+			{
+				nearest = it;
+			}
+		}
+		return nearest;
+	}
+
+	/*
+	 *	Batch form: ranges[i] holds the indices [begin, end) of the range of
+	 *	queries[i] in the sorted array [first, first + count). The binary
+	 *	searches of a group of queries take the same number of steps, so they
+	 *	run in lockstep, and the next element each one will read is prefetched
+	 *	while the others step.
+	 */
+	template<int N = 1, class T>
+	inline void proximal_equal_range(const T* first, std::size_t count, const T* queries, std::size_t query_count,
+		std::pair<std::size_t, std::size_t>* ranges)
+	{
+		constexpr std::size_t group = 16;
+		const T* const last = first + count;
+		for (std::size_t q = 0; q < query_count; q += group)
+		{
+			const std::size_t width = std::min(group, query_count - q);
+			const T* base[group];
+			T lower[group];
+			for (std::size_t j = 0; j < width; ++j)
+			{
+				base[j] = first;
+				lower[j] = __is_nan(queries[q + j]) ? queries[q + j] : queries[q + j] - margin<N + 1>(queries[q + j]);
+			}
+			std::size_t n = count;
+			while (n > 1)
+			{
+				const std::size_t half = n / 2;
+				const std::size_t next = (n - half) / 2;
+				for (std::size_t j = 0; j < width; ++j)
+				{
+					base[j] += half * static_cast<std::size_t>(base[j][half - 1] < lower[j]);
+					__prefetch(base[j] + (next > 0 ? next - 1 : 0));
+				}
+				n -= half;
+			}
+			for (std::size_t j = 0; j < width; ++j)
+			{
+				const T x = queries[q + j];
+				const T* lo = base[j] + static_cast<std::ptrdiff_t>(n == 1 && *base[j] < lower[j]);
+				std::pair<const T*, const T*> range = __is_nan(x) ? std::make_pair(last, last) : __proximal_scan<N>(lo, last, x);
+				ranges[q + j] = {static_cast<std::size_t>(range.first - first), static_cast<std::size_t>(range.second - first)};
+			}
+		}
+	}
+
+	/*
+	 *	A search index over a sorted array, in Eytzinger order: the children of
+	 *	the element at position k (from 1) are at 2k and 2k + 1. The positions
+	 *	visited by a search are all within the first few cache lines of each
+	 *	level, and with the array aligned to cache lines the 2^b descendants of
+	 *	k, b levels down, share one line, so a search prefetches the line it
+	 *	will need b levels ahead. The index holds a copy of the values, and the
+	 *	sorted array itself, which must outlive it, is scanned for the
+	 *	elements close to each query. Results are indices into the sorted array.
+	 */
+	template<class T, int N = 1>
+	class proximal_eytzinger
+	{
+	public:
+		inline proximal_eytzinger(const T* sorted, std::size_t count)
+		:
+		sorted_{sorted},
+		count_{count},
+		storage_(count + 1 + line / sizeof(T))
+		{
+			// align position 0 to a cache line
+			std::size_t offset = (line - reinterpret_cast<std::uintptr_t>(storage_.data()) % line) % line;
+			tree_ = storage_.data() + offset / sizeof(T);
+			std::size_t i = 0;
+			_build(1, i);
+			height_ = 0;
+			while ((std::size_t{2} << height_) - 1 <= count_)
+			{
+				++height_;
+			}
+		}
+
+		proximal_eytzinger(const proximal_eytzinger&) = delete;
+		proximal_eytzinger& operator=(const proximal_eytzinger&) = delete;
+
+		inline std::size_t size() const
+		{
+			return count_;
+		}
+
+		/*
+		 *	The indices [begin, end) of the range of x in the sorted array (see
+		 *	proximal_equal_range()).
+		 */
+		inline std::pair<std::size_t, std::size_t> equal_range(T x) const
+		{
+			if (__is_nan(x))
+			{
+				return {count_, count_};
+			}
+			std::size_t k = 1;
+			const T lower = x - margin<N + 1>(x);
+			while (k <= count_)
+			{
+				// clamped, so that the pointer stays within the tree on the last levels
+				__prefetch(tree_ + std::min(k * per_line, count_));
+				k = 2 * k + static_cast<std::size_t>(tree_[k] < lower);
+			}
+			return _range(k, x);
+		}
+
+		/*
+		 *	The index of the element nearest to x among those close enough to
+		 *	it, or size().
+		 */
+		inline std::size_t find(T x) const
+		{
+			std::pair<std::size_t, std::size_t> range = equal_range(x);
+			const T* nearest = proximal_find<N>(sorted_ + range.first, sorted_ + range.second, x);
+			return nearest == sorted_ + range.second ? count_ : static_cast<std::size_t>(nearest - sorted_);
+		}
+
+		/*
+		 *	Batch form, as for arrays: a group of searches descends the tree
+		 *	level by level in lockstep.
+		 */
+		inline void equal_range(const T* queries, std::size_t query_count, std::pair<std::size_t, std::size_t>* ranges) const
+		{
+			constexpr std::size_t group = 16;
+			for (std::size_t q = 0; q < query_count; q += group)
+			{
+				const std::size_t width = std::min(group, query_count - q);
+				std::size_t k[group];
+				T lower[group];
+				for (std::size_t j = 0; j < width; ++j)
+				{
+					k[j] = 1;
+					lower[j] = __is_nan(queries[q + j]) ? queries[q + j] : queries[q + j] - margin<N + 1>(queries[q + j]);
+				}
+				// the first height_ levels are full, so every search takes
+				// height_ steps, and one more if it reaches the last level
+				for (int level = 0; level < height_; ++level)
+				{
+					for (std::size_t j = 0; j < width; ++j)
+					{
+						__prefetch(tree_ + std::min(k[j] * per_line, count_));
+						k[j] = 2 * k[j] + static_cast<std::size_t>(tree_[k[j]] < lower[j]);
+					}
+				}
+				for (std::size_t j = 0; j < width; ++j)
+				{
+					if (k[j] <= count_)
+					{
+						k[j] = 2 * k[j] + static_cast<std::size_t>(tree_[k[j]] < lower[j]);
+					}
+				}
+				for (std::size_t j = 0; j < width; ++j)
+				{
+					ranges[q + j] = __is_nan(queries[q + j]) ? std::make_pair(count_, count_) : _range(k[j], queries[q + j]);
+				}
+			}
+		}
+
+	private:
+		static constexpr std::size_t line = 64;
+		static constexpr std::size_t per_line = line / sizeof(T) > 0 ? line / sizeof(T) : 1;
+
+		inline void _build(std::size_t k, std::size_t& i)
+		{
+			if (k <= count_)
+			{
+				_build(2 * k, i);
+				tree_[k] = sorted_[i++];
+				_build(2 * k + 1, i);
+			}
+		}
+
+		/*
+		 *	The sorted index of the element at position k, or count_ for 0. The
+		 *	first height_ levels are full, and m elements are on the last one.
+		 *	An element at position p of level d above the last has
+		 *	c = (2p + 1) * 2^(height_ - 1 - d) elements of the full levels at or
+		 *	before it, and min(m, c) of the last level before it; the element at
+		 *	position p of the last level follows p of each.
+		 */
+		inline std::size_t _rank(std::size_t k) const
+		{
+			if (k == 0)
+			{
+				return count_;
+			}
+			int depth = 63 - count_leading_zeros(static_cast<std::uint64_t>(k));
+			std::size_t p = k - (std::size_t{1} << depth);
+			if (depth == height_)
+			{
+				return 2 * p;
+			}
+			std::size_t m = count_ - ((std::size_t{1} << height_) - 1);
+			std::size_t c = (2 * p + 1) << (height_ - 1 - depth);
+			return c - 1 + std::min(m, c);
+		}
+
+		/*
+		 *	The range of x from the end position k of a descent: the lower
+		 *	bound is the last position at which the search went left, found by
+		 *	dropping the trailing ones (right turns) and one more bit.
+		 */
+		inline std::pair<std::size_t, std::size_t> _range(std::size_t k, T x) const
+		{
+			std::uint64_t u = static_cast<std::uint64_t>(k);
+			int right_turns = 63 - count_leading_zeros(~u & (u + 1));
+			k = static_cast<std::size_t>(u >> (right_turns + 1));
+			const T* lo = sorted_ + _rank(k);
+			std::pair<const T*, const T*> range = __proximal_scan<N>(lo, sorted_ + count_, x);
+			return {static_cast<std::size_t>(range.first - sorted_), static_cast<std::size_t>(range.second - sorted_)};
+		}
+
+		const T* sorted_;
+		std::size_t count_;
+		std::vector<T> storage_;
+		T* tree_;
+		int height_;
+	};
+}
+
+#endif // guard_utils_proximal_search_h
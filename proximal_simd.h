@@ -0,0 +1,1743 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "proximal.h"
+
+#ifndef guard_utils_proximal_simd_h
+#define guard_utils_proximal_simd_h
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+ *	Batch kernels for arrays of float, double, half and bfloat16 (which are
+ *	widened to float in registers as they are loaded). The kernels are
+ *	written once (in proximal_kernels.h) against a small set of vector
+ *	operations, and are compiled for each supported instruction set: a
+ *	portable scalar version, and SSE2, AVX2 and AVX-512 versions on x86 with
+ *	gcc or clang. The instruction set is chosen at run time from CPUID. Every
+ *	version evaluates the same sequence of operations, so all of them return
+ *	identical results. Complex float and double arrays are compared in modulus
+ *	by kernels that load the interleaved parts and split them with shuffles.
+ *
+ *	Set the following define to 0 to build only the scalar kernels.
+ */
+
+#ifndef __USE_X86_SIMD_KERNELS__
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define __USE_X86_SIMD_KERNELS__ 1
+#else
+#define __USE_X86_SIMD_KERNELS__ 0
+#endif
+#endif
+
+#if (__USE_X86_SIMD_KERNELS__)
+#include <immintrin.h>
+#endif
+
+namespace utils
+{
+	namespace simd
+	{
+		enum class isa
+		{
+			scalar,
+			sse2,
+			avx2,
+			avx512
+		};
+
+		inline const char* isa_name(isa i)
+		{
+			switch (i)
+			{
+				case isa::sse2: return "sse2";
+				case isa::avx2: return "avx2";
+				case isa::avx512: return "avx512";
+				default: return "scalar";
+			}
+		}
+
+		/*
+		 *	The best instruction set supported by both the processor and this build.
+		 */
+		inline isa detect()
+		{
+		#if (__USE_X86_SIMD_KERNELS__)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+				&& __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl"))
+			{
+				return isa::avx512;
+			}
+			if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c"))
+			{
+				return isa::avx2;
+			}
+			if (__builtin_cpu_supports("sse2"))
+			{
+				return isa::sse2;
+			}
+		#endif
+			return isa::scalar;
+		}
+
+		inline std::atomic<int>& __selected_isa()
+		{
+			static std::atomic<int> selected{static_cast<int>(detect())};
+			return selected;
+		}
+
+		/*
+		 *	The instruction set used by the batch operations.
+		 */
+		inline isa active()
+		{
+			return static_cast<isa>(__selected_isa().load(std::memory_order_relaxed));
+		}
+
+		/*
+		 *	Restrict the batch operations to an instruction set, e.g. to compare
+		 *	kernels against each other. Requests beyond what detect() reports are
+		 *	lowered to it. Returns the instruction set actually selected.
+		 */
+		inline isa select(isa requested)
+		{
+			isa supported = detect();
+			isa chosen = static_cast<int>(requested) < static_cast<int>(supported) ? requested : supported;
+			__selected_isa().store(static_cast<int>(chosen), std::memory_order_relaxed);
+			return chosen;
+		}
+
+		inline std::size_t __popcount(std::uint64_t word)
+		{
+		#if defined(__GNUC__) || defined(__clang__)
+			return static_cast<std::size_t>(__builtin_popcountll(word));
+		#else
+			std::size_t n = 0;
+			for (; word != 0; word &= word - 1)
+			{
+				++n;
+			}
+			return n;
+		#endif
+		}
+
+		inline unsigned __lowest_bit(unsigned word)
+		{
+		#if defined(__GNUC__) || defined(__clang__)
+			return static_cast<unsigned>(__builtin_ctz(word));
+		#else
+			unsigned n = 0;
+			for (; (word & 1) == 0; word >>= 1)
+			{
+				++n;
+			}
+			return n;
+		#endif
+		}
+
+		/*
+		 *	Scalar vector operations, one lane wide. These follow the vector
+		 *	versions operation for operation: magnitudes by clearing the sign,
+		 *	the margin as 2^max(E, 1) scaled by 2^(n - fractional digits), where
+		 *	E is the exponent field of the larger magnitude.
+		 */
+		namespace scalar
+		{
+			template<class T, class U>
+			struct __scalar_ops
+			{
+				using value_type = T;
+				using storage_type = T;
+				using vec = T;
+				using mask = unsigned;
+				static constexpr std::size_t width = 1;
+				static constexpr unsigned all_bits = 1;
+
+				struct params
+				{
+					T scale;
+				};
+
+				static inline params make_params(int n)
+				{
+					return params{std::ldexp(static_cast<T>(1), n - fractional_digits<T>)};
+				}
+
+				static inline vec load(const T* p)
+				{
+					return *p;
+				}
+
+				static inline U bits(T x)
+				{
+					U u;
+					std::memcpy(&u, &x, sizeof(u));
+					return u;
+				}
+
+				static inline T value(U u)
+				{
+					T x;
+					std::memcpy(&x, &u, sizeof(x));
+					return x;
+				}
+
+				static inline void store(T* p, vec v)
+				{
+					*p = v;
+				}
+
+				static constexpr U magnitude_mask = ~(U{1} << (sizeof(U) * 8 - 1));
+				static constexpr U exp_mask = magnitude_mask & ~((U{1} << fractional_digits<T>) - 1);
+
+				static inline T margin_of(T mag, const params& p)
+				{
+					const T min_normal = std::numeric_limits<T>::min();
+					T pow = value(bits(mag) & exp_mask);
+					pow = pow > min_normal ? pow : min_normal;
+					return pow * p.scale;
+				}
+
+				static inline vec margins(vec x, const params& p)
+				{
+					T mag = value(bits(x) & magnitude_mask);
+					return mag < std::numeric_limits<T>::infinity() ? margin_of(mag, p) : static_cast<T>(0);
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					T abs_a = value(bits(a) & magnitude_mask);
+					T abs_b = value(bits(b) & magnitude_mask);
+					T mag = abs_a > abs_b ? abs_a : abs_b;
+					T margin = margin_of(mag, p);
+					T diff = value(bits(a - b) & magnitude_mask);
+					return (a == b) | ((diff <= margin) & (mag < std::numeric_limits<T>::infinity()));
+				}
+
+				static inline mask both(mask a, mask b)
+				{
+					return a & b;
+				}
+
+				static inline unsigned lanes(mask m)
+				{
+					return m;
+				}
+
+				static inline vec splat(T x)
+				{
+					return x;
+				}
+
+				static inline vec max(vec a, vec b)
+				{
+					return a > b ? a : b;
+				}
+
+				static inline mask greater(vec a, vec b)
+				{
+					return a > b;
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const T inf = std::numeric_limits<T>::infinity();
+					T abs_a = value(bits(a) & magnitude_mask);
+					T abs_b = value(bits(b) & magnitude_mask);
+					bool finite = (abs_a < inf) & (abs_b < inf);
+					T mag = abs_a > abs_b ? abs_a : abs_b;
+					T diff = value(bits(a - b) & magnitude_mask);
+					error = a == b ? static_cast<T>(0) : finite ? diff : inf;
+					ulps = error / margin_of(finite ? mag : static_cast<T>(0), unit);
+				}
+
+				static inline void deinterleave(vec v0, vec v1, vec& re, vec& im)
+				{
+					re = v0;
+					im = v1;
+				}
+
+				static inline mask close_modulus(vec ar, vec ai, vec br, vec bi, const params& p)
+				{
+					return __close_modulus(ar, ai, br, bi, p.scale);
+				}
+			};
+
+			using f32 = __scalar_ops<float, std::uint32_t>;
+			using f64 = __scalar_ops<double, std::uint64_t>;
+
+			/*
+			 *	Half operands, widened to float as they are loaded. The margin is
+			 *	that of representation<half>::within_margin(): the exponent field
+			 *	of the larger magnitude is clamped to the smallest normal half,
+			 *	and margins past the range of half are infinite.
+			 */
+			struct f16 : f32
+			{
+				using storage_type = half;
+
+				static inline params make_params(int n)
+				{
+					return params{std::ldexp(1.0f, n - fractional_digits<half>)};
+				}
+
+				static inline vec load(const half* p)
+				{
+					return __half_bits_to_float(__bit_cast<bits16>(*p));
+				}
+
+				static inline float margin_of(float mag, const params& p)
+				{
+					const float min_normal = value(0x38800000);
+					const float limit = value(0x47000000);
+					float pow = value(bits(mag) & exp_mask);
+					pow = pow > min_normal ? pow : min_normal;
+					float margin = pow * p.scale;
+					return margin > limit ? std::numeric_limits<float>::infinity() : margin;
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					float abs_a = value(bits(a) & magnitude_mask);
+					float abs_b = value(bits(b) & magnitude_mask);
+					float mag = abs_a > abs_b ? abs_a : abs_b;
+					float margin = margin_of(mag, p);
+					float diff = value(bits(a - b) & magnitude_mask);
+					return (a == b) | ((diff <= margin) & (mag < std::numeric_limits<float>::infinity()));
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const float inf = std::numeric_limits<float>::infinity();
+					float abs_a = value(bits(a) & magnitude_mask);
+					float abs_b = value(bits(b) & magnitude_mask);
+					bool finite = (abs_a < inf) & (abs_b < inf);
+					float mag = abs_a > abs_b ? abs_a : abs_b;
+					float diff = value(bits(a - b) & magnitude_mask);
+					error = a == b ? 0.0f : finite ? diff : inf;
+					ulps = error / margin_of(finite ? mag : 0.0f, unit);
+				}
+			};
+
+			/*
+			 *	bfloat16 operands, widened to float as they are loaded. Widening is
+			 *	exact and keeps the exponent field, so the float operations apply
+			 *	unchanged with a margin scaled by 2^(n - 7); a margin past the range
+			 *	of float overflows to infinity as representation<bfloat16> expects.
+			 */
+			struct bf16 : f32
+			{
+				using storage_type = bfloat16;
+
+				static inline params make_params(int n)
+				{
+					return params{std::ldexp(1.0f, n - fractional_digits<bfloat16>)};
+				}
+
+				static inline vec load(const bfloat16* p)
+				{
+					return value(static_cast<std::uint32_t>(p->bits) << 16);
+				}
+			};
+
+			/*
+			 *	Double operands, rounded to float as they are loaded, for comparing
+			 *	float results with double references (see proximal_cross). Values
+			 *	past the range of float round to infinity, and values in the range
+			 *	of float denormals to denormals or zero.
+			 */
+			struct f64_narrowed : f32
+			{
+				using storage_type = double;
+
+				static inline vec load(const double* p)
+				{
+					return static_cast<float>(*p);
+				}
+			};
+		}
+	}
+}
+
+#define __PROXIMAL_KERNEL_NAMESPACE__ scalar
+#include "proximal_kernels.h"
+#undef __PROXIMAL_KERNEL_NAMESPACE__
+
+#if (__USE_X86_SIMD_KERNELS__)
+
+/*
+ *	Each instruction set gets a region compiled for it. The vector operations
+ *	and the kernels instantiated from them inherit the target, while the code
+ *	outside the regions is compiled for the baseline architecture, so a kernel
+ *	is only entered after detect() has found the instructions it uses.
+ */
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+namespace utils
+{
+	namespace simd
+	{
+		namespace sse2
+		{
+			struct f32
+			{
+				using value_type = float;
+				using storage_type = float;
+				using vec = __m128;
+				using mask = __m128;
+				static constexpr std::size_t width = 4;
+				static constexpr unsigned all_bits = 0xF;
+
+				struct params
+				{
+					__m128 scale;
+				};
+
+				static inline params make_params(int n)
+				{
+					return params{_mm_set1_ps(std::ldexp(1.0f, n - fractional_digits<float>))};
+				}
+
+				static inline vec load(const float* p)
+				{
+					return _mm_loadu_ps(p);
+				}
+
+				static inline void store(float* p, vec v)
+				{
+					_mm_storeu_ps(p, v);
+				}
+
+				static inline vec margin_of(vec mag, const params& p)
+				{
+					const __m128 exp_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7F800000));
+					const __m128 min_normal = _mm_set1_ps(std::numeric_limits<float>::min());
+					return _mm_mul_ps(_mm_max_ps(_mm_and_ps(mag, exp_mask), min_normal), p.scale);
+				}
+
+				static inline vec margins(vec x, const params& p)
+				{
+					const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+					__m128 mag = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+					return _mm_and_ps(margin_of(mag, p), _mm_cmplt_ps(mag, inf));
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					const __m128 sign = _mm_set1_ps(-0.0f);
+					const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+					__m128 mag = _mm_max_ps(_mm_andnot_ps(sign, a), _mm_andnot_ps(sign, b));
+					__m128 margin = margin_of(mag, p);
+					__m128 diff = _mm_andnot_ps(sign, _mm_sub_ps(a, b));
+					__m128 within = _mm_and_ps(_mm_cmple_ps(diff, margin), _mm_cmplt_ps(mag, inf));
+					return _mm_or_ps(_mm_cmpeq_ps(a, b), within);
+				}
+
+				static inline mask both(mask a, mask b)
+				{
+					return _mm_and_ps(a, b);
+				}
+
+				static inline unsigned lanes(mask m)
+				{
+					return static_cast<unsigned>(_mm_movemask_ps(m));
+				}
+
+				static inline vec splat(float x)
+				{
+					return _mm_set1_ps(x);
+				}
+
+				static inline vec max(vec a, vec b)
+				{
+					return _mm_max_ps(a, b);
+				}
+
+				static inline mask greater(vec a, vec b)
+				{
+					return _mm_cmpgt_ps(a, b);
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const vec sign = _mm_set1_ps(-0.0f);
+					const vec inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+					vec abs_a = _mm_andnot_ps(sign, a);
+					vec abs_b = _mm_andnot_ps(sign, b);
+					vec finite = _mm_and_ps(_mm_cmplt_ps(abs_a, inf), _mm_cmplt_ps(abs_b, inf));
+					vec mag = _mm_and_ps(finite, _mm_max_ps(abs_a, abs_b));
+					vec diff = _mm_andnot_ps(sign, _mm_sub_ps(a, b));
+					vec e = _mm_or_ps(_mm_and_ps(finite, diff), _mm_andnot_ps(finite, inf));
+					error = _mm_andnot_ps(_mm_cmpeq_ps(a, b), e);
+					ulps = _mm_div_ps(error, margin_of(mag, unit));
+				}
+
+				static inline void deinterleave(vec v0, vec v1, vec& re, vec& im)
+				{
+					re = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+					im = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+				}
+
+				static inline mask close_modulus(vec ar, vec ai, vec br, vec bi, const params& p)
+				{
+					const __m128 sign = _mm_set1_ps(-0.0f);
+					const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+					const __m128 exp_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7F800000));
+					const __m128 min_normal = _mm_set1_ps(std::numeric_limits<float>::min());
+					const __m128 one = _mm_set1_ps(1.0f);
+					__m128 abs_ar = _mm_andnot_ps(sign, ar);
+					__m128 abs_ai = _mm_andnot_ps(sign, ai);
+					__m128 abs_br = _mm_andnot_ps(sign, br);
+					__m128 abs_bi = _mm_andnot_ps(sign, bi);
+					__m128 finite = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(abs_ar, inf), _mm_cmplt_ps(abs_ai, inf)),
+						_mm_and_ps(_mm_cmplt_ps(abs_br, inf), _mm_cmplt_ps(abs_bi, inf)));
+					__m128 equal = _mm_and_ps(_mm_cmpeq_ps(ar, br), _mm_cmpeq_ps(ai, bi));
+					__m128 big = _mm_max_ps(_mm_max_ps(abs_ar, abs_ai), _mm_max_ps(abs_br, abs_bi));
+					__m128 pow = _mm_max_ps(_mm_and_ps(big, exp_mask), min_normal);
+					__m128 inv = _mm_div_ps(one, pow);
+					__m128 sar = _mm_mul_ps(ar, inv);
+					__m128 sai = _mm_mul_ps(ai, inv);
+					__m128 sbr = _mm_mul_ps(br, inv);
+					__m128 sbi = _mm_mul_ps(bi, inv);
+					__m128 dr = _mm_mul_ps(_mm_sub_ps(ar, br), inv);
+					__m128 di = _mm_mul_ps(_mm_sub_ps(ai, bi), inv);
+					__m128 sa = _mm_add_ps(_mm_mul_ps(sar, sar), _mm_mul_ps(sai, sai));
+					__m128 sb = _mm_add_ps(_mm_mul_ps(sbr, sbr), _mm_mul_ps(sbi, sbi));
+					__m128 sd = _mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(di, di));
+					__m128 smag = _mm_sqrt_ps(_mm_max_ps(sa, sb));
+					__m128 ms = _mm_mul_ps(_mm_max_ps(_mm_and_ps(smag, exp_mask), one), p.scale);
+					__m128 within = _mm_and_ps(finite, _mm_cmple_ps(sd, _mm_mul_ps(ms, ms)));
+					return _mm_or_ps(equal, within);
+				}
+			};
+
+			struct f64
+			{
+				using value_type = double;
+				using storage_type = double;
+				using vec = __m128d;
+				using mask = __m128d;
+				static constexpr std::size_t width = 2;
+				static constexpr unsigned all_bits = 0x3;
+
+				struct params
+				{
+					__m128d scale;
+				};
+
+				static inline params make_params(int n)
+				{
+					return params{_mm_set1_pd(std::ldexp(1.0, n - fractional_digits<double>))};
+				}
+
+				static inline vec load(const double* p)
+				{
+					return _mm_loadu_pd(p);
+				}
+
+				static inline void store(double* p, vec v)
+				{
+					_mm_storeu_pd(p, v);
+				}
+
+				static inline vec margin_of(vec mag, const params& p)
+				{
+					const __m128d exp_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FF0000000000000));
+					const __m128d min_normal = _mm_set1_pd(std::numeric_limits<double>::min());
+					return _mm_mul_pd(_mm_max_pd(_mm_and_pd(mag, exp_mask), min_normal), p.scale);
+				}
+
+				static inline vec margins(vec x, const params& p)
+				{
+					const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+					__m128d mag = _mm_andnot_pd(_mm_set1_pd(-0.0), x);
+					return _mm_and_pd(margin_of(mag, p), _mm_cmplt_pd(mag, inf));
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					const __m128d sign = _mm_set1_pd(-0.0);
+					const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+					__m128d mag = _mm_max_pd(_mm_andnot_pd(sign, a), _mm_andnot_pd(sign, b));
+					__m128d margin = margin_of(mag, p);
+					__m128d diff = _mm_andnot_pd(sign, _mm_sub_pd(a, b));
+					__m128d within = _mm_and_pd(_mm_cmple_pd(diff, margin), _mm_cmplt_pd(mag, inf));
+					return _mm_or_pd(_mm_cmpeq_pd(a, b), within);
+				}
+
+				static inline mask both(mask a, mask b)
+				{
+					return _mm_and_pd(a, b);
+				}
+
+				static inline unsigned lanes(mask m)
+				{
+					return static_cast<unsigned>(_mm_movemask_pd(m));
+				}
+
+				static inline vec splat(double x)
+				{
+					return _mm_set1_pd(x);
+				}
+
+				static inline vec max(vec a, vec b)
+				{
+					return _mm_max_pd(a, b);
+				}
+
+				static inline mask greater(vec a, vec b)
+				{
+					return _mm_cmpgt_pd(a, b);
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const vec sign = _mm_set1_pd(-0.0);
+					const vec inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+					vec abs_a = _mm_andnot_pd(sign, a);
+					vec abs_b = _mm_andnot_pd(sign, b);
+					vec finite = _mm_and_pd(_mm_cmplt_pd(abs_a, inf), _mm_cmplt_pd(abs_b, inf));
+					vec mag = _mm_and_pd(finite, _mm_max_pd(abs_a, abs_b));
+					vec diff = _mm_andnot_pd(sign, _mm_sub_pd(a, b));
+					vec e = _mm_or_pd(_mm_and_pd(finite, diff), _mm_andnot_pd(finite, inf));
+					error = _mm_andnot_pd(_mm_cmpeq_pd(a, b), e);
+					ulps = _mm_div_pd(error, margin_of(mag, unit));
+				}
+
+				static inline void deinterleave(vec v0, vec v1, vec& re, vec& im)
+				{
+					re = _mm_unpacklo_pd(v0, v1);
+					im = _mm_unpackhi_pd(v0, v1);
+				}
+
+				static inline mask close_modulus(vec ar, vec ai, vec br, vec bi, const params& p)
+				{
+					const __m128d sign = _mm_set1_pd(-0.0);
+					const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+					const __m128d exp_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FF0000000000000));
+					const __m128d min_normal = _mm_set1_pd(std::numeric_limits<double>::min());
+					const __m128d one = _mm_set1_pd(1.0);
+					__m128d abs_ar = _mm_andnot_pd(sign, ar);
+					__m128d abs_ai = _mm_andnot_pd(sign, ai);
+					__m128d abs_br = _mm_andnot_pd(sign, br);
+					__m128d abs_bi = _mm_andnot_pd(sign, bi);
+					__m128d finite = _mm_and_pd(_mm_and_pd(_mm_cmplt_pd(abs_ar, inf), _mm_cmplt_pd(abs_ai, inf)),
+						_mm_and_pd(_mm_cmplt_pd(abs_br, inf), _mm_cmplt_pd(abs_bi, inf)));
+					__m128d equal = _mm_and_pd(_mm_cmpeq_pd(ar, br), _mm_cmpeq_pd(ai, bi));
+					__m128d big = _mm_max_pd(_mm_max_pd(abs_ar, abs_ai), _mm_max_pd(abs_br, abs_bi));
+					__m128d pow = _mm_max_pd(_mm_and_pd(big, exp_mask), min_normal);
+					__m128d inv = _mm_div_pd(one, pow);
+					__m128d sar = _mm_mul_pd(ar, inv);
+					__m128d sai = _mm_mul_pd(ai, inv);
+					__m128d sbr = _mm_mul_pd(br, inv);
+					__m128d sbi = _mm_mul_pd(bi, inv);
+					__m128d dr = _mm_mul_pd(_mm_sub_pd(ar, br), inv);
+					__m128d di = _mm_mul_pd(_mm_sub_pd(ai, bi), inv);
+					__m128d sa = _mm_add_pd(_mm_mul_pd(sar, sar), _mm_mul_pd(sai, sai));
+					__m128d sb = _mm_add_pd(_mm_mul_pd(sbr, sbr), _mm_mul_pd(sbi, sbi));
+					__m128d sd = _mm_add_pd(_mm_mul_pd(dr, dr), _mm_mul_pd(di, di));
+					__m128d smag = _mm_sqrt_pd(_mm_max_pd(sa, sb));
+					__m128d ms = _mm_mul_pd(_mm_max_pd(_mm_and_pd(smag, exp_mask), one), p.scale);
+					__m128d within = _mm_and_pd(finite, _mm_cmple_pd(sd, _mm_mul_pd(ms, ms)));
+					return _mm_or_pd(equal, within);
+				}
+			};
+
+			/*
+			 *	Half operands, widened to float as they are loaded (see
+			 *	scalar::f16). SSE2 has no conversion instruction, so the bits are
+			 *	rebiased with integer operations: denormals get the integer bit
+			 *	of the smallest normal, which is then subtracted as a float.
+			 */
+			struct f16 : f32
+			{
+				using storage_type = half;
+
+				static inline params make_params(int n)
+				{
+					return params{_mm_set1_ps(std::ldexp(1.0f, n - fractional_digits<half>))};
+				}
+
+				static inline vec load(const half* p)
+				{
+					const __m128i shifted_exp = _mm_set1_epi32(0x0F800000);
+					const __m128i rebias = _mm_set1_epi32(112 << 23);
+					__m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+					__m128i o = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7FFF)), 13);
+					__m128i exp = _mm_and_si128(o, shifted_exp);
+					o = _mm_add_epi32(o, rebias);
+					o = _mm_add_epi32(o, _mm_and_si128(_mm_cmpeq_epi32(exp, shifted_exp), rebias));
+					__m128 denormal = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(o, _mm_set1_epi32(1 << 23))), _mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+					__m128 tiny = _mm_castsi128_ps(_mm_cmpeq_epi32(exp, _mm_setzero_si128()));
+					__m128 f = _mm_or_ps(_mm_and_ps(tiny, denormal), _mm_andnot_ps(tiny, _mm_castsi128_ps(o)));
+					return _mm_or_ps(f, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16)));
+				}
+
+				/*
+				 *	A margin is a power of two, so setting all the exponent bits
+				 *	of one past the range of half makes it infinite.
+				 */
+				static inline vec margin_of(vec mag, const params& p)
+				{
+					const __m128 exp_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7F800000));
+					const __m128 min_normal = _mm_castsi128_ps(_mm_set1_epi32(0x38800000));
+					const __m128 limit = _mm_castsi128_ps(_mm_set1_epi32(0x47000000));
+					__m128 margin = _mm_mul_ps(_mm_max_ps(_mm_and_ps(mag, exp_mask), min_normal), p.scale);
+					return _mm_or_ps(margin, _mm_and_ps(_mm_cmpgt_ps(margin, limit), exp_mask));
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					const __m128 sign = _mm_set1_ps(-0.0f);
+					const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+					__m128 mag = _mm_max_ps(_mm_andnot_ps(sign, a), _mm_andnot_ps(sign, b));
+					__m128 margin = margin_of(mag, p);
+					__m128 diff = _mm_andnot_ps(sign, _mm_sub_ps(a, b));
+					__m128 within = _mm_and_ps(_mm_cmple_ps(diff, margin), _mm_cmplt_ps(mag, inf));
+					return _mm_or_ps(_mm_cmpeq_ps(a, b), within);
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const vec sign = _mm_set1_ps(-0.0f);
+					const vec inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+					vec abs_a = _mm_andnot_ps(sign, a);
+					vec abs_b = _mm_andnot_ps(sign, b);
+					vec finite = _mm_and_ps(_mm_cmplt_ps(abs_a, inf), _mm_cmplt_ps(abs_b, inf));
+					vec mag = _mm_and_ps(finite, _mm_max_ps(abs_a, abs_b));
+					vec diff = _mm_andnot_ps(sign, _mm_sub_ps(a, b));
+					vec e = _mm_or_ps(_mm_and_ps(finite, diff), _mm_andnot_ps(finite, inf));
+					error = _mm_andnot_ps(_mm_cmpeq_ps(a, b), e);
+					ulps = _mm_div_ps(error, margin_of(mag, unit));
+				}
+			};
+
+			/*
+			 *	bfloat16 operands, widened to float as they are loaded (see
+			 *	scalar::bf16) by interleaving them with zeros.
+			 */
+			struct bf16 : f32
+			{
+				using storage_type = bfloat16;
+
+				static inline params make_params(int n)
+				{
+					return params{_mm_set1_ps(std::ldexp(1.0f, n - fractional_digits<bfloat16>))};
+				}
+
+				static inline vec load(const bfloat16* p)
+				{
+					__m128i h = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+					return _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), h));
+				}
+			};
+
+			/*
+			 *	Double operands, rounded to float as they are loaded (see
+			 *	scalar::f64_narrowed).
+			 */
+			struct f64_narrowed : f32
+			{
+				using storage_type = double;
+
+				static inline vec load(const double* p)
+				{
+					return _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p)), _mm_cvtpd_ps(_mm_loadu_pd(p + 2)));
+				}
+			};
+		}
+	}
+}
+
+#define __PROXIMAL_KERNEL_NAMESPACE__ sse2
+#include "proximal_kernels.h"
+#undef __PROXIMAL_KERNEL_NAMESPACE__
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push (__attribute__((target("avx2,f16c"))), apply_to = function)
+#else
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx2,f16c")
+#endif
+
+namespace utils
+{
+	namespace simd
+	{
+		namespace avx2
+		{
+			struct f32
+			{
+				using value_type = float;
+				using storage_type = float;
+				using vec = __m256;
+				using mask = __m256;
+				static constexpr std::size_t width = 8;
+				static constexpr unsigned all_bits = 0xFF;
+
+				struct params
+				{
+					__m256 scale;
+				};
+
+				static inline params make_params(int n)
+				{
+					return params{_mm256_set1_ps(std::ldexp(1.0f, n - fractional_digits<float>))};
+				}
+
+				static inline vec load(const float* p)
+				{
+					return _mm256_loadu_ps(p);
+				}
+
+				static inline void store(float* p, vec v)
+				{
+					_mm256_storeu_ps(p, v);
+				}
+
+				static inline vec margin_of(vec mag, const params& p)
+				{
+					const __m256 exp_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7F800000));
+					const __m256 min_normal = _mm256_set1_ps(std::numeric_limits<float>::min());
+					return _mm256_mul_ps(_mm256_max_ps(_mm256_and_ps(mag, exp_mask), min_normal), p.scale);
+				}
+
+				static inline vec margins(vec x, const params& p)
+				{
+					const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+					__m256 mag = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+					return _mm256_and_ps(margin_of(mag, p), _mm256_cmp_ps(mag, inf, _CMP_LT_OQ));
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					const __m256 sign = _mm256_set1_ps(-0.0f);
+					const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+					__m256 mag = _mm256_max_ps(_mm256_andnot_ps(sign, a), _mm256_andnot_ps(sign, b));
+					__m256 margin = margin_of(mag, p);
+					__m256 diff = _mm256_andnot_ps(sign, _mm256_sub_ps(a, b));
+					__m256 within = _mm256_and_ps(_mm256_cmp_ps(diff, margin, _CMP_LE_OQ), _mm256_cmp_ps(mag, inf, _CMP_LT_OQ));
+					return _mm256_or_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ), within);
+				}
+
+				static inline mask both(mask a, mask b)
+				{
+					return _mm256_and_ps(a, b);
+				}
+
+				static inline unsigned lanes(mask m)
+				{
+					return static_cast<unsigned>(_mm256_movemask_ps(m));
+				}
+
+				static inline vec splat(float x)
+				{
+					return _mm256_set1_ps(x);
+				}
+
+				static inline vec max(vec a, vec b)
+				{
+					return _mm256_max_ps(a, b);
+				}
+
+				static inline mask greater(vec a, vec b)
+				{
+					return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const vec sign = _mm256_set1_ps(-0.0f);
+					const vec inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+					vec abs_a = _mm256_andnot_ps(sign, a);
+					vec abs_b = _mm256_andnot_ps(sign, b);
+					vec finite = _mm256_and_ps(_mm256_cmp_ps(abs_a, inf, _CMP_LT_OQ), _mm256_cmp_ps(abs_b, inf, _CMP_LT_OQ));
+					vec mag = _mm256_and_ps(finite, _mm256_max_ps(abs_a, abs_b));
+					vec diff = _mm256_andnot_ps(sign, _mm256_sub_ps(a, b));
+					vec e = _mm256_blendv_ps(inf, diff, finite);
+					error = _mm256_andnot_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ), e);
+					ulps = _mm256_div_ps(error, margin_of(mag, unit));
+				}
+
+				static inline void deinterleave(vec v0, vec v1, vec& re, vec& im)
+				{
+					// the shuffles work within 128-bit halves; the permutes put the
+					// pairs of parts back in order
+					re = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0))), 0xD8));
+					im = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1))), 0xD8));
+				}
+
+				static inline mask close_modulus(vec ar, vec ai, vec br, vec bi, const params& p)
+				{
+					const __m256 sign = _mm256_set1_ps(-0.0f);
+					const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+					const __m256 exp_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7F800000));
+					const __m256 min_normal = _mm256_set1_ps(std::numeric_limits<float>::min());
+					const __m256 one = _mm256_set1_ps(1.0f);
+					__m256 abs_ar = _mm256_andnot_ps(sign, ar);
+					__m256 abs_ai = _mm256_andnot_ps(sign, ai);
+					__m256 abs_br = _mm256_andnot_ps(sign, br);
+					__m256 abs_bi = _mm256_andnot_ps(sign, bi);
+					__m256 finite = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(abs_ar, inf, _CMP_LT_OQ), _mm256_cmp_ps(abs_ai, inf, _CMP_LT_OQ)),
+						_mm256_and_ps(_mm256_cmp_ps(abs_br, inf, _CMP_LT_OQ), _mm256_cmp_ps(abs_bi, inf, _CMP_LT_OQ)));
+					__m256 equal = _mm256_and_ps(_mm256_cmp_ps(ar, br, _CMP_EQ_OQ), _mm256_cmp_ps(ai, bi, _CMP_EQ_OQ));
+					__m256 big = _mm256_max_ps(_mm256_max_ps(abs_ar, abs_ai), _mm256_max_ps(abs_br, abs_bi));
+					__m256 pow = _mm256_max_ps(_mm256_and_ps(big, exp_mask), min_normal);
+					__m256 inv = _mm256_div_ps(one, pow);
+					__m256 sar = _mm256_mul_ps(ar, inv);
+					__m256 sai = _mm256_mul_ps(ai, inv);
+					__m256 sbr = _mm256_mul_ps(br, inv);
+					__m256 sbi = _mm256_mul_ps(bi, inv);
+					__m256 dr = _mm256_mul_ps(_mm256_sub_ps(ar, br), inv);
+					__m256 di = _mm256_mul_ps(_mm256_sub_ps(ai, bi), inv);
+					__m256 sa = _mm256_add_ps(_mm256_mul_ps(sar, sar), _mm256_mul_ps(sai, sai));
+					__m256 sb = _mm256_add_ps(_mm256_mul_ps(sbr, sbr), _mm256_mul_ps(sbi, sbi));
+					__m256 sd = _mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(di, di));
+					__m256 smag = _mm256_sqrt_ps(_mm256_max_ps(sa, sb));
+					__m256 ms = _mm256_mul_ps(_mm256_max_ps(_mm256_and_ps(smag, exp_mask), one), p.scale);
+					__m256 within = _mm256_and_ps(finite, _mm256_cmp_ps(sd, _mm256_mul_ps(ms, ms), _CMP_LE_OQ));
+					return _mm256_or_ps(equal, within);
+				}
+			};
+
+			struct f64
+			{
+				using value_type = double;
+				using storage_type = double;
+				using vec = __m256d;
+				using mask = __m256d;
+				static constexpr std::size_t width = 4;
+				static constexpr unsigned all_bits = 0xF;
+
+				struct params
+				{
+					__m256d scale;
+				};
+
+				static inline params make_params(int n)
+				{
+					return params{_mm256_set1_pd(std::ldexp(1.0, n - fractional_digits<double>))};
+				}
+
+				static inline vec load(const double* p)
+				{
+					return _mm256_loadu_pd(p);
+				}
+
+				static inline void store(double* p, vec v)
+				{
+					_mm256_storeu_pd(p, v);
+				}
+
+				static inline vec margin_of(vec mag, const params& p)
+				{
+					const __m256d exp_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FF0000000000000));
+					const __m256d min_normal = _mm256_set1_pd(std::numeric_limits<double>::min());
+					return _mm256_mul_pd(_mm256_max_pd(_mm256_and_pd(mag, exp_mask), min_normal), p.scale);
+				}
+
+				static inline vec margins(vec x, const params& p)
+				{
+					const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+					__m256d mag = _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+					return _mm256_and_pd(margin_of(mag, p), _mm256_cmp_pd(mag, inf, _CMP_LT_OQ));
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					const __m256d sign = _mm256_set1_pd(-0.0);
+					const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+					__m256d mag = _mm256_max_pd(_mm256_andnot_pd(sign, a), _mm256_andnot_pd(sign, b));
+					__m256d margin = margin_of(mag, p);
+					__m256d diff = _mm256_andnot_pd(sign, _mm256_sub_pd(a, b));
+					__m256d within = _mm256_and_pd(_mm256_cmp_pd(diff, margin, _CMP_LE_OQ), _mm256_cmp_pd(mag, inf, _CMP_LT_OQ));
+					return _mm256_or_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ), within);
+				}
+
+				static inline mask both(mask a, mask b)
+				{
+					return _mm256_and_pd(a, b);
+				}
+
+				static inline unsigned lanes(mask m)
+				{
+					return static_cast<unsigned>(_mm256_movemask_pd(m));
+				}
+
+				static inline vec splat(double x)
+				{
+					return _mm256_set1_pd(x);
+				}
+
+				static inline vec max(vec a, vec b)
+				{
+					return _mm256_max_pd(a, b);
+				}
+
+				static inline mask greater(vec a, vec b)
+				{
+					return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const vec sign = _mm256_set1_pd(-0.0);
+					const vec inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+					vec abs_a = _mm256_andnot_pd(sign, a);
+					vec abs_b = _mm256_andnot_pd(sign, b);
+					vec finite = _mm256_and_pd(_mm256_cmp_pd(abs_a, inf, _CMP_LT_OQ), _mm256_cmp_pd(abs_b, inf, _CMP_LT_OQ));
+					vec mag = _mm256_and_pd(finite, _mm256_max_pd(abs_a, abs_b));
+					vec diff = _mm256_andnot_pd(sign, _mm256_sub_pd(a, b));
+					vec e = _mm256_blendv_pd(inf, diff, finite);
+					error = _mm256_andnot_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ), e);
+					ulps = _mm256_div_pd(error, margin_of(mag, unit));
+				}
+
+				static inline void deinterleave(vec v0, vec v1, vec& re, vec& im)
+				{
+					// the unpacks work within 128-bit halves; the permutes put the
+					// parts back in order
+					re = _mm256_permute4x64_pd(_mm256_unpacklo_pd(v0, v1), 0xD8);
+					im = _mm256_permute4x64_pd(_mm256_unpackhi_pd(v0, v1), 0xD8);
+				}
+
+				static inline mask close_modulus(vec ar, vec ai, vec br, vec bi, const params& p)
+				{
+					const __m256d sign = _mm256_set1_pd(-0.0);
+					const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+					const __m256d exp_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FF0000000000000));
+					const __m256d min_normal = _mm256_set1_pd(std::numeric_limits<double>::min());
+					const __m256d one = _mm256_set1_pd(1.0);
+					__m256d abs_ar = _mm256_andnot_pd(sign, ar);
+					__m256d abs_ai = _mm256_andnot_pd(sign, ai);
+					__m256d abs_br = _mm256_andnot_pd(sign, br);
+					__m256d abs_bi = _mm256_andnot_pd(sign, bi);
+					__m256d finite = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(abs_ar, inf, _CMP_LT_OQ), _mm256_cmp_pd(abs_ai, inf, _CMP_LT_OQ)),
+						_mm256_and_pd(_mm256_cmp_pd(abs_br, inf, _CMP_LT_OQ), _mm256_cmp_pd(abs_bi, inf, _CMP_LT_OQ)));
+					__m256d equal = _mm256_and_pd(_mm256_cmp_pd(ar, br, _CMP_EQ_OQ), _mm256_cmp_pd(ai, bi, _CMP_EQ_OQ));
+					__m256d big = _mm256_max_pd(_mm256_max_pd(abs_ar, abs_ai), _mm256_max_pd(abs_br, abs_bi));
+					__m256d pow = _mm256_max_pd(_mm256_and_pd(big, exp_mask), min_normal);
+					__m256d inv = _mm256_div_pd(one, pow);
+					__m256d sar = _mm256_mul_pd(ar, inv);
+					__m256d sai = _mm256_mul_pd(ai, inv);
+					__m256d sbr = _mm256_mul_pd(br, inv);
+					__m256d sbi = _mm256_mul_pd(bi, inv);
+					__m256d dr = _mm256_mul_pd(_mm256_sub_pd(ar, br), inv);
+					__m256d di = _mm256_mul_pd(_mm256_sub_pd(ai, bi), inv);
+					__m256d sa = _mm256_add_pd(_mm256_mul_pd(sar, sar), _mm256_mul_pd(sai, sai));
+					__m256d sb = _mm256_add_pd(_mm256_mul_pd(sbr, sbr), _mm256_mul_pd(sbi, sbi));
+					__m256d sd = _mm256_add_pd(_mm256_mul_pd(dr, dr), _mm256_mul_pd(di, di));
+					__m256d smag = _mm256_sqrt_pd(_mm256_max_pd(sa, sb));
+					__m256d ms = _mm256_mul_pd(_mm256_max_pd(_mm256_and_pd(smag, exp_mask), one), p.scale);
+					__m256d within = _mm256_and_pd(finite, _mm256_cmp_pd(sd, _mm256_mul_pd(ms, ms), _CMP_LE_OQ));
+					return _mm256_or_pd(equal, within);
+				}
+			};
+
+			/*
+			 *	Half operands, widened to float by F16C as they are loaded (see
+			 *	scalar::f16).
+			 */
+			struct f16 : f32
+			{
+				using storage_type = half;
+
+				static inline params make_params(int n)
+				{
+					return params{_mm256_set1_ps(std::ldexp(1.0f, n - fractional_digits<half>))};
+				}
+
+				static inline vec load(const half* p)
+				{
+					return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+				}
+
+				static inline vec margin_of(vec mag, const params& p)
+				{
+					const __m256 exp_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7F800000));
+					const __m256 min_normal = _mm256_castsi256_ps(_mm256_set1_epi32(0x38800000));
+					const __m256 limit = _mm256_castsi256_ps(_mm256_set1_epi32(0x47000000));
+					__m256 margin = _mm256_mul_ps(_mm256_max_ps(_mm256_and_ps(mag, exp_mask), min_normal), p.scale);
+					return _mm256_or_ps(margin, _mm256_and_ps(_mm256_cmp_ps(margin, limit, _CMP_GT_OQ), exp_mask));
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					const __m256 sign = _mm256_set1_ps(-0.0f);
+					const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+					__m256 mag = _mm256_max_ps(_mm256_andnot_ps(sign, a), _mm256_andnot_ps(sign, b));
+					__m256 margin = margin_of(mag, p);
+					__m256 diff = _mm256_andnot_ps(sign, _mm256_sub_ps(a, b));
+					__m256 within = _mm256_and_ps(_mm256_cmp_ps(diff, margin, _CMP_LE_OQ), _mm256_cmp_ps(mag, inf, _CMP_LT_OQ));
+					return _mm256_or_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ), within);
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const vec sign = _mm256_set1_ps(-0.0f);
+					const vec inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+					vec abs_a = _mm256_andnot_ps(sign, a);
+					vec abs_b = _mm256_andnot_ps(sign, b);
+					vec finite = _mm256_and_ps(_mm256_cmp_ps(abs_a, inf, _CMP_LT_OQ), _mm256_cmp_ps(abs_b, inf, _CMP_LT_OQ));
+					vec mag = _mm256_and_ps(finite, _mm256_max_ps(abs_a, abs_b));
+					vec diff = _mm256_andnot_ps(sign, _mm256_sub_ps(a, b));
+					vec e = _mm256_blendv_ps(inf, diff, finite);
+					error = _mm256_andnot_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ), e);
+					ulps = _mm256_div_ps(error, margin_of(mag, unit));
+				}
+			};
+
+			/*
+			 *	bfloat16 operands, widened to float as they are loaded (see
+			 *	scalar::bf16).
+			 */
+			struct bf16 : f32
+			{
+				using storage_type = bfloat16;
+
+				static inline params make_params(int n)
+				{
+					return params{_mm256_set1_ps(std::ldexp(1.0f, n - fractional_digits<bfloat16>))};
+				}
+
+				static inline vec load(const bfloat16* p)
+				{
+					__m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+					return _mm256_castsi256_ps(_mm256_slli_epi32(h, 16));
+				}
+			};
+
+			/*
+			 *	Double operands, rounded to float as they are loaded (see
+			 *	scalar::f64_narrowed).
+			 */
+			struct f64_narrowed : f32
+			{
+				using storage_type = double;
+
+				static inline vec load(const double* p)
+				{
+					return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_loadu_pd(p))), _mm256_cvtpd_ps(_mm256_loadu_pd(p + 4)), 1);
+				}
+			};
+		}
+	}
+}
+
+#define __PROXIMAL_KERNEL_NAMESPACE__ avx2
+#include "proximal_kernels.h"
+#undef __PROXIMAL_KERNEL_NAMESPACE__
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#pragma clang attribute push (__attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,f16c"))), apply_to = function)
+#else
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512dq,avx512vl,f16c")
+#endif
+
+namespace utils
+{
+	namespace simd
+	{
+		namespace avx512
+		{
+			struct f32
+			{
+				using value_type = float;
+				using storage_type = float;
+				using vec = __m512;
+				using mask = __mmask16;
+				static constexpr std::size_t width = 16;
+				static constexpr unsigned all_bits = 0xFFFF;
+
+				struct params
+				{
+					__m512 scale;
+				};
+
+				static inline params make_params(int n)
+				{
+					return params{_mm512_set1_ps(std::ldexp(1.0f, n - fractional_digits<float>))};
+				}
+
+				static inline vec load(const float* p)
+				{
+					return _mm512_loadu_ps(p);
+				}
+
+				static inline void store(float* p, vec v)
+				{
+					_mm512_storeu_ps(p, v);
+				}
+
+				static inline vec margin_of(vec mag, const params& p)
+				{
+					const __m512 exp_mask = _mm512_castsi512_ps(_mm512_set1_epi32(0x7F800000));
+					const __m512 min_normal = _mm512_set1_ps(std::numeric_limits<float>::min());
+					return _mm512_mul_ps(_mm512_max_ps(_mm512_and_ps(mag, exp_mask), min_normal), p.scale);
+				}
+
+				static inline vec margins(vec x, const params& p)
+				{
+					const __m512 inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+					__m512 mag = _mm512_abs_ps(x);
+					return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(mag, inf, _CMP_LT_OQ), margin_of(mag, p));
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					const __m512 inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+					__m512 mag = _mm512_max_ps(_mm512_abs_ps(a), _mm512_abs_ps(b));
+					__m512 margin = margin_of(mag, p);
+					__m512 diff = _mm512_abs_ps(_mm512_sub_ps(a, b));
+					__mmask16 finite = _mm512_cmp_ps_mask(mag, inf, _CMP_LT_OQ);
+					__mmask16 within = _mm512_mask_cmp_ps_mask(finite, diff, margin, _CMP_LE_OQ);
+					return static_cast<__mmask16>(_mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ) | within);
+				}
+
+				static inline mask both(mask a, mask b)
+				{
+					return static_cast<__mmask16>(a & b);
+				}
+
+				static inline unsigned lanes(mask m)
+				{
+					return static_cast<unsigned>(m);
+				}
+
+				static inline vec splat(float x)
+				{
+					return _mm512_set1_ps(x);
+				}
+
+				static inline vec max(vec a, vec b)
+				{
+					return _mm512_max_ps(a, b);
+				}
+
+				static inline mask greater(vec a, vec b)
+				{
+					return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ);
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const vec inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+					vec abs_a = _mm512_abs_ps(a);
+					vec abs_b = _mm512_abs_ps(b);
+					__mmask16 finite = static_cast<__mmask16>(_mm512_cmp_ps_mask(abs_a, inf, _CMP_LT_OQ) & _mm512_cmp_ps_mask(abs_b, inf, _CMP_LT_OQ));
+					vec mag = _mm512_maskz_mov_ps(finite, _mm512_max_ps(abs_a, abs_b));
+					vec e = _mm512_mask_mov_ps(inf, finite, _mm512_abs_ps(_mm512_sub_ps(a, b)));
+					error = _mm512_maskz_mov_ps(static_cast<__mmask16>(~_mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ)), e);
+					ulps = _mm512_div_ps(error, margin_of(mag, unit));
+				}
+
+				static inline void deinterleave(vec v0, vec v1, vec& re, vec& im)
+				{
+					const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+					const __m512i odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+					re = _mm512_permutex2var_ps(v0, even, v1);
+					im = _mm512_permutex2var_ps(v0, odd, v1);
+				}
+
+				static inline mask close_modulus(vec ar, vec ai, vec br, vec bi, const params& p)
+				{
+					const __m512 inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+					const __m512 exp_mask = _mm512_castsi512_ps(_mm512_set1_epi32(0x7F800000));
+					const __m512 min_normal = _mm512_set1_ps(std::numeric_limits<float>::min());
+					const __m512 one = _mm512_set1_ps(1.0f);
+					__m512 abs_ar = _mm512_abs_ps(ar);
+					__m512 abs_ai = _mm512_abs_ps(ai);
+					__m512 abs_br = _mm512_abs_ps(br);
+					__m512 abs_bi = _mm512_abs_ps(bi);
+					__mmask16 finite = static_cast<__mmask16>(_mm512_cmp_ps_mask(abs_ar, inf, _CMP_LT_OQ) & _mm512_cmp_ps_mask(abs_ai, inf, _CMP_LT_OQ)
+						& _mm512_cmp_ps_mask(abs_br, inf, _CMP_LT_OQ) & _mm512_cmp_ps_mask(abs_bi, inf, _CMP_LT_OQ));
+					__mmask16 equal = static_cast<__mmask16>(_mm512_cmp_ps_mask(ar, br, _CMP_EQ_OQ) & _mm512_cmp_ps_mask(ai, bi, _CMP_EQ_OQ));
+					__m512 big = _mm512_max_ps(_mm512_max_ps(abs_ar, abs_ai), _mm512_max_ps(abs_br, abs_bi));
+					__m512 pow = _mm512_max_ps(_mm512_and_ps(big, exp_mask), min_normal);
+					__m512 inv = _mm512_div_ps(one, pow);
+					__m512 sar = _mm512_mul_ps(ar, inv);
+					__m512 sai = _mm512_mul_ps(ai, inv);
+					__m512 sbr = _mm512_mul_ps(br, inv);
+					__m512 sbi = _mm512_mul_ps(bi, inv);
+					__m512 dr = _mm512_mul_ps(_mm512_sub_ps(ar, br), inv);
+					__m512 di = _mm512_mul_ps(_mm512_sub_ps(ai, bi), inv);
+					__m512 sa = _mm512_add_ps(_mm512_mul_ps(sar, sar), _mm512_mul_ps(sai, sai));
+					__m512 sb = _mm512_add_ps(_mm512_mul_ps(sbr, sbr), _mm512_mul_ps(sbi, sbi));
+					__m512 sd = _mm512_add_ps(_mm512_mul_ps(dr, dr), _mm512_mul_ps(di, di));
+					__m512 smag = _mm512_sqrt_ps(_mm512_max_ps(sa, sb));
+					__m512 ms = _mm512_mul_ps(_mm512_max_ps(_mm512_and_ps(smag, exp_mask), one), p.scale);
+					__mmask16 within = _mm512_mask_cmp_ps_mask(finite, sd, _mm512_mul_ps(ms, ms), _CMP_LE_OQ);
+					return static_cast<__mmask16>(equal | within);
+				}
+			};
+
+			struct f64
+			{
+				using value_type = double;
+				using storage_type = double;
+				using vec = __m512d;
+				using mask = __mmask8;
+				static constexpr std::size_t width = 8;
+				static constexpr unsigned all_bits = 0xFF;
+
+				struct params
+				{
+					__m512d scale;
+				};
+
+				static inline params make_params(int n)
+				{
+					return params{_mm512_set1_pd(std::ldexp(1.0, n - fractional_digits<double>))};
+				}
+
+				static inline vec load(const double* p)
+				{
+					return _mm512_loadu_pd(p);
+				}
+
+				static inline void store(double* p, vec v)
+				{
+					_mm512_storeu_pd(p, v);
+				}
+
+				static inline vec margin_of(vec mag, const params& p)
+				{
+					const __m512d exp_mask = _mm512_castsi512_pd(_mm512_set1_epi64(0x7FF0000000000000));
+					const __m512d min_normal = _mm512_set1_pd(std::numeric_limits<double>::min());
+					return _mm512_mul_pd(_mm512_max_pd(_mm512_and_pd(mag, exp_mask), min_normal), p.scale);
+				}
+
+				static inline vec margins(vec x, const params& p)
+				{
+					const __m512d inf = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+					__m512d mag = _mm512_abs_pd(x);
+					return _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(mag, inf, _CMP_LT_OQ), margin_of(mag, p));
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					const __m512d inf = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+					__m512d mag = _mm512_max_pd(_mm512_abs_pd(a), _mm512_abs_pd(b));
+					__m512d margin = margin_of(mag, p);
+					__m512d diff = _mm512_abs_pd(_mm512_sub_pd(a, b));
+					__mmask8 finite = _mm512_cmp_pd_mask(mag, inf, _CMP_LT_OQ);
+					__mmask8 within = _mm512_mask_cmp_pd_mask(finite, diff, margin, _CMP_LE_OQ);
+					return static_cast<__mmask8>(_mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ) | within);
+				}
+
+				static inline mask both(mask a, mask b)
+				{
+					return static_cast<__mmask8>(a & b);
+				}
+
+				static inline unsigned lanes(mask m)
+				{
+					return static_cast<unsigned>(m);
+				}
+
+				static inline vec splat(double x)
+				{
+					return _mm512_set1_pd(x);
+				}
+
+				static inline vec max(vec a, vec b)
+				{
+					return _mm512_max_pd(a, b);
+				}
+
+				static inline mask greater(vec a, vec b)
+				{
+					return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const vec inf = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+					vec abs_a = _mm512_abs_pd(a);
+					vec abs_b = _mm512_abs_pd(b);
+					__mmask8 finite = static_cast<__mmask8>(_mm512_cmp_pd_mask(abs_a, inf, _CMP_LT_OQ) & _mm512_cmp_pd_mask(abs_b, inf, _CMP_LT_OQ));
+					vec mag = _mm512_maskz_mov_pd(finite, _mm512_max_pd(abs_a, abs_b));
+					vec e = _mm512_mask_mov_pd(inf, finite, _mm512_abs_pd(_mm512_sub_pd(a, b)));
+					error = _mm512_maskz_mov_pd(static_cast<__mmask8>(~_mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ)), e);
+					ulps = _mm512_div_pd(error, margin_of(mag, unit));
+				}
+
+				static inline void deinterleave(vec v0, vec v1, vec& re, vec& im)
+				{
+					const __m512i even = _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14);
+					const __m512i odd = _mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, 15);
+					re = _mm512_permutex2var_pd(v0, even, v1);
+					im = _mm512_permutex2var_pd(v0, odd, v1);
+				}
+
+				static inline mask close_modulus(vec ar, vec ai, vec br, vec bi, const params& p)
+				{
+					const __m512d inf = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+					const __m512d exp_mask = _mm512_castsi512_pd(_mm512_set1_epi64(0x7FF0000000000000));
+					const __m512d min_normal = _mm512_set1_pd(std::numeric_limits<double>::min());
+					const __m512d one = _mm512_set1_pd(1.0);
+					__m512d abs_ar = _mm512_abs_pd(ar);
+					__m512d abs_ai = _mm512_abs_pd(ai);
+					__m512d abs_br = _mm512_abs_pd(br);
+					__m512d abs_bi = _mm512_abs_pd(bi);
+					__mmask8 finite = static_cast<__mmask8>(_mm512_cmp_pd_mask(abs_ar, inf, _CMP_LT_OQ) & _mm512_cmp_pd_mask(abs_ai, inf, _CMP_LT_OQ)
+						& _mm512_cmp_pd_mask(abs_br, inf, _CMP_LT_OQ) & _mm512_cmp_pd_mask(abs_bi, inf, _CMP_LT_OQ));
+					__mmask8 equal = static_cast<__mmask8>(_mm512_cmp_pd_mask(ar, br, _CMP_EQ_OQ) & _mm512_cmp_pd_mask(ai, bi, _CMP_EQ_OQ));
+					__m512d big = _mm512_max_pd(_mm512_max_pd(abs_ar, abs_ai), _mm512_max_pd(abs_br, abs_bi));
+					__m512d pow = _mm512_max_pd(_mm512_and_pd(big, exp_mask), min_normal);
+					__m512d inv = _mm512_div_pd(one, pow);
+					__m512d sar = _mm512_mul_pd(ar, inv);
+					__m512d sai = _mm512_mul_pd(ai, inv);
+					__m512d sbr = _mm512_mul_pd(br, inv);
+					__m512d sbi = _mm512_mul_pd(bi, inv);
+					__m512d dr = _mm512_mul_pd(_mm512_sub_pd(ar, br), inv);
+					__m512d di = _mm512_mul_pd(_mm512_sub_pd(ai, bi), inv);
+					__m512d sa = _mm512_add_pd(_mm512_mul_pd(sar, sar), _mm512_mul_pd(sai, sai));
+					__m512d sb = _mm512_add_pd(_mm512_mul_pd(sbr, sbr), _mm512_mul_pd(sbi, sbi));
+					__m512d sd = _mm512_add_pd(_mm512_mul_pd(dr, dr), _mm512_mul_pd(di, di));
+					__m512d smag = _mm512_sqrt_pd(_mm512_max_pd(sa, sb));
+					__m512d ms = _mm512_mul_pd(_mm512_max_pd(_mm512_and_pd(smag, exp_mask), one), p.scale);
+					__mmask8 within = _mm512_mask_cmp_pd_mask(finite, sd, _mm512_mul_pd(ms, ms), _CMP_LE_OQ);
+					return static_cast<__mmask8>(equal | within);
+				}
+			};
+
+			/*
+			 *	Half operands, widened to float as they are loaded (see
+			 *	scalar::f16).
+			 */
+			struct f16 : f32
+			{
+				using storage_type = half;
+
+				static inline params make_params(int n)
+				{
+					return params{_mm512_set1_ps(std::ldexp(1.0f, n - fractional_digits<half>))};
+				}
+
+				static inline vec load(const half* p)
+				{
+					return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+				}
+
+				static inline vec margin_of(vec mag, const params& p)
+				{
+					const __m512 exp_mask = _mm512_castsi512_ps(_mm512_set1_epi32(0x7F800000));
+					const __m512 min_normal = _mm512_castsi512_ps(_mm512_set1_epi32(0x38800000));
+					const __m512 limit = _mm512_castsi512_ps(_mm512_set1_epi32(0x47000000));
+					__m512 margin = _mm512_mul_ps(_mm512_max_ps(_mm512_and_ps(mag, exp_mask), min_normal), p.scale);
+					return _mm512_mask_mov_ps(margin, _mm512_cmp_ps_mask(margin, limit, _CMP_GT_OQ), exp_mask);
+				}
+
+				static inline mask close(vec a, vec b, const params& p)
+				{
+					const __m512 inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+					__m512 mag = _mm512_max_ps(_mm512_abs_ps(a), _mm512_abs_ps(b));
+					__m512 margin = margin_of(mag, p);
+					__m512 diff = _mm512_abs_ps(_mm512_sub_ps(a, b));
+					__mmask16 finite = _mm512_cmp_ps_mask(mag, inf, _CMP_LT_OQ);
+					__mmask16 within = _mm512_mask_cmp_ps_mask(finite, diff, margin, _CMP_LE_OQ);
+					return static_cast<__mmask16>(_mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ) | within);
+				}
+
+				static inline void errors(vec a, vec b, const params& unit, vec& error, vec& ulps)
+				{
+					const vec inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+					vec abs_a = _mm512_abs_ps(a);
+					vec abs_b = _mm512_abs_ps(b);
+					__mmask16 finite = static_cast<__mmask16>(_mm512_cmp_ps_mask(abs_a, inf, _CMP_LT_OQ) & _mm512_cmp_ps_mask(abs_b, inf, _CMP_LT_OQ));
+					vec mag = _mm512_maskz_mov_ps(finite, _mm512_max_ps(abs_a, abs_b));
+					vec e = _mm512_mask_mov_ps(inf, finite, _mm512_abs_ps(_mm512_sub_ps(a, b)));
+					error = _mm512_maskz_mov_ps(static_cast<__mmask16>(~_mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ)), e);
+					ulps = _mm512_div_ps(error, margin_of(mag, unit));
+				}
+			};
+
+			/*
+			 *	bfloat16 operands, widened to float as they are loaded (see
+			 *	scalar::bf16).
+			 */
+			struct bf16 : f32
+			{
+				using storage_type = bfloat16;
+
+				static inline params make_params(int n)
+				{
+					return params{_mm512_set1_ps(std::ldexp(1.0f, n - fractional_digits<bfloat16>))};
+				}
+
+				static inline vec load(const bfloat16* p)
+				{
+					__m512i h = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+					return _mm512_castsi512_ps(_mm512_slli_epi32(h, 16));
+				}
+			};
+
+			/*
+			 *	Double operands, rounded to float as they are loaded (see
+			 *	scalar::f64_narrowed).
+			 */
+			struct f64_narrowed : f32
+			{
+				using storage_type = double;
+
+				static inline vec load(const double* p)
+				{
+					return _mm512_insertf32x8(_mm512_castps256_ps512(_mm512_cvtpd_ps(_mm512_loadu_pd(p))), _mm512_cvtpd_ps(_mm512_loadu_pd(p + 8)), 1);
+				}
+			};
+		}
+	}
+}
+
+#define __PROXIMAL_KERNEL_NAMESPACE__ avx512
+#include "proximal_kernels.h"
+#undef __PROXIMAL_KERNEL_NAMESPACE__
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif // __USE_X86_SIMD_KERNELS__
+
+namespace utils
+{
+	namespace simd
+	{
+		/*
+		 *	Dispatch to the kernels of the active instruction set. n is the
+		 *	margin exponent, i.e. the N of proximal<N>.
+		 */
+
+		template<class T>
+		struct __ops;
+
+		template<>
+		struct __ops<float>
+		{
+			using scalar = simd::scalar::f32;
+		#if (__USE_X86_SIMD_KERNELS__)
+			using sse2 = simd::sse2::f32;
+			using avx2 = simd::avx2::f32;
+			using avx512 = simd::avx512::f32;
+		#endif
+		};
+
+		template<>
+		struct __ops<double>
+		{
+			using scalar = simd::scalar::f64;
+		#if (__USE_X86_SIMD_KERNELS__)
+			using sse2 = simd::sse2::f64;
+			using avx2 = simd::avx2::f64;
+			using avx512 = simd::avx512::f64;
+		#endif
+		};
+
+		template<>
+		struct __ops<half>
+		{
+			using scalar = simd::scalar::f16;
+		#if (__USE_X86_SIMD_KERNELS__)
+			using sse2 = simd::sse2::f16;
+			using avx2 = simd::avx2::f16;
+			using avx512 = simd::avx512::f16;
+		#endif
+		};
+
+		template<>
+		struct __ops<bfloat16>
+		{
+			using scalar = simd::scalar::bf16;
+		#if (__USE_X86_SIMD_KERNELS__)
+			using sse2 = simd::sse2::bf16;
+			using avx2 = simd::avx2::bf16;
+			using avx512 = simd::avx512::bf16;
+		#endif
+		};
+
+		template<class T>
+		inline bool all_close(const T* a, const T* b, std::size_t count, int n)
+		{
+			switch (active())
+			{
+		#if (__USE_X86_SIMD_KERNELS__)
+				case isa::avx512: return simd::avx512::all_close<typename __ops<T>::avx512>(a, b, count, n);
+				case isa::avx2: return simd::avx2::all_close<typename __ops<T>::avx2>(a, b, count, n);
+				case isa::sse2: return simd::sse2::all_close<typename __ops<T>::sse2>(a, b, count, n);
+		#endif
+				default: return simd::scalar::all_close<typename __ops<T>::scalar>(a, b, count, n);
+			}
+		}
+
+		template<class T>
+		inline void margins(const T* x, T* result, std::size_t count, int n)
+		{
+			switch (active())
+			{
+		#if (__USE_X86_SIMD_KERNELS__)
+				case isa::avx512: return simd::avx512::margins<typename __ops<T>::avx512>(x, result, count, n);
+				case isa::avx2: return simd::avx2::margins<typename __ops<T>::avx2>(x, result, count, n);
+				case isa::sse2: return simd::sse2::margins<typename __ops<T>::sse2>(x, result, count, n);
+		#endif
+				default: return simd::scalar::margins<typename __ops<T>::scalar>(x, result, count, n);
+			}
+		}
+
+		template<class T>
+		inline std::size_t mismatches(const T* a, const T* b, std::size_t count, int n, std::uint64_t* mask)
+		{
+			switch (active())
+			{
+		#if (__USE_X86_SIMD_KERNELS__)
+				case isa::avx512: return simd::avx512::mismatches<typename __ops<T>::avx512>(a, b, count, n, mask);
+				case isa::avx2: return simd::avx2::mismatches<typename __ops<T>::avx2>(a, b, count, n, mask);
+				case isa::sse2: return simd::sse2::mismatches<typename __ops<T>::sse2>(a, b, count, n, mask);
+		#endif
+				default: return simd::scalar::mismatches<typename __ops<T>::scalar>(a, b, count, n, mask);
+			}
+		}
+
+		template<class T>
+		inline proximal_stats<typename __ops<T>::scalar::value_type> stats(const T* a, const T* b, std::size_t count, int n, std::size_t first_index)
+		{
+			switch (active())
+			{
+		#if (__USE_X86_SIMD_KERNELS__)
+				case isa::avx512: return simd::avx512::stats<typename __ops<T>::avx512>(a, b, count, n, first_index);
+				case isa::avx2: return simd::avx2::stats<typename __ops<T>::avx2>(a, b, count, n, first_index);
+				case isa::sse2: return simd::sse2::stats<typename __ops<T>::sse2>(a, b, count, n, first_index);
+		#endif
+				default: return simd::scalar::stats<typename __ops<T>::scalar>(a, b, count, n, first_index);
+			}
+		}
+
+		/*
+		 *	Float results against double references, which are rounded to float
+		 *	in registers as they are loaded.
+		 */
+
+		struct __narrowed_ops
+		{
+			using scalar = simd::scalar::f64_narrowed;
+		#if (__USE_X86_SIMD_KERNELS__)
+			using sse2 = simd::sse2::f64_narrowed;
+			using avx2 = simd::avx2::f64_narrowed;
+			using avx512 = simd::avx512::f64_narrowed;
+		#endif
+		};
+
+		inline bool all_close(const float* a, const double* b, std::size_t count, int n)
+		{
+			switch (active())
+			{
+		#if (__USE_X86_SIMD_KERNELS__)
+				case isa::avx512: return simd::avx512::all_close<__ops<float>::avx512, __narrowed_ops::avx512>(a, b, count, n);
+				case isa::avx2: return simd::avx2::all_close<__ops<float>::avx2, __narrowed_ops::avx2>(a, b, count, n);
+				case isa::sse2: return simd::sse2::all_close<__ops<float>::sse2, __narrowed_ops::sse2>(a, b, count, n);
+		#endif
+				default: return simd::scalar::all_close<__ops<float>::scalar, __narrowed_ops::scalar>(a, b, count, n);
+			}
+		}
+
+		inline std::size_t mismatches(const float* a, const double* b, std::size_t count, int n, std::uint64_t* mask)
+		{
+			switch (active())
+			{
+		#if (__USE_X86_SIMD_KERNELS__)
+				case isa::avx512: return simd::avx512::mismatches<__ops<float>::avx512, __narrowed_ops::avx512>(a, b, count, n, mask);
+				case isa::avx2: return simd::avx2::mismatches<__ops<float>::avx2, __narrowed_ops::avx2>(a, b, count, n, mask);
+				case isa::sse2: return simd::sse2::mismatches<__ops<float>::sse2, __narrowed_ops::sse2>(a, b, count, n, mask);
+		#endif
+				default: return simd::scalar::mismatches<__ops<float>::scalar, __narrowed_ops::scalar>(a, b, count, n, mask);
+			}
+		}
+
+		inline proximal_stats<float> stats(const float* a, const double* b, std::size_t count, int n, std::size_t first_index)
+		{
+			switch (active())
+			{
+		#if (__USE_X86_SIMD_KERNELS__)
+				case isa::avx512: return simd::avx512::stats<__ops<float>::avx512, __narrowed_ops::avx512>(a, b, count, n, first_index);
+				case isa::avx2: return simd::avx2::stats<__ops<float>::avx2, __narrowed_ops::avx2>(a, b, count, n, first_index);
+				case isa::sse2: return simd::sse2::stats<__ops<float>::sse2, __narrowed_ops::sse2>(a, b, count, n, first_index);
+		#endif
+				default: return simd::scalar::stats<__ops<float>::scalar, __narrowed_ops::scalar>(a, b, count, n, first_index);
+			}
+		}
+
+		/*
+		 *	Modulus comparison of complex values stored as interleaved parts,
+		 *	count values (2 * count parts) per array.
+		 */
+
+		template<class T>
+		inline bool all_close_modulus(const T* a, const T* b, std::size_t count, int n)
+		{
+			switch (active())
+			{
+		#if (__USE_X86_SIMD_KERNELS__)
+				case isa::avx512: return simd::avx512::all_close_modulus<typename __ops<T>::avx512>(a, b, count, n);
+				case isa::avx2: return simd::avx2::all_close_modulus<typename __ops<T>::avx2>(a, b, count, n);
+				case isa::sse2: return simd::sse2::all_close_modulus<typename __ops<T>::sse2>(a, b, count, n);
+		#endif
+				default: return simd::scalar::all_close_modulus<typename __ops<T>::scalar>(a, b, count, n);
+			}
+		}
+
+		template<class T>
+		inline std::size_t mismatches_modulus(const T* a, const T* b, std::size_t count, int n, std::uint64_t* mask)
+		{
+			switch (active())
+			{
+		#if (__USE_X86_SIMD_KERNELS__)
+				case isa::avx512: return simd::avx512::mismatches_modulus<typename __ops<T>::avx512>(a, b, count, n, mask);
+				case isa::avx2: return simd::avx2::mismatches_modulus<typename __ops<T>::avx2>(a, b, count, n, mask);
+				case isa::sse2: return simd::sse2::mismatches_modulus<typename __ops<T>::sse2>(a, b, count, n, mask);
+		#endif
+				default: return simd::scalar::mismatches_modulus<typename __ops<T>::scalar>(a, b, count, n, mask);
+			}
+		}
+	}
+}
+
+#endif /* guard_utils_proximal_simd_h */
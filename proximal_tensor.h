@@ -0,0 +1,351 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef guard_utils_proximal_tensor_h
+#define guard_utils_proximal_tensor_h
+
+#include "proximal.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+/*
+ *	Comparisons of N-dimensional tensors through views: a pointer, a shape,
+ *	and a stride per axis in elements, which may be negative, or zero to
+ *	repeat (broadcast) the same elements along an axis. The views compared
+ *	must have the same shape; the elements need not be contiguous, and are
+ *	never copied into a contiguous tensor.
+ *
+ *	A comparison first reduces both views to one loop nest. Axes of extent 1
+ *	are dropped, axes on which both strides are negative are reversed, and
+ *	the innermost axis is the one that is contiguous in both views, if there
+ *	is one. The other axes are ordered by decreasing stride, and neighbouring
+ *	axes that are contiguous with each other in both views are merged, so a
+ *	contiguous slice of a row-major or column-major tensor is a single run.
+ *	Contiguous runs go straight to the batch kernels of the comparison; runs
+ *	that are strided or broadcast in one view are gathered a tile at a time
+ *	into a small buffer first.
+ *
+ *	When the axis next to the innermost is broadcast in one view (e.g. a
+ *	reference row compared with every row of a matrix), the innermost axis
+ *	is split into tiles and the broadcast axis is looped over inside each
+ *	tile, so the tile of the broadcast operand stays in cache while it is
+ *	compared with every row.
+ */
+
+namespace utils
+{
+	namespace tensor
+	{
+		template<class T>
+		struct view
+		{
+			const T* data = nullptr;
+			std::vector<std::size_t> shape;
+			std::vector<std::ptrdiff_t> strides;
+
+			static inline view row_major(const T* data, std::vector<std::size_t> shape)
+			{
+				view v{data, std::move(shape), {}};
+				v.strides.resize(v.shape.size());
+				std::ptrdiff_t stride = 1;
+				for (std::size_t i = v.shape.size(); i-- > 0;)
+				{
+					v.strides[i] = stride;
+					stride *= static_cast<std::ptrdiff_t>(v.shape[i]);
+				}
+				return v;
+			}
+
+			static inline view column_major(const T* data, std::vector<std::size_t> shape)
+			{
+				view v{data, std::move(shape), {}};
+				v.strides.resize(v.shape.size());
+				std::ptrdiff_t stride = 1;
+				for (std::size_t i = 0; i < v.shape.size(); ++i)
+				{
+					v.strides[i] = stride;
+					stride *= static_cast<std::ptrdiff_t>(v.shape[i]);
+				}
+				return v;
+			}
+
+			/*
+			 *	This view broadcast to shape, by the rules of NumPy: the axes are
+			 *	aligned at the end, and missing axes and axes of extent 1 are
+			 *	repeated with stride 0.
+			 */
+			inline view broadcast(const std::vector<std::size_t>& to) const
+			{
+				assert(to.size() >= shape.size());
+				view v{data, to, std::vector<std::ptrdiff_t>(to.size(), 0)};
+				const std::size_t offset = to.size() - shape.size();
+				for (std::size_t i = 0; i < shape.size(); ++i)
+				{
+					assert(shape[i] == to[offset + i] || shape[i] == 1);
+					v.strides[offset + i] = shape[i] == 1 ? 0 : strides[i];
+				}
+				return v;
+			}
+
+			inline std::size_t size() const
+			{
+				std::size_t n = 1;
+				for (std::size_t extent : shape)
+				{
+					n *= extent;
+				}
+				return n;
+			}
+		};
+
+		struct __axis
+		{
+			std::size_t extent;
+			std::ptrdiff_t a;
+			std::ptrdiff_t b;
+		};
+
+		/*
+		 *	The loop nest for a and b, innermost axis last (see above). The data
+		 *	pointers move to the first element of reversed axes. A nest with no
+		 *	axes has one element; an empty tensor has an axis of extent 0.
+		 */
+		template<class T>
+		inline std::vector<__axis> __plan(const T*& a, const T*& b, const view<T>& va, const view<T>& vb)
+		{
+			assert(va.shape == vb.shape && va.strides.size() == va.shape.size() && vb.strides.size() == vb.shape.size());
+			std::vector<__axis> axes;
+			for (std::size_t i = 0; i < va.shape.size(); ++i)
+			{
+				if (va.shape[i] == 0)
+				{
+					return {__axis{0, 0, 0}};
+				}
+				if (va.shape[i] == 1)
+				{
+					continue;
+				}
+				__axis x{va.shape[i], va.strides[i], vb.strides[i]};
+				if (x.a < 0 && x.b < 0)
+				{
+					a += x.a * static_cast<std::ptrdiff_t>(x.extent - 1);
+					b += x.b * static_cast<std::ptrdiff_t>(x.extent - 1);
+					x.a = -x.a;
+					x.b = -x.b;
+				}
+				axes.push_back(x);
+			}
+			if (axes.empty())
+			{
+				return axes;
+			}
+			// rank the candidates for the innermost axis: contiguous in both,
+			// contiguous in one and broadcast in the other, contiguous in one,
+			// and otherwise the smallest strides
+			auto rank = [](const __axis& x)
+			{
+				const bool unit_a = x.a == 1;
+				const bool unit_b = x.b == 1;
+				return std::make_pair(unit_a && unit_b ? 0 : (unit_a && x.b == 0) || (unit_b && x.a == 0) ? 1 : unit_a || unit_b ? 2 : 3,
+					std::abs(x.a) + std::abs(x.b));
+			};
+			auto inner = std::min_element(axes.begin(), axes.end(), [&](const __axis& x, const __axis& y) { return rank(x) < rank(y); });
+			std::iter_swap(inner, axes.end() - 1);
+			std::stable_sort(axes.begin(), axes.end() - 1, [](const __axis& x, const __axis& y)
+			{
+				return std::max(std::abs(x.a), std::abs(x.b)) > std::max(std::abs(y.a), std::abs(y.b));
+			});
+			std::vector<__axis> merged{axes.back()};
+			for (std::size_t i = axes.size() - 1; i-- > 0;)
+			{
+				__axis& in = merged.back();
+				const __axis& out = axes[i];
+				if (out.a == in.a * static_cast<std::ptrdiff_t>(in.extent) && out.b == in.b * static_cast<std::ptrdiff_t>(in.extent))
+				{
+					in.extent *= out.extent;
+				}
+				else
+				{
+					merged.push_back(out);
+				}
+			}
+			std::reverse(merged.begin(), merged.end());
+			return merged;
+		}
+
+		constexpr std::size_t __tile = 1024;
+
+		/*
+		 *	Compares a run of count elements with strides sa and sb, gathering
+		 *	strided or broadcast operands a tile at a time. done(a, b, count)
+		 *	compares contiguous arrays and returns false to stop. Returns false
+		 *	if stopped.
+		 */
+		template<class T, class F>
+		inline bool __run(const T* a, std::ptrdiff_t sa, const T* b, std::ptrdiff_t sb, std::size_t count, F& done)
+		{
+			if (sa == 1 && sb == 1)
+			{
+				return done(a, b, count);
+			}
+			T buffer_a[__tile];
+			T buffer_b[__tile];
+			for (std::size_t i = 0; i < count; i += __tile)
+			{
+				const std::size_t n = std::min(__tile, count - i);
+				const T* x = a + sa * static_cast<std::ptrdiff_t>(i);
+				const T* y = b + sb * static_cast<std::ptrdiff_t>(i);
+				if (sa != 1)
+				{
+					for (std::size_t k = 0; k < n; ++k)
+					{
+						buffer_a[k] = x[sa * static_cast<std::ptrdiff_t>(k)];
+					}
+					x = buffer_a;
+				}
+				if (sb != 1)
+				{
+					for (std::size_t k = 0; k < n; ++k)
+					{
+						buffer_b[k] = y[sb * static_cast<std::ptrdiff_t>(k)];
+					}
+					y = buffer_b;
+				}
+				if (!done(x, y, n))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/*
+		 *	Calls __run() for every run of the loop nest of a and b.
+		 */
+		template<class T, class F>
+		inline bool __for_each_run(const view<T>& va, const view<T>& vb, F&& done)
+		{
+			const T* a = va.data;
+			const T* b = vb.data;
+			std::vector<__axis> axes = __plan(a, b, va, vb);
+			if (axes.empty())
+			{
+				return done(a, b, 1);
+			}
+			const __axis inner = axes.back();
+			axes.pop_back();
+			if (inner.extent == 0)
+			{
+				return true;
+			}
+			// tile the innermost axis when the next one is broadcast in one view
+			const bool tiled = !axes.empty() && (axes.back().a == 0 || axes.back().b == 0) && inner.extent > __tile;
+			__axis next{1, 0, 0};
+			if (tiled)
+			{
+				next = axes.back();
+				axes.pop_back();
+			}
+			std::vector<std::size_t> index(axes.size(), 0);
+			for (;;)
+			{
+				if (tiled)
+				{
+					for (std::size_t t = 0; t < inner.extent; t += __tile)
+					{
+						const std::size_t n = std::min(__tile, inner.extent - t);
+						for (std::size_t j = 0; j < next.extent; ++j)
+						{
+							const T* x = a + next.a * static_cast<std::ptrdiff_t>(j) + inner.a * static_cast<std::ptrdiff_t>(t);
+							const T* y = b + next.b * static_cast<std::ptrdiff_t>(j) + inner.b * static_cast<std::ptrdiff_t>(t);
+							if (!__run(x, inner.a, y, inner.b, n, done))
+							{
+								return false;
+							}
+						}
+					}
+				}
+				else if (!__run(a, inner.a, b, inner.b, inner.extent, done))
+				{
+					return false;
+				}
+				// advance the outer indices, last axis fastest
+				std::size_t k = axes.size();
+				for (; k-- > 0;)
+				{
+					a += axes[k].a;
+					b += axes[k].b;
+					if (++index[k] < axes[k].extent)
+					{
+						break;
+					}
+					a -= axes[k].a * static_cast<std::ptrdiff_t>(axes[k].extent);
+					b -= axes[k].b * static_cast<std::ptrdiff_t>(axes[k].extent);
+					index[k] = 0;
+				}
+				if (k == static_cast<std::size_t>(-1))
+				{
+					return true;
+				}
+			}
+		}
+
+		/*
+		 *	close_enough.all_close() over every element of two views of the same
+		 *	shape, for proximal<N> or proximal_dynamic.
+		 */
+		template<class P, class T>
+		inline bool all_close(const P& close_enough, const view<T>& a, const view<T>& b)
+		{
+			return __for_each_run(a, b, [&](const T* x, const T* y, std::size_t n) { return close_enough.all_close(x, y, n); });
+		}
+
+		/*
+		 *	The number of elements of two views of the same shape that are not
+		 *	close enough.
+		 */
+		template<class P, class T>
+		inline std::size_t mismatches(const P& close_enough, const view<T>& a, const view<T>& b)
+		{
+			std::size_t total = 0;
+			std::uint64_t mask[__tile / 64];
+			__for_each_run(a, b, [&](const T* x, const T* y, std::size_t n)
+			{
+				for (std::size_t i = 0; i < n; i += __tile)
+				{
+					total += close_enough.mismatches(x + i, y + i, std::min(__tile, n - i), mask);
+				}
+				return true;
+			});
+			return total;
+		}
+	}
+}
+
+#endif // guard_utils_proximal_tensor_h
@@ -0,0 +1,279 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef guard_utils_proximal_unique_h
+#define guard_utils_proximal_unique_h
+
+#include "proximal.h"
+#include "proximal_parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+/*
+ *	Removal of near-duplicates from sorted arrays (ascending, without NaN),
+ *	keeping the first element of each run. Closeness is not transitive, so a
+ *	run must say what its elements are close to:
+ *
+ *	anchor	an element joins the run if it is close enough to the first element
+ *			of the run (the anchor). The first element that is not starts the
+ *			next run. No two elements kept are close, and every element
+ *			removed is close to the element kept before it. This is what
+ *			std::unique does with a proximal predicate.
+ *	chain	an element joins the run if it is close enough to the element
+ *			before it, so a run can drift by many margins from its first
+ *			element. Every element removed is close to its predecessor, and
+ *			the result does not depend on where the array starts.
+ *
+ *	Under chain semantics each element is kept or removed by one comparison
+ *	with its predecessor, so the comparisons are done by the batch kernels of
+ *	proximal::mismatches() and the kept elements moved by walking the bits of
+ *	the mask. Under anchor semantics the runs are found one after another:
+ *	the elements within margin<N>(a) of an anchor a are all close to it, and
+ *	are skipped with a galloping search, leaving only those up to
+ *	margin<N + 1>(a), where closeness changes at a power of two, to compare.
+ *
+ *	parallel::proximal_unique() splits the work over a pool of threads
+ *	(see proximal_parallel.h).
+ */
+
+namespace utils
+{
+	enum class proximal_chaining
+	{
+		anchor,
+		chain
+	};
+
+	/*
+	 *	The first element of [first, last) that is not close enough to a, for a
+	 *	no greater than *first.
+	 */
+	template<int N, class T>
+	inline const T* __skip_close(T a, const T* first, const T* last)
+	{
+		if (!__is_inf_or_nan(a))
+		{
+			const T bound = std::min(a + margin<N>(a), std::numeric_limits<T>::max());
+			std::size_t step = 1;
+			while (step <= static_cast<std::size_t>(last - first) && !(bound < first[step - 1]))
+			{
+				first += step;
+				step *= 2;
+			}
+			first = std::upper_bound(first, first + std::min(step, static_cast<std::size_t>(last - first)), bound);
+		}
+		while (first != last && proximal<N>{}(a, *first))
+		{
+			++first;
+		}
+		return first;
+	}
+
+	/*
+	 *	Compacts the anchors of [first, last), the first of which is first, to
+	 *	out (which may be first). Returns the end of the output.
+	 */
+	template<int N, class T>
+	inline T* __compact_anchors(const T* first, const T* last, T* out)
+	{
+		while (first != last)
+		{
+			const T anchor = *first;
+			first = __skip_close<N>(anchor, first + 1, last);
+			*out++ = anchor;
+		}
+		return out;
+	}
+
+	/*
+	 *	Compacts [first, last) to out (which may be first) under chain
+	 *	semantics, keeping *first if keep_first. Returns the end of the output.
+	 */
+	template<int N, class T>
+	inline T* __compact_chain(const T* first, const T* last, bool keep_first, T* out)
+	{
+		if (first == last)
+		{
+			return out;
+		}
+		if (keep_first)
+		{
+			*out++ = *first;
+		}
+		constexpr std::size_t block = 4096;
+		std::uint64_t mask[block / 64];
+		for (std::size_t done = 0, pairs = static_cast<std::size_t>(last - first) - 1; done < pairs; done += block)
+		{
+			// bit i of the mask is set if first[i] and first[i + 1] are not
+			// close, which keeps first[i + 1]
+			const T* a = first + done;
+			const std::size_t count = std::min(block, pairs - done);
+			proximal<N>{}.mismatches(a, a + 1, count, mask);
+			for (std::size_t w = 0; w < (count + 63) / 64; ++w)
+			{
+				for (std::uint64_t bits = mask[w]; bits != 0; bits &= bits - 1)
+				{
+					std::uint64_t lowest = bits & (~bits + 1);
+					*out++ = a[w * 64 + static_cast<std::size_t>(63 - count_leading_zeros(lowest)) + 1];
+				}
+			}
+		}
+		return out;
+	}
+
+	/*
+	 *	Removes the near-duplicates of the sorted array [first, last) in place,
+	 *	as described above, and returns the new end.
+	 */
+	template<int N = 1, class T>
+	inline T* proximal_unique(T* first, T* last, proximal_chaining chaining)
+	{
+		static_assert(std::numeric_limits<T>::is_specialized, "proximal_unique needs std::numeric_limits<T>");
+		return chaining == proximal_chaining::anchor ? __compact_anchors<N>(first, last, first) : __compact_chain<N>(first, last, true, first);
+	}
+
+	namespace parallel
+	{
+		/*
+		 *	proximal_unique(first, last, chaining), with the chunks spread over a
+		 *	pool. Each chunk is compacted in place to its own start, and the
+		 *	compacted chunks are then moved together in order.
+		 *
+		 *	Under chain semantics whether the first element of a chunk is kept
+		 *	depends only on the last element of the chunk before, so those are
+		 *	decided before the chunks are compacted. Under anchor semantics the
+		 *	runs of a chunk depend on where the runs before it ended. A first
+		 *	pass finds the runs of every chunk as if its first element started
+		 *	one. A serial pass over the chunks then finds, from the last anchor of
+		 *	the chunk before, the first true anchor of each chunk, and follows
+		 *	the true and speculative anchors until they meet, which is usually
+		 *	after a run or two; from there the runs are the same. The compacting
+		 *	pass then starts each chunk from its true first anchor.
+		 */
+		template<int N = 1, class T>
+		inline T* proximal_unique(T* first, T* last, proximal_chaining chaining, const options& opts = options{})
+		{
+			const std::size_t count = static_cast<std::size_t>(last - first);
+			const std::size_t chunk = __chunk_elements<T>(opts);
+			const std::size_t chunks = (count + chunk - 1) / chunk;
+			if (chunks <= 1)
+			{
+				return utils::proximal_unique<N>(first, last, chaining);
+			}
+			pool& workers = __pool_for(opts);
+			// the element each chunk starts from (or its end, if it keeps none),
+			// and the number of elements it keeps
+			std::vector<const T*> starts(chunks);
+			std::vector<std::size_t> kept(chunks);
+			auto end_of = [&](std::size_t i) { return first + std::min(count, (i + 1) * chunk); };
+			if (chaining == proximal_chaining::chain)
+			{
+				for (std::size_t i = 0; i < chunks; ++i)
+				{
+					const T* begin = first + i * chunk;
+					starts[i] = i == 0 || !proximal<N>{}(begin[-1], begin[0]) ? begin : begin + 1;
+				}
+				workers.run(chunks, [&](std::size_t i)
+				{
+					T* begin = first + i * chunk;
+					kept[i] = static_cast<std::size_t>(__compact_chain<N>(begin, end_of(i), starts[i] == begin, begin) - begin);
+					return true;
+				}, first, chunk * sizeof(T));
+			}
+			else
+			{
+				std::vector<std::size_t> guessed(chunks);
+				std::vector<const T*> guessed_last(chunks);
+				workers.run(chunks, [&](std::size_t i)
+				{
+					const T* end = end_of(i);
+					std::size_t n = 0;
+					for (const T* anchor = first + i * chunk; anchor != end; anchor = __skip_close<N>(*anchor, anchor + 1, end))
+					{
+						guessed_last[i] = anchor;
+						++n;
+					}
+					guessed[i] = n;
+					return true;
+				}, first, chunk * sizeof(T));
+				starts[0] = first;
+				kept[0] = guessed[0];
+				const T* anchor = guessed_last[0];
+				for (std::size_t i = 1; i < chunks; ++i)
+				{
+					const T* begin = first + i * chunk;
+					const T* end = end_of(i);
+					const T* real = __skip_close<N>(*anchor, begin, end);
+					const T* guess = begin;
+					std::size_t real_before = 0;
+					std::size_t guessed_before = 0;
+					starts[i] = real;
+					while (real != end && real != guess)
+					{
+						if (guess < real)
+						{
+							guess = __skip_close<N>(*guess, guess + 1, end);
+							++guessed_before;
+						}
+						else
+						{
+							anchor = real;
+							real = __skip_close<N>(*real, real + 1, end);
+							++real_before;
+						}
+					}
+					if (real == end)
+					{
+						kept[i] = real_before;
+					}
+					else
+					{
+						kept[i] = real_before + guessed[i] - guessed_before;
+						anchor = guessed_last[i];
+					}
+				}
+				workers.run(chunks, [&](std::size_t i)
+				{
+					T* begin = first + i * chunk;
+					__compact_anchors<N>(starts[i], end_of(i), begin);
+					return true;
+				}, first, chunk * sizeof(T));
+			}
+			T* out = first + kept[0];
+			for (std::size_t i = 1; i < chunks; ++i)
+			{
+				std::memmove(out, first + i * chunk, kept[i] * sizeof(T));
+				out += kept[i];
+			}
+			return out;
+		}
+	}
+}
+
+#endif // guard_utils_proximal_unique_h
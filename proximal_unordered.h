@@ -0,0 +1,493 @@
+/*
+MIT License
+
+Copyright © 2016 David Curtis
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef guard_utils_proximal_unordered_h
+#define guard_utils_proximal_unordered_h
+
+#include "proximal.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ *	Hash sets and maps keyed by floating point values, in which two keys are
+ *	the same if proximal<N> says they are close enough.
+ *
+ *	Keys are hashed by their position among the representable values (see
+ *	ulp_distance()). Within a binade the margin of proximal<N> is 2^N ulps,
+ *	and across a binade boundary it is at most 2^(N+1) ulps of the smaller
+ *	binade, so any two close keys are at most 2^(N+1) positions apart. The
+ *	positions are divided into cells of 2^(N+2): a key in the lower half of
+ *	its cell can only be close to keys in its own cell or the one below, and
+ *	a key in the upper half to keys in its own cell or the one above. A lookup
+ *	therefore probes exactly two cells, and finds every stored key that is
+ *	close enough. (Keys of opposite signs are never close for N below the
+ *	number of fractional digits, except among denormals, where positions are
+ *	counted through zero.)
+ *
+ *	Closeness is not transitive, so keys are not merged: a key is inserted
+ *	unless some stored key is close to it, and a lookup returns the stored key
+ *	nearest to the argument, in ulps. NaN is close to nothing, as in proximal,
+ *	so a NaN key could never be found or erased: NaN keys are not inserted.
+ *
+ *	The elements are stored contiguously, in insertion order until an erase
+ *	moves the last element into the gap, and iterators are pointers into that
+ *	array. The index is an open addressing table of cells with linear probing,
+ *	kept at most half full. As with std::vector, inserting may invalidate
+ *	iterators, and erasing invalidates iterators to the erased and the last
+ *	element.
+ */
+
+namespace utils
+{
+	/*
+	 *	The position of x among the representable values of T, zero for both
+	 *	zeros. Positions that do not fit in std::int64_t saturate, which keeps
+	 *	close keys in the same or neighbouring cells; the wider formats use
+	 *	their full 128-bit positions instead.
+	 */
+	template<class T>
+	inline std::int64_t __ordinal(T x)
+	{
+		return ulp_distance(static_cast<T>(0.0f), x);
+	}
+
+#if (__USE_LONG_DOUBLE_X86_EXTENDED_SPECIALIZATION__) && defined(__SIZEOF_INT128__)
+
+	inline __int128 __ordinal(long double x)
+	{
+		return representation<long double>{x}.ordinal();
+	}
+
+#endif
+
+#if (__PROXIMAL_HAS_FLOAT128__)
+
+	inline __int128 __ordinal(__float128 x)
+	{
+		return representation<__float128>{x}.ordinal();
+	}
+
+#endif
+
+	/*
+	 *	The table shared by proximal_unordered_set and proximal_unordered_map.
+	 *	E is the element type, and key(e) its key.
+	 */
+	template<class T, int N, class E>
+	class __proximal_table
+	{
+	public:
+		static_assert(N >= 0 && N < fractional_digits<T>, "close keys must be at most 2^(N+1) positions apart");
+
+		using key_type = T;
+		using value_type = E;
+		using size_type = std::size_t;
+		using iterator = E*;
+		using const_iterator = const E*;
+
+		inline __proximal_table()
+		:
+		mask_{0},
+		shift_{64}
+		{}
+
+		inline iterator begin()
+		{
+			return elements_.data();
+		}
+
+		inline iterator end()
+		{
+			return elements_.data() + elements_.size();
+		}
+
+		inline const_iterator begin() const
+		{
+			return elements_.data();
+		}
+
+		inline const_iterator end() const
+		{
+			return elements_.data() + elements_.size();
+		}
+
+		inline size_type size() const
+		{
+			return elements_.size();
+		}
+
+		inline bool empty() const
+		{
+			return elements_.empty();
+		}
+
+		inline void clear()
+		{
+			elements_.clear();
+			std::fill(slots_.begin(), slots_.end(), slot{});
+		}
+
+		/*
+		 *	Make room for count elements without rehashing.
+		 */
+		inline void reserve(size_type count)
+		{
+			elements_.reserve(count);
+			if (2 * count > slots_.size())
+			{
+				_rehash(2 * count);
+			}
+		}
+
+		/*
+		 *	The stored element whose key is nearest to key among those close
+		 *	enough to it, or end().
+		 */
+		inline iterator find(T key)
+		{
+			return begin() + _find(key);
+		}
+
+		inline const_iterator find(T key) const
+		{
+			return begin() + _find(key);
+		}
+
+		inline bool contains(T key) const
+		{
+			return _find(key) != size();
+		}
+
+		/*
+		 *	Erase the element at pos, moving the last element into its place.
+		 */
+		inline void erase(const_iterator pos)
+		{
+			const std::size_t index = static_cast<std::size_t>(pos - begin());
+			const std::size_t last = size() - 1;
+			_unlink(index);
+			if (index != last)
+			{
+				_slot_of(last)->index = index;
+				elements_[index] = std::move(elements_[last]);
+			}
+			elements_.pop_back();
+		}
+
+		/*
+		 *	Erase the element found for key, if any. Returns the number of
+		 *	elements erased.
+		 */
+		inline size_type erase(T key)
+		{
+			std::size_t index = _find(key);
+			if (index == size())
+			{
+				return 0;
+			}
+			erase(begin() + index);
+			return 1;
+		}
+
+	protected:
+		using cell_type = decltype(__ordinal(std::declval<T>()));
+
+		static constexpr std::size_t npos = ~std::size_t{0};
+
+		struct slot
+		{
+			cell_type cell = 0;
+			std::size_t index = npos;
+		};
+
+		static inline const T& _key(const T& e)
+		{
+			return e;
+		}
+
+		template<class V>
+		static inline const T& _key(const std::pair<T, V>& e)
+		{
+			return e.first;
+		}
+
+		static inline std::uint64_t _fold(std::int64_t cell)
+		{
+			return static_cast<std::uint64_t>(cell);
+		}
+
+	#if defined(__SIZEOF_INT128__)
+
+		static inline std::uint64_t _fold(__int128 cell)
+		{
+			return static_cast<std::uint64_t>(cell) ^ (static_cast<std::uint64_t>(cell >> 64) * 0xC2B2AE3D27D4EB4FULL);
+		}
+
+	#endif
+
+		// only NaN is not close to itself
+		static inline bool _findable(T key)
+		{
+			return proximal<N>{}(key, key);
+		}
+
+		// Fibonacci hashing: the top bits of the product are well mixed
+		inline std::size_t _home(cell_type cell) const
+		{
+			return shift_ == 64 ? 0 : static_cast<std::size_t>((_fold(cell) * 0x9E3779B97F4A7C15ULL) >> shift_);
+		}
+
+		/*
+		 *	The index of the element nearest to key among those close enough
+		 *	to it, or size().
+		 */
+		inline std::size_t _find(T key) const
+		{
+			std::size_t found = size();
+			if (slots_.empty())
+			{
+				return found;
+			}
+			const cell_type position = __ordinal(key);
+			const cell_type cell = position >> (N + 2);
+			const cell_type neighbour = (position & ((cell_type{1} << (N + 2)) - 1)) < (cell_type{1} << (N + 1)) ? cell - 1 : cell + 1;
+			std::int64_t nearest = 0;
+			for (cell_type c : {cell, neighbour})
+			{
+				for (std::size_t i = _home(c); slots_[i].index != npos; i = (i + 1) & mask_)
+				{
+					if (slots_[i].cell != c)
+					{
+						continue;
+					}
+					const T& candidate = _key(elements_[slots_[i].index]);
+					if (!proximal<N>{}(candidate, key))
+					{
+						continue;
+					}
+					std::int64_t distance = ulp_distance(candidate, key);
+					distance = distance < 0 ? -distance : distance;
+					if (found == size() || distance < nearest || (distance == nearest && slots_[i].index < found))
+					{
+						found = slots_[i].index;
+						nearest = distance;
+					}
+				}
+			}
+			return found;
+		}
+
+		/*
+		 *	Append e, which must not be close to any stored key.
+		 */
+		inline std::size_t _append(E&& e)
+		{
+			if (2 * (size() + 1) > slots_.size())
+			{
+				_rehash(slots_.empty() ? 16 : 2 * slots_.size());
+			}
+			const cell_type cell = __ordinal(_key(e)) >> (N + 2);
+			std::size_t i = _home(cell);
+			while (slots_[i].index != npos)
+			{
+				i = (i + 1) & mask_;
+			}
+			slots_[i] = slot{cell, size()};
+			elements_.push_back(std::move(e));
+			return size() - 1;
+		}
+
+		inline slot* _slot_of(std::size_t index)
+		{
+			const cell_type cell = __ordinal(_key(elements_[index])) >> (N + 2);
+			std::size_t i = _home(cell);
+			while (slots_[i].index != index)
+			{
+				i = (i + 1) & mask_;
+			}
+			return &slots_[i];
+		}
+
+		/*
+		 *	Remove the slot of an element, shifting later slots of the probe
+		 *	sequence back into the hole, so that no tombstones are needed.
+		 */
+		inline void _unlink(std::size_t index)
+		{
+			std::size_t hole = static_cast<std::size_t>(_slot_of(index) - slots_.data());
+			for (std::size_t j = (hole + 1) & mask_; slots_[j].index != npos; j = (j + 1) & mask_)
+			{
+				// the slot at j may move back unless its home lies cyclically in (hole, j]
+				std::size_t home = _home(slots_[j].cell);
+				if (((j - home) & mask_) >= ((j - hole) & mask_))
+				{
+					slots_[hole] = slots_[j];
+					hole = j;
+				}
+			}
+			slots_[hole] = slot{};
+		}
+
+		inline void _rehash(std::size_t capacity)
+		{
+			std::size_t size = 16;
+			while (size < capacity)
+			{
+				size *= 2;
+			}
+			int bits = 0;
+			while ((std::size_t{1} << bits) < size)
+			{
+				++bits;
+			}
+			std::vector<slot> old(size);
+			old.swap(slots_);
+			mask_ = size - 1;
+			shift_ = 64 - bits;
+			for (const slot& s : old)
+			{
+				if (s.index != npos)
+				{
+					std::size_t i = _home(s.cell);
+					while (slots_[i].index != npos)
+					{
+						i = (i + 1) & mask_;
+					}
+					slots_[i] = s;
+				}
+			}
+		}
+
+		std::vector<E> elements_;
+		std::vector<slot> slots_;
+		std::size_t mask_;
+		int shift_;
+	};
+
+	/*
+	 *	A set of floating point values, none of which is close to another. The
+	 *	elements are read-only.
+	 */
+	template<class T, int N = 1>
+	class proximal_unordered_set : public __proximal_table<T, N, T>
+	{
+		using base = __proximal_table<T, N, T>;
+
+	public:
+		using typename base::const_iterator;
+
+		/*
+		 *	Insert key unless a stored key is close to it. Returns the element
+		 *	found or inserted, and whether key was inserted; for NaN, end()
+		 *	and false.
+		 */
+		inline std::pair<const_iterator, bool> insert(T key)
+		{
+			if (!this->_findable(key))
+			{
+				return {this->end(), false};
+			}
+			std::size_t index = this->_find(key);
+			if (index != this->size())
+			{
+				return {this->begin() + index, false};
+			}
+			index = this->_append(std::move(key));
+			return {this->begin() + index, true};
+		}
+
+		inline const_iterator begin() const
+		{
+			return base::begin();
+		}
+
+		inline const_iterator end() const
+		{
+			return base::end();
+		}
+
+		inline const_iterator find(T key) const
+		{
+			return base::find(key);
+		}
+	};
+
+	/*
+	 *	A map from floating point keys, none of which is close to another, to
+	 *	values of type V. Elements are std::pair<T, V>; their keys must not be
+	 *	modified through iterators.
+	 */
+	template<class T, class V, int N = 1>
+	class proximal_unordered_map : public __proximal_table<T, N, std::pair<T, V>>
+	{
+		using base = __proximal_table<T, N, std::pair<T, V>>;
+
+	public:
+		using mapped_type = V;
+		using typename base::iterator;
+
+		/*
+		 *	Insert a value for key unless a stored key is close to it, in which
+		 *	case nothing is constructed. Returns the element found or inserted,
+		 *	and whether it was inserted; for NaN, end() and false.
+		 */
+		template<class... A>
+		inline std::pair<iterator, bool> try_emplace(T key, A&&... args)
+		{
+			if (!this->_findable(key))
+			{
+				return {this->end(), false};
+			}
+			std::size_t index = this->_find(key);
+			if (index != this->size())
+			{
+				return {this->begin() + index, false};
+			}
+			index = this->_append(std::pair<T, V>(key, V(std::forward<A>(args)...)));
+			return {this->begin() + index, true};
+		}
+
+		inline std::pair<iterator, bool> insert(T key, const V& value)
+		{
+			return try_emplace(key, value);
+		}
+
+		/*
+		 *	The value of the stored key nearest to key, inserting a default
+		 *	value for key if none is close to it. key must not be NaN.
+		 */
+		inline V& operator[](T key)
+		{
+			assert(this->_findable(key));
+			return try_emplace(key).first->second;
+		}
+	};
+}
+
+#endif // guard_utils_proximal_unordered_h
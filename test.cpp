@@ -1,7 +1,17 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
+#include "proximal_doctest.h"
 #include "proximal.h"
+#include "proximal_parallel.h"
+#include "proximal_search.h"
+#include "proximal_unique.h"
+#include "proximal_geometry.h"
+#include "proximal_tensor.h"
+#include "proximal_unordered.h"
 #include <iostream>
+#include <vector>
+#include <array>
+#include <thread>
 
 using namespace utils;
 
@@ -39,6 +49,40 @@ print(const std::string& prefix, T value)
 
 };
 
+/*
+ *	One xorshift step over a 32- or 64-bit state, for test data drawn from
+ *	raw bit patterns. Returns the new state.
+ */
+template<class U>
+static U
+next_random(U& state)
+{
+	state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+	return state;
+}
+
+/*
+ *	Runs f() once with each SIMD level this machine supports selected, with
+ *	the level's name captured for failed checks, and then selects the
+ *	detected level again.
+ */
+template<class F>
+static void
+for_each_isa(F f)
+{
+	for (simd::isa level : {simd::isa::scalar, simd::isa::sse2, simd::isa::avx2, simd::isa::avx512})
+	{
+		if (simd::select(level) != level)
+		{
+			continue;
+		}
+		const char* isa_name = simd::isa_name(level);
+		CAPTURE(isa_name);
+		f();
+	}
+	simd::select(simd::detect());
+}
+
 TEST_CASE("proximal")
 {
 	SUBCASE("float (1, 1+1ulp) 1ulp pass")
@@ -159,3 +203,1752 @@ TEST_CASE("proximal")
 	}
 }
 
+
+/*
+ *	Reference comparison built only from the standard library, used to check
+ *	the bitwise engines against the definition in the README.
+ */
+template<int N, class T>
+static bool
+reference_close_enough(T a, T b)
+{
+	if (a == b)
+	{
+		return true;
+	}
+	if (!std::isfinite(a) || !std::isfinite(b))
+	{
+		return false;
+	}
+	T x = std::max(std::abs(a), std::abs(b));
+	int exp = std::max(std::ilogb(x) - fractional_precision<T, N>, exponent_limit<T, N>);
+	return std::abs(a - b) <= std::ldexp(static_cast<T>(1), exp);
+}
+
+template<int N, class T, class U>
+static void
+check_integer_domain(U seed, int count)
+{
+	// xorshift over raw bit patterns, so denormals, infinities and NaNs all show up
+	U state = seed;
+	for (int i = 0; i < count; ++i)
+	{
+		next_random(state);
+		T a = representation<T>{state}.value();
+		U delta = (state >> 5) & 0xF;
+		T b = representation<T>{static_cast<U>(state + delta)}.value();
+		if (state & 0x100)
+		{
+			b = -b;
+		}
+		REQUIRE(representation<T>::within_margin(a, b, N) == reference_close_enough<N>(a, b));
+	}
+}
+
+TEST_CASE("integer domain comparison")
+{
+	SUBCASE("special values")
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		const float den = std::numeric_limits<float>::denorm_min();
+		CHECK(representation<float>::within_margin(0.0f, -0.0f, 0));
+		CHECK(representation<float>::within_margin(inf, inf, 0));
+		CHECK(representation<float>::within_margin(-inf, -inf, 0));
+		CHECK(!representation<float>::within_margin(inf, -inf, 0));
+		CHECK(!representation<float>::within_margin(inf, std::numeric_limits<float>::max(), 30));
+		CHECK(!representation<float>::within_margin(nan, nan, 0));
+		CHECK(!representation<float>::within_margin(nan, 1.0f, 0));
+		CHECK(representation<float>::within_margin(den, -den, 1));
+		CHECK(!representation<float>::within_margin(den, -den, 0));
+		CHECK(representation<double>::within_margin(0.0, -0.0, 0));
+		CHECK(!representation<double>::within_margin(std::nan(""), 0.0, 4));
+		CHECK(!representation<float>::within_margin(1e-44f, 2e-44f, -30));
+		CHECK(representation<float>::within_margin(den, den, -30));
+		CHECK(!representation<double>::within_margin(1e-320, 2e-320, -60));
+		CHECK(!representation<double>::within_margin(1.0, std::nextafter(1.0, 2.0), -1));
+	}
+
+	SUBCASE("agrees with the reference definition")
+	{
+		check_integer_domain<0, float>(std::uint32_t{0x9E3779B9}, 200000);
+		check_integer_domain<3, float>(std::uint32_t{0x12345678}, 200000);
+		check_integer_domain<0, double>(std::uint64_t{0x9E3779B97F4A7C15}, 200000);
+		check_integer_domain<5, double>(std::uint64_t{0x0123456789ABCDEF}, 200000);
+		// negative n: margins of denormal operands are 0
+		check_integer_domain<-1, float>(std::uint32_t{0x2545F491}, 200000);
+		check_integer_domain<-30, float>(std::uint32_t{0x6C078965}, 200000);
+		check_integer_domain<-1, double>(std::uint64_t{0x2545F4914F6CDD1D}, 200000);
+		check_integer_domain<-60, double>(std::uint64_t{0x5851F42D4C957F2D}, 200000);
+	}
+}
+
+/*
+ *	Pairs of arrays that are close enough element by element, with special
+ *	values mixed in, so that single elements can be perturbed to fail.
+ */
+template<class T, class U>
+static void
+fill_close_pairs(std::vector<T>& a, std::vector<T>& b, U seed)
+{
+	U state = seed;
+	for (std::size_t i = 0; i < a.size(); ++i)
+	{
+		next_random(state);
+		T x = representation<T>{static_cast<U>(state >> 2)}.value();
+		if (!std::isfinite(x) || i % 97 == 0)
+		{
+			x = static_cast<T>(i % 3 == 0 ? 0.0 : i % 3 == 1 ? -0.0 : std::numeric_limits<T>::denorm_min());
+		}
+		if (i % 61 == 0)
+		{
+			x = std::numeric_limits<T>::infinity();
+		}
+		a[i] = (state & 1) ? -x : x;
+		b[i] = a[i];
+	}
+}
+
+template<class T, class U>
+static void
+check_all_close(U seed)
+{
+	proximal<1> close_enough;
+	std::vector<T> a(1000), b(1000);
+	fill_close_pairs(a, b, seed);
+	for_each_isa([&]()
+	{
+		for (std::size_t count : {0, 1, 3, 17, 64, 999, 1000})
+		{
+			CHECK(close_enough.all_close(a.data(), b.data(), count));
+		}
+		for (std::size_t i : {0, 5, 130, 998, 999})
+		{
+			T saved = b[i];
+			b[i] = std::nextafter(std::nextafter(std::nextafter(b[i], std::numeric_limits<T>::max()), std::numeric_limits<T>::max()), std::numeric_limits<T>::max());
+			bool expected = close_enough(a[i], b[i]);
+			CHECK(close_enough.all_close(a.data(), b.data(), a.size()) == expected);
+			CHECK(close_enough.all_close(a.data(), b.data(), i));
+			b[i] = std::numeric_limits<T>::quiet_NaN();
+			CHECK(!close_enough.all_close(a.data(), b.data(), a.size()));
+			b[i] = saved;
+		}
+	});
+}
+
+TEST_CASE("batch all_close")
+{
+	check_all_close<float>(std::uint32_t{0x2545F491});
+	check_all_close<double>(std::uint64_t{0x2545F4914F6CDD1D});
+
+	proximal<0> exact;
+	const float inf = std::numeric_limits<float>::infinity();
+	float a[] = {1.0f, -0.0f, inf, -inf, 1e-40f};
+	float b[] = {1.0f, 0.0f, inf, -inf, 1e-40f};
+	CHECK(exact.all_close(a, b, 5));
+	b[3] = inf;
+	CHECK(!exact.all_close(a, b, 5));
+}
+
+template<class T, class U>
+static void
+check_mismatches(U seed)
+{
+	proximal<1> close_enough;
+	std::vector<T> a(1000), b(1000);
+	fill_close_pairs(a, b, seed);
+	for (std::size_t i = 0; i < b.size(); i += 1 + i % 7)
+	{
+		b[i] = std::nextafter(b[i], std::numeric_limits<T>::max());
+		if (i % 5 == 0)
+		{
+			b[i] = std::nextafter(std::nextafter(b[i], std::numeric_limits<T>::max()), std::numeric_limits<T>::max());
+		}
+	}
+	for_each_isa([&]()
+	{
+		for (std::size_t count : {0, 1, 63, 64, 65, 200, 1000})
+		{
+			std::vector<std::uint64_t> mask((count + 63) / 64 + 1, ~std::uint64_t{0});
+			std::size_t expected = 0;
+			std::size_t total = close_enough.mismatches(a.data(), b.data(), count, mask.data());
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				bool bit = (mask[i / 64] >> (i % 64)) & 1;
+				CHECK(bit == !close_enough(a[i], b[i]));
+				expected += bit;
+			}
+			CHECK(total == expected);
+			if (count % 64 != 0)
+			{
+				CHECK((mask[count / 64] >> (count % 64)) == 0);
+			}
+			CHECK(mask[(count + 63) / 64] == ~std::uint64_t{0});
+		}
+	});
+}
+
+TEST_CASE("batch mismatches")
+{
+	check_mismatches<float>(std::uint32_t{0x6C8E9CF5});
+	check_mismatches<double>(std::uint64_t{0x6C8E9CF570932BD5});
+}
+
+template<int N, class T, class U>
+static void
+check_dynamic(U seed)
+{
+	proximal<N> fixed;
+	proximal_dynamic dynamic{N};
+	std::vector<T> a(500), b(500);
+	fill_close_pairs(a, b, seed);
+	for (std::size_t i = 0; i < a.size(); ++i)
+	{
+		for (int k = 0; k < static_cast<int>(i % 9); ++k)
+		{
+			b[i] = std::nextafter(b[i], std::numeric_limits<T>::max());
+		}
+		CHECK(dynamic(a[i], b[i]) == fixed(a[i], b[i]));
+		CHECK(dynamic.margin(a[i]) == fixed.margin(a[i]));
+		CHECK(dynamic.ulp(a[i]) == fixed.ulp(a[i]));
+	}
+	std::vector<std::uint64_t> fixed_mask(8), dynamic_mask(8);
+	CHECK(dynamic.mismatches(a.data(), b.data(), a.size(), dynamic_mask.data()) == fixed.mismatches(a.data(), b.data(), a.size(), fixed_mask.data()));
+	CHECK(dynamic_mask == fixed_mask);
+	CHECK(dynamic.all_close(a.data(), b.data(), a.size()) == fixed.all_close(a.data(), b.data(), a.size()));
+}
+
+TEST_CASE("proximal_dynamic")
+{
+	check_dynamic<0, float>(std::uint32_t{0x0BADBEEF});
+	check_dynamic<2, float>(std::uint32_t{0x1BADBEEF});
+	check_dynamic<1, double>(std::uint64_t{0x0BADBEEF0BADBEEF});
+	check_dynamic<3, double>(std::uint64_t{0x2BADBEEF0BADBEEF});
+
+	proximal<2> fixed;
+	proximal_dynamic dynamic{2};
+	long double one = 1.0L;
+	long double near = std::nextafter(std::nextafter(one, 2.0L), 2.0L);
+	CHECK(dynamic(one, near) == fixed(one, near));
+	CHECK(dynamic.margin(one) == fixed.margin(one));
+	CHECK(dynamic.n() == 2);
+
+	// any int is accepted: n is clamped where the margins have saturated
+	proximal<-30> small;
+	proximal_dynamic negative{-30};
+	CHECK(negative(1e-44f, 2e-44f) == small(1e-44f, 2e-44f));
+	CHECK(negative.margin(1.0) == small.margin(1.0));
+	proximal_dynamic lowest{std::numeric_limits<int>::min()};
+	proximal_dynamic highest{std::numeric_limits<int>::max()};
+	CHECK(lowest.n() == -proximal_dynamic::max_n());
+	CHECK(highest.n() == proximal_dynamic::max_n());
+	const double x[] = {1.0, 0.0, std::numeric_limits<double>::denorm_min()};
+	const double y[] = {std::nextafter(1.0, 2.0), std::numeric_limits<double>::denorm_min(), 0.0};
+	CHECK(lowest.margin(std::numeric_limits<double>::max()) == 0.0);
+	CHECK(!lowest(x[0], y[0]));
+	std::uint64_t mask = 0;
+	CHECK(lowest.mismatches(x, y, 3, &mask) == 3);
+	CHECK(highest.margin(1.0f) == std::numeric_limits<float>::infinity());
+	CHECK(highest.margin(1.0L) == std::numeric_limits<long double>::infinity());
+	CHECK(highest.all_close(x, y, 3));
+}
+
+#if (__PROXIMAL_HAS_CONSTEXPR__)
+
+/*
+ *	A tolerance table computed at compile time: the margin at 1.0 for N = 0..3.
+ */
+template<int... N>
+static constexpr std::array<double, sizeof...(N)> margin_table = {margin<N>(1.0)...};
+
+static_assert(ulp(1.0f) == 0x1p-23f);
+static_assert(ulp(1.0) == 0x1p-52);
+static_assert(ulp(0.0f) == std::numeric_limits<float>::denorm_min());
+static_assert(ulp(std::numeric_limits<float>::infinity()) == 0.0f);
+static_assert(margin<2>(3.0) == 0x1p-49);
+static_assert(margin<0>(std::numeric_limits<double>::denorm_min()) == std::numeric_limits<double>::denorm_min());
+static_assert(ilog2(std::numeric_limits<double>::denorm_min()) == -1074);
+static_assert(ilog2(std::numeric_limits<float>::min() / 8) == -129);
+static_assert(exp2i<double>(-1070) == 0x1p-1070);
+static_assert(ulp(1.0L) == 0x1p-63L);
+static_assert(ilog2(std::numeric_limits<long double>::denorm_min()) == -16445);
+static_assert(margin_table<0, 1, 2, 3>[3] == 0x1p-49);
+static_assert(representation<float>{1.5f}.significand() == 0x00400000);
+static_assert(proximal<1>{}(0.1, 1.0 - 0.9));
+static_assert(!proximal<1>{}(0.1f, 1.0f - 0.9f));
+static_assert(proximal<2>{}(0.1f, 1.0f - 0.9f));
+static_assert(!proximal<0>{}(1.0f, 1.0f + 2 * 0x1p-23f));
+static_assert(ulp_distance(1.0, 1.0 + 0x1p-52) == 1);
+static_assert(ulp_distance(-0.0f, 0.0f) == 0);
+static_assert(ulp_distance(-std::numeric_limits<float>::denorm_min(), 1.0f) == 0x3F800001);
+static_assert(ulp_distance(2.0L, 1.0L + 0x1p-63L) == std::numeric_limits<std::int64_t>::min() + 1);
+static_assert(proximal<0>{}(0.0, -0.0));
+static_assert(!proximal<4>{}(std::numeric_limits<double>::quiet_NaN(), 0.0));
+static_assert(proximal<1>{}(1.0L, 1.0L + 0x1p-62L));
+static_assert(proximal<2>{}.margin(1.0) == 0x1p-50);
+static_assert(proximal_dynamic{2}(1.0, 1.0 + 0x1p-50));
+static_assert(!proximal_dynamic{2}(1.0, 1.0 + 0x1p-49 + 0x1p-52));
+static_assert(proximal<0>{}(static_cast<half>(1.0f), static_cast<half>(1.0f + 0x1p-10f)));
+static_assert(!proximal<0>{}(static_cast<half>(1.0f), static_cast<half>(1.0f + 0x1p-9f)));
+static_assert(ulp_distance(static_cast<half>(1.0f), static_cast<half>(2.0f)) == 1024);
+static_assert(static_cast<float>(ulp(static_cast<half>(0.0f))) == 0x1p-24f);
+static_assert(proximal<0>{}(bfloat16(1.0f), bfloat16(1.0f + 0x1p-7f)));
+static_assert(!proximal<0>{}(bfloat16(1.0f), bfloat16(1.0f + 0x1p-6f)));
+static_assert(ulp_distance(bfloat16(1.0f), bfloat16(2.0f)) == 128);
+static_assert(static_cast<float>(ulp(bfloat16(0.0f))) == 0x1p-133f);
+#if (__PROXIMAL_HAS_FLOAT128__)
+static_assert(proximal<0>{}(static_cast<__float128>(1.0), 1 + exp2i<__float128>(-112)));
+static_assert(!proximal<0>{}(static_cast<__float128>(1.0), 1 + exp2i<__float128>(-111)));
+static_assert(ilog2(exp2i<__float128>(-16494)) == -16494);
+static_assert(ulp_distance(static_cast<__float128>(1.0), 1 + exp2i<__float128>(-100)) == 4096);
+#endif
+
+#endif
+
+template<class T, class U>
+static void
+check_array_margins(U seed)
+{
+	std::vector<T> x(1000), result(1000), expected(1000);
+	U state = seed;
+	for (auto& v : x)
+	{
+		next_random(state);
+		v = representation<T>{state}.value();
+	}
+	x[0] = 0.0; x[1] = -0.0; x[2] = std::numeric_limits<T>::infinity(); x[3] = std::numeric_limits<T>::quiet_NaN();
+	x[4] = std::numeric_limits<T>::denorm_min(); x[5] = -std::numeric_limits<T>::min(); x[6] = std::numeric_limits<T>::max();
+	for_each_isa([&]()
+	{
+		for (std::size_t count : {0, 1, 7, 999, 1000})
+		{
+			std::fill(result.begin(), result.end(), static_cast<T>(-1));
+			ulp(x.data(), result.data(), count);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				REQUIRE(result[i] == ulp(x[i]));
+			}
+			CHECK((count == x.size() || result[count] == -1));
+			margin<3>(x.data(), result.data(), count);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				REQUIRE(result[i] == margin<3>(x[i]));
+			}
+		}
+	});
+}
+
+TEST_CASE("array ulp and margin")
+{
+	check_array_margins<float>(std::uint32_t{0x3C6EF372});
+	check_array_margins<double>(std::uint64_t{0x3C6EF372FE94F82B});
+
+	long double x[] = {1.0L, -0.0L, std::numeric_limits<long double>::infinity()};
+	long double result[3];
+	margin<1>(x, result, 3);
+	CHECK(result[0] == margin<1>(1.0L));
+	CHECK(result[1] == margin<1>(-0.0L));
+	CHECK(result[2] == 0.0L);
+}
+
+template<class T, class U>
+static void
+check_parallel(U seed)
+{
+	proximal<1> close_enough;
+	proximal_dynamic dynamic{1};
+	std::vector<T> a(100003), b(100003);
+	fill_close_pairs(a, b, seed);
+	parallel::pool workers{4};
+	parallel::pool pinned{3, true};
+	for (parallel::pool* p : {&workers, &pinned})
+	{
+		parallel::options opts;
+		opts.chunk_bytes = 4096;
+		opts.workers = p;
+		CHECK(parallel::all_close(close_enough, a.data(), b.data(), a.size(), opts));
+		CHECK(parallel::all_close(dynamic, a.data(), b.data(), a.size(), opts));
+		for (std::size_t i : {0, 777, 50000, 100002})
+		{
+			T saved = b[i];
+			b[i] = std::numeric_limits<T>::quiet_NaN();
+			CHECK(!parallel::all_close(close_enough, a.data(), b.data(), a.size(), opts));
+			CHECK(!parallel::all_close(dynamic, a.data(), b.data(), a.size(), opts));
+			CHECK(parallel::all_close(close_enough, a.data(), b.data(), i, opts));
+			b[i] = saved;
+		}
+
+		std::vector<T> c = b;
+		for (std::size_t i = 0; i < c.size(); i += 1 + i % 11)
+		{
+			c[i] = std::nextafter(std::nextafter(std::nextafter(c[i], std::numeric_limits<T>::max()), std::numeric_limits<T>::max()), std::numeric_limits<T>::max());
+		}
+		for (std::size_t count : {0, 100, 4096, 100003})
+		{
+			std::vector<std::uint64_t> expected((count + 63) / 64), mask((count + 63) / 64);
+			std::size_t total = close_enough.mismatches(a.data(), c.data(), count, expected.data());
+			CHECK(parallel::mismatches(close_enough, a.data(), c.data(), count, mask.data(), opts) == total);
+			CHECK(mask == expected);
+		}
+	}
+	CHECK(parallel::all_close(close_enough, a.data(), b.data(), a.size()));
+}
+
+template<class T, class U>
+static void
+check_stats(U seed)
+{
+	proximal<1> close_enough;
+	proximal_dynamic dynamic{1};
+	std::vector<T> a(1000), b(1000);
+	fill_close_pairs(a, b, seed);
+	for (std::size_t i = 0; i < b.size(); i += 1 + i % 13)
+	{
+		b[i] = std::nextafter(b[i], std::numeric_limits<T>::max());
+		if (i % 3 == 0)
+		{
+			b[i] = std::nextafter(std::nextafter(b[i], std::numeric_limits<T>::max()), std::numeric_limits<T>::max());
+		}
+	}
+	b[123] = std::numeric_limits<T>::quiet_NaN();
+	for_each_isa([&]()
+	{
+		for (std::size_t count : {0, 1, 17, 123, 124, 1000})
+		{
+			proximal_stats<T> expected;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				expected.add(i, a[i], b[i], close_enough(a[i], b[i]));
+			}
+			proximal_stats<T> s = close_enough.stats(a.data(), b.data(), count);
+			CHECK(s.count == count);
+			CHECK(s.mismatches == expected.mismatches);
+			CHECK(s.first_mismatch == expected.first_mismatch);
+			CHECK(s.max_error == expected.max_error);
+			CHECK(s.max_ulps == expected.max_ulps);
+			CHECK(s.worst == expected.worst);
+			CHECK(dynamic.stats(a.data(), b.data(), count).worst == expected.worst);
+
+			std::size_t half = count / 2;
+			proximal_stats<T> merged = close_enough.stats(a.data() + half, b.data() + half, count - half, half);
+			merged.merge(close_enough.stats(a.data(), b.data(), half));
+			CHECK(merged.mismatches == expected.mismatches);
+			CHECK(merged.first_mismatch == expected.first_mismatch);
+			CHECK(merged.max_ulps == expected.max_ulps);
+			CHECK(merged.worst == expected.worst);
+		}
+	});
+
+	parallel::options opts;
+	opts.chunk_bytes = 1024;
+	proximal_stats<T> s = parallel::stats(close_enough, a.data(), b.data(), a.size(), opts);
+	proximal_stats<T> expected = close_enough.stats(a.data(), b.data(), a.size());
+	CHECK(s.count == a.size());
+	CHECK(s.mismatches == expected.mismatches);
+	CHECK(s.first_mismatch == expected.first_mismatch);
+	CHECK(s.max_error == expected.max_error);
+	CHECK(s.worst == expected.worst);
+	CHECK(close_enough.stats(a.data() + 100, b.data() + 100, 100, 100).worst == 123);
+}
+
+TEST_CASE("batch stats")
+{
+	check_stats<float>(std::uint32_t{0x1B873593});
+	check_stats<double>(std::uint64_t{0x1B873593CC9E2D51});
+
+	proximal<0> exact;
+	long double a[] = {1.0L, 2.0L, 4.0L, 8.0L};
+	long double b[] = {1.0L, 2.0L + 0x1p-61L, 4.0L, 8.0L + 0x1p-57L};
+	proximal_stats<long double> s = exact.stats(a, b, 4);
+	CHECK(s.mismatches == 2);
+	CHECK(s.first_mismatch == 1);
+	CHECK(s.max_error == 0x1p-57L);
+	CHECK(s.max_ulps == 8.0L);
+	CHECK(s.worst == 3);
+	CHECK(exact.stats(a, a, 4).worst == proximal_stats<long double>::npos);
+}
+
+template<class T>
+static T
+step_ulps(T x, int n)
+{
+	for (int i = 0; i < std::abs(n); ++i)
+	{
+		x = std::nextafter(x, n < 0 ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity());
+	}
+	return x;
+}
+
+template<class T, class U>
+static void
+check_ulp_distance(U seed)
+{
+	const T inf = std::numeric_limits<T>::infinity();
+	const T denorm = std::numeric_limits<T>::denorm_min();
+	const T min = std::numeric_limits<T>::min();
+	const T max = std::numeric_limits<T>::max();
+	const std::int64_t saturated = std::numeric_limits<std::int64_t>::max();
+
+	CHECK(ulp_distance(T(1), step_ulps(T(1), 1)) == 1);
+	CHECK(ulp_distance(step_ulps(T(1), 1), T(1)) == -1);
+	CHECK(ulp_distance(T(-0.0), T(0.0)) == 0);
+	CHECK(ulp_distance(T(0.0), denorm) == 1);
+	CHECK(ulp_distance(-denorm, denorm) == 2);
+	CHECK(ulp_distance(step_ulps(min, -1), min) == 1);
+	CHECK(ulp_distance(max, inf) == 1);
+	CHECK(ulp_distance(-inf, -max) == 1);
+	CHECK(ulp_distance(T(1), T(2)) == (std::int64_t{1} << fractional_digits<T>));
+	CHECK(ulp_distance(T(-1), T(1)) > 0);
+	CHECK(ulp_distance(std::numeric_limits<T>::quiet_NaN(), T(1)) == saturated);
+	CHECK(ulp_distance(T(1), std::numeric_limits<T>::quiet_NaN()) == saturated);
+
+	U state = seed;
+	for (int i = 0; i < 2000; ++i)
+	{
+		next_random(state);
+		T x = representation<T>{static_cast<U>(state >> 2)}.value();
+		if (!std::isfinite(x))
+		{
+			continue;
+		}
+		x = (state & 1) ? -x : x;
+		if (i % 4 == 0)
+		{
+			x *= std::numeric_limits<T>::epsilon() * min;
+		}
+		int n = static_cast<int>(state >> 3) % 41 - 20;
+		T y = step_ulps(x, n);
+		CAPTURE(x);
+		CAPTURE(n);
+		CHECK(ulp_distance(x, y) == n);
+		CHECK(ulp_distance(y, x) == -n);
+		CHECK(__generic_ulp_distance(x, y) == n);
+		CHECK(__generic_ulp_distance(y, x) == -n);
+	}
+}
+
+TEST_CASE("ulp distance")
+{
+	check_ulp_distance<float>(std::uint32_t{0x68E31DA4});
+	check_ulp_distance<double>(std::uint64_t{0x68E31DA4B5297A4D});
+
+	const double inf = std::numeric_limits<double>::infinity();
+	CHECK(ulp_distance(-inf, inf) == std::numeric_limits<std::int64_t>::max());
+	CHECK(ulp_distance(inf, -inf) == std::numeric_limits<std::int64_t>::min());
+	CHECK(ulp_distance(-std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()) == 2 * std::int64_t{0x7F800000});
+
+	const long double one = 1.0L;
+	const long double denorm = std::numeric_limits<long double>::denorm_min();
+	CHECK(ulp_distance(one, step_ulps(one, 5)) == 5);
+	CHECK(ulp_distance(-one, step_ulps(-one, 3)) == 3);
+	CHECK(ulp_distance(-denorm, 2 * denorm) == 3);
+	CHECK(ulp_distance(step_ulps(std::numeric_limits<long double>::min(), -2), std::numeric_limits<long double>::min()) == 2);
+	CHECK(ulp_distance(std::numeric_limits<long double>::max(), std::numeric_limits<long double>::infinity()) == 1);
+	CHECK(ulp_distance(1.0L, 1.5L) == std::int64_t{1} << 62);
+	CHECK(ulp_distance(1.0L, 2.0L) == std::numeric_limits<std::int64_t>::max());
+	CHECK(ulp_distance(-one, one) == std::numeric_limits<std::int64_t>::max());
+	CHECK(ulp_distance(one, -one) == std::numeric_limits<std::int64_t>::min());
+	CHECK(__generic_ulp_distance(one, step_ulps(one, 5)) == 5);
+	CHECK(__generic_ulp_distance(-denorm, 2 * denorm) == 3);
+	CHECK(__generic_ulp_distance(1.0L, 1.5L) == std::int64_t{1} << 62);
+	CHECK(__generic_ulp_distance(-one, one) == std::numeric_limits<std::int64_t>::max());
+	CHECK(__generic_ulp_distance(-inf, inf) == std::numeric_limits<std::int64_t>::max());
+	CHECK(__generic_ulp_distance(std::numeric_limits<double>::max(), inf) == 1);
+}
+
+TEST_CASE("ulp histogram")
+{
+	ulp_histogram h;
+	CHECK(ulp_histogram::bucket(0) == 0);
+	CHECK(ulp_histogram::bucket(1) == 1);
+	CHECK(ulp_histogram::bucket(-1) == 1);
+	CHECK(ulp_histogram::bucket(2) == 2);
+	CHECK(ulp_histogram::bucket(3) == 2);
+	CHECK(ulp_histogram::bucket(4) == 3);
+	CHECK(ulp_histogram::bucket(std::numeric_limits<std::int64_t>::max()) == 63);
+	CHECK(ulp_histogram::bucket(std::numeric_limits<std::int64_t>::min()) == 64);
+	CHECK(ulp_histogram::bucket(1.0, std::numeric_limits<double>::quiet_NaN()) == int(ulp_histogram::nan_bucket));
+	CHECK(ulp_histogram::bucket_limit(0) == 0);
+	CHECK(ulp_histogram::bucket_limit(3) == 7);
+
+	std::vector<double> a(1000), b(1000);
+	for (std::size_t i = 0; i < a.size(); ++i)
+	{
+		a[i] = 1.0 + static_cast<double>(i) / 1000;
+		b[i] = step_ulps(a[i], i < 900 ? 0 : i < 990 ? 3 : 100);
+	}
+	b[999] = std::numeric_limits<double>::quiet_NaN();
+	h.add(a.data(), b.data(), a.size());
+	CHECK(h.total() == 1000);
+	CHECK(h.count(0) == 900);
+	CHECK(h.count(2) == 90);
+	CHECK(h.count(7) == 9);
+	CHECK(h.count(ulp_histogram::nan_bucket) == 1);
+	CHECK(h.quantile_bucket(0.9) == 0);
+	CHECK(h.quantile_bucket(0.95) == 2);
+	CHECK(h.quantile_bucket(0.999) == 7);
+	CHECK(h.quantile_bucket(1.0) == int(ulp_histogram::nan_bucket));
+
+	ulp_histogram shared;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&]
+		{
+			ulp_histogram::accumulator local{shared};
+			for (int r = 0; r < 25; ++r)
+			{
+				local.add(a.data(), b.data(), a.size());
+			}
+			shared.add(1.0f, 1.0f);
+		});
+	}
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+	CHECK(shared.total() == 4 * (25 * 1000 + 1));
+	CHECK(shared.count(7) == 4 * 25 * 9);
+	h.merge(shared);
+	CHECK(h.count(0) == 900 + 4 * (25 * 900 + 1));
+	h.reset();
+	CHECK(h.total() == 0);
+}
+
+TEST_CASE("parallel batch comparison")
+{
+	check_parallel<float>(std::uint32_t{0x7F4A7C15});
+	check_parallel<double>(std::uint64_t{0x9E3779B97F4A7C15});
+}
+
+TEST_CASE("denormal ilog2")
+{
+	SUBCASE("every float denormal")
+	{
+		bool agree = true;
+		for (std::uint32_t sig = 1; sig < 0x00800000; ++sig)
+		{
+			float x = representation<float>{sig}.value();
+			agree &= ilog2(x) == std::ilogb(x);
+			agree &= ilog2(-x) == std::ilogb(-x);
+		}
+		CHECK(agree);
+	}
+
+	SUBCASE("double denormals at every leading bit")
+	{
+		std::uint64_t state = 0x853C49E6748FEA9B;
+		for (int bit = 0; bit < 52; ++bit)
+		{
+			for (int k = 0; k < 64; ++k)
+			{
+				next_random(state);
+				std::uint64_t sig = (std::uint64_t{1} << bit) | (state & ((std::uint64_t{1} << bit) - 1));
+				double x = representation<double>{sig}.value();
+				REQUIRE(ilog2(x) == std::ilogb(x));
+			}
+		}
+	}
+
+	SUBCASE("long double denormals at every leading bit")
+	{
+		for (int bit = 0; bit < 63; ++bit)
+		{
+			long double x = representation<long double>{min_explicit_exponent<long double>, std::uint64_t{1} << bit}.value();
+			REQUIRE(ilog2(x) == std::ilogb(x));
+		}
+	}
+
+	SUBCASE("leading zero counts")
+	{
+		CHECK(count_leading_zeros(std::uint32_t{0}) == 32);
+		CHECK(count_leading_zeros(std::uint32_t{1}) == 31);
+		CHECK(count_leading_zeros(std::uint64_t{0}) == 64);
+		CHECK(count_leading_zeros(std::uint64_t{1}) == 63);
+		CHECK(count_leading_zeros(std::uint64_t{1} << 40) == 23);
+		CHECK(count_leading_zeros(~std::uint64_t{0}) == 0);
+	}
+}
+
+template<int N, class T, class U>
+static bool
+table_margins_agree(int exponent_bits, int fractional_digits)
+{
+	bool agree = true;
+	for (U e = 0; e < (U{1} << exponent_bits); ++e)
+	{
+		for (U sig : {U{0}, U{1}, (U{1} << fractional_digits) - 1})
+		{
+			for (U sign : {U{0}, U{1} << (exponent_bits + fractional_digits)})
+			{
+				T x = __bit_cast<T>(sign | (e << fractional_digits) | sig);
+				T table = margin<N>(x);
+				T computed = margin<N, T>(x);
+				agree &= __bit_cast<U>(table) == __bit_cast<U>(computed);
+				agree &= __bit_cast<U>(proximal<N>{}.margin(x)) == __bit_cast<U>(computed);
+			}
+		}
+	}
+	return agree;
+}
+
+TEST_CASE("exponent tables")
+{
+	CHECK(table_margins_agree<0, float, std::uint32_t>(8, 23));
+	CHECK(table_margins_agree<1, float, std::uint32_t>(8, 23));
+	CHECK(table_margins_agree<10, float, std::uint32_t>(8, 23));
+	CHECK(table_margins_agree<23, float, std::uint32_t>(8, 23));
+	CHECK(table_margins_agree<0, double, std::uint64_t>(11, 52));
+	CHECK(table_margins_agree<1, double, std::uint64_t>(11, 52));
+	CHECK(table_margins_agree<26, double, std::uint64_t>(11, 52));
+	CHECK(table_margins_agree<52, double, std::uint64_t>(11, 52));
+	// negative N: margins below the smallest denormal are 0
+	CHECK(table_margins_agree<-1, float, std::uint32_t>(8, 23));
+	CHECK(table_margins_agree<-30, float, std::uint32_t>(8, 23));
+	CHECK(table_margins_agree<-1, double, std::uint64_t>(11, 52));
+	CHECK(table_margins_agree<-60, double, std::uint64_t>(11, 52));
+	CHECK(margin<-1>(1.0f) == std::ldexp(1.0f, -24));
+	CHECK(margin<-1>(1.0) == std::ldexp(1.0, -53));
+	CHECK(margin<-1>(std::numeric_limits<float>::denorm_min()) == 0.0f);
+	CHECK(margin<-30>(std::numeric_limits<float>::min()) == 0.0f);
+	CHECK(margin<-30>(1.0f) == std::ldexp(1.0f, -53));
+
+	CHECK(ulp(1.0f) == std::numeric_limits<float>::epsilon());
+	CHECK(ulp(1.0) == std::numeric_limits<double>::epsilon());
+	CHECK(ulp(0.0) == std::numeric_limits<double>::denorm_min());
+	CHECK(ulp(-std::numeric_limits<float>::infinity()) == 0.0f);
+	CHECK(proximal<0>{}.ulp(std::nan("")) == 0.0);
+
+#if (__USE_EXPONENT_TABLES__)
+	// margins past the range of the type are infinite
+	const float max = std::numeric_limits<float>::max();
+	CHECK(proximal<30>{}.margin(max) == std::numeric_limits<float>::infinity());
+	CHECK(proximal<30>{}(max, std::nextafter(max, 0.0f)));
+	CHECK(margin<30>(-max) == std::numeric_limits<float>::infinity());
+	CHECK(margin<30>(0.5f) == std::ldexp(1.0f, 6));
+	CHECK(proximal<60>{}.margin(std::numeric_limits<double>::max()) == std::numeric_limits<double>::infinity());
+	CHECK(margin<60>(1.0) == std::ldexp(1.0, 8));
+#endif
+}
+
+static half
+half_bits(std::uint16_t u)
+{
+	return representation<half>{u}.value();
+}
+
+TEST_CASE("half precision")
+{
+	SUBCASE("every half value")
+	{
+		bool agree = true;
+		for (std::uint32_t u = 0; u < 0x10000; ++u)
+		{
+			half h = half_bits(static_cast<std::uint16_t>(u));
+			float x = static_cast<float>(h);
+			agree &= std::isnan(x) ? std::isnan(__half_bits_to_float(static_cast<std::uint16_t>(u)))
+				: __half_bits_to_float(static_cast<std::uint16_t>(u)) == x && __float_to_half_bits(x) == u;
+			if (std::isfinite(x) && x != 0)
+			{
+				agree &= ilog2(h) == std::ilogb(x);
+				agree &= static_cast<float>(ulp(h)) == std::ldexp(1.0f, std::max(std::ilogb(x) - 10, -24));
+			}
+			if ((u & 0x7FFF) < 0x7C00)
+			{
+				std::uint32_t next = u == 0x8000 ? 0x0001 : (u & 0x8000) ? u - 1 : u + 1;
+				agree &= ulp_distance(h, half_bits(static_cast<std::uint16_t>(next))) == 1;
+			}
+		}
+		CHECK(agree);
+	}
+
+	SUBCASE("rounding from float")
+	{
+		CHECK(static_cast<float>(static_cast<half>(65519.0f)) == 65504.0f);
+		CHECK(std::isinf(static_cast<float>(static_cast<half>(65520.0f))));
+		CHECK(static_cast<float>(static_cast<half>(0x1p-25f)) == 0.0f);
+		CHECK(static_cast<float>(static_cast<half>(0x1.01p-25f)) == 0x1p-24f);
+		CHECK(static_cast<float>(static_cast<half>(1.0f + 0x1p-11f)) == 1.0f);
+		CHECK(static_cast<float>(static_cast<half>(1.0f + 3 * 0x1p-11f)) == 1.0f + 0x1p-9f);
+		CHECK(static_cast<float>(static_cast<half>(0x1.ffcp-15f)) == 0x1p-14f);
+	}
+
+	SUBCASE("comparisons")
+	{
+		const half one = static_cast<half>(1.0f);
+		const half inf = half_bits(0x7C00);
+		const half nan = half_bits(0x7E00);
+		CHECK(proximal<0>{}(one, static_cast<half>(1.0f + 0x1p-10f)));
+		CHECK(!proximal<0>{}(one, static_cast<half>(1.0f + 0x1p-9f)));
+		CHECK(proximal<1>{}(one, static_cast<half>(1.0f + 0x1p-9f)));
+		CHECK(proximal<0>{}(half_bits(0x0000), half_bits(0x8000)));
+		CHECK(proximal<0>{}(half_bits(0x0001), half_bits(0x8000)));
+		CHECK(!proximal<0>{}(half_bits(0x0001), half_bits(0x8001)));
+		CHECK(proximal<0>{}(inf, inf));
+		CHECK(!proximal<20>{}(inf, half_bits(0x7BFF)));
+		CHECK(!proximal<20>{}(nan, nan));
+		CHECK(!proximal<10>{}(half_bits(0x7BFF), half_bits(0xFBFF)));
+		CHECK(proximal<11>{}(half_bits(0x7BFF), half_bits(0xFBFF)));
+		CHECK(std::isinf(static_cast<float>(proximal<11>{}.margin(half_bits(0x7BFF)))));
+		CHECK(static_cast<float>(proximal_dynamic{3}.margin(one)) == 0x1p-7f);
+		CHECK(proximal_dynamic{1}(one, static_cast<half>(1.0f + 0x1p-9f)));
+	}
+
+	SUBCASE("batch")
+	{
+		std::vector<half> a(1000), b(1000);
+		std::uint64_t state = 0x2545F4914F6CDD1D;
+		for (std::size_t i = 0; i < a.size(); ++i)
+		{
+			next_random(state);
+			std::uint16_t u = static_cast<std::uint16_t>(state);
+			a[i] = half_bits(u);
+			b[i] = half_bits(static_cast<std::uint16_t>(i % 5 == 0 ? state >> 16 : u + (state >> 16) % 9 - 4));
+		}
+		const proximal_dynamic close_enough{2};
+		std::vector<std::uint64_t> mask(16);
+		for_each_isa([&]()
+		{
+			for (std::size_t count : {0, 1, 15, 17, 999, 1000})
+			{
+				std::size_t expected = 0;
+				std::size_t first = proximal_stats<float>::npos;
+				bool agree = true;
+				close_enough.mismatches(a.data(), b.data(), count, mask.data());
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					bool close = close_enough(a[i], b[i]);
+					agree &= close != static_cast<bool>((mask[i / 64] >> (i % 64)) & 1);
+					if (!close && expected++ == 0)
+					{
+						first = i;
+					}
+				}
+				CHECK(agree);
+				CHECK(close_enough.all_close(a.data(), b.data(), count) == (expected == 0));
+				proximal_stats<float> s = close_enough.stats(a.data(), b.data(), count);
+				CHECK(s.mismatches == expected);
+				CHECK(s.first_mismatch == first);
+			}
+		});
+
+		parallel::options opts;
+		opts.chunk_bytes = 256;
+		proximal_stats<float> s = parallel::stats(close_enough, a.data(), b.data(), a.size(), opts);
+		proximal_stats<float> expected = close_enough.stats(a.data(), b.data(), a.size());
+		CHECK(s.mismatches == expected.mismatches);
+		CHECK(s.max_ulps == expected.max_ulps);
+		CHECK(s.worst == expected.worst);
+	}
+}
+
+static bfloat16
+bfloat16_bits(std::uint16_t u)
+{
+	return representation<bfloat16>{u}.value();
+}
+
+TEST_CASE("bfloat16")
+{
+	SUBCASE("every bfloat16 value")
+	{
+		bool agree = true;
+		for (std::uint32_t u = 0; u < 0x10000; ++u)
+		{
+			bfloat16 h = bfloat16_bits(static_cast<std::uint16_t>(u));
+			float x = static_cast<float>(h);
+			agree &= std::isnan(x) || __float_to_bfloat16_bits(x) == u;
+			if (std::isfinite(x) && x != 0)
+			{
+				agree &= ilog2(h) == std::ilogb(x);
+				agree &= static_cast<float>(ulp(h)) == std::ldexp(1.0f, std::max(std::ilogb(x) - 7, -133));
+			}
+			if ((u & 0x7FFF) < 0x7F80)
+			{
+				std::uint32_t next = u == 0x8000 ? 0x0001 : (u & 0x8000) ? u - 1 : u + 1;
+				agree &= ulp_distance(h, bfloat16_bits(static_cast<std::uint16_t>(next))) == 1;
+			}
+		}
+		CHECK(agree);
+	}
+
+	SUBCASE("rounding from float")
+	{
+		CHECK(static_cast<float>(bfloat16(1.0f + 0x1p-8f)) == 1.0f);
+		CHECK(static_cast<float>(bfloat16(1.0f + 3 * 0x1p-8f)) == 1.0f + 0x1p-6f);
+		CHECK(static_cast<float>(bfloat16(1.0f + 0x1p-8f + 0x1p-20f)) == 1.0f + 0x1p-7f);
+		CHECK(std::isinf(static_cast<float>(bfloat16(std::numeric_limits<float>::max()))));
+		CHECK(static_cast<float>(bfloat16(0x1p-134f)) == 0.0f);
+		CHECK(std::isnan(static_cast<float>(bfloat16(std::numeric_limits<float>::quiet_NaN()))));
+	}
+
+	SUBCASE("comparisons")
+	{
+		const bfloat16 one(1.0f);
+		const bfloat16 inf = bfloat16_bits(0x7F80);
+		const bfloat16 nan = bfloat16_bits(0x7FC0);
+		const bfloat16 largest = bfloat16_bits(0x7F7F);
+		CHECK(proximal<1>{}(one, bfloat16(1.0f + 0x1p-6f)));
+		CHECK(!proximal<1>{}(one, bfloat16(1.0f + 0x1p-5f)));
+		CHECK(proximal<0>{}(bfloat16_bits(0x0001), bfloat16_bits(0x8000)));
+		CHECK(!proximal<0>{}(bfloat16_bits(0x0001), bfloat16_bits(0x8001)));
+		CHECK(proximal<0>{}(inf, inf));
+		CHECK(!proximal<20>{}(inf, largest));
+		CHECK(!proximal<20>{}(nan, nan));
+		CHECK(!proximal<7>{}(largest, bfloat16_bits(0xFF7F)));
+		CHECK(proximal<8>{}(largest, bfloat16_bits(0xFF7F)));
+		CHECK(std::isinf(static_cast<float>(proximal<8>{}.margin(largest))));
+		CHECK(static_cast<float>(proximal_dynamic{3}.margin(one)) == 0x1p-4f);
+	}
+
+	SUBCASE("batch")
+	{
+		std::vector<bfloat16> a(1000), b(1000);
+		std::uint64_t state = 0x2545F4914F6CDD1D;
+		for (std::size_t i = 0; i < a.size(); ++i)
+		{
+			next_random(state);
+			std::uint16_t u = static_cast<std::uint16_t>(state);
+			a[i] = bfloat16_bits(u);
+			b[i] = bfloat16_bits(static_cast<std::uint16_t>(i % 5 == 0 ? state >> 16 : u + (state >> 16) % 9 - 4));
+		}
+		const proximal_dynamic close_enough{2};
+		proximal_stats<float> expected;
+		for (std::size_t i = 0; i < a.size(); ++i)
+		{
+			float u = static_cast<float>(a[i]);
+			float v = static_cast<float>(b[i]);
+			expected.add(i, u, v, close_enough(a[i], b[i]), static_cast<float>(ulp(std::abs(u) > std::abs(v) ? a[i] : b[i])));
+		}
+		std::vector<std::uint64_t> mask(16);
+		for_each_isa([&]()
+		{
+			bool agree = close_enough.mismatches(a.data(), b.data(), a.size(), mask.data()) == expected.mismatches;
+			for (std::size_t i = 0; i < a.size(); ++i)
+			{
+				agree &= close_enough(a[i], b[i]) != static_cast<bool>((mask[i / 64] >> (i % 64)) & 1);
+			}
+			CHECK(agree);
+			CHECK(!close_enough.all_close(a.data(), b.data(), a.size()));
+			proximal_stats<float> s = close_enough.stats(a.data(), b.data(), a.size());
+			CHECK(s.mismatches == expected.mismatches);
+			CHECK(s.first_mismatch == expected.first_mismatch);
+			CHECK(s.max_ulps == expected.max_ulps);
+			CHECK(s.worst == expected.worst);
+		});
+	}
+}
+
+#if (__PROXIMAL_HAS_FLOAT128__)
+
+static __float128
+binary128_bits(std::uint64_t high, std::uint64_t low)
+{
+	return representation<__float128>{(static_cast<bits128>(high) << 64) | low}.value();
+}
+
+TEST_CASE("binary128")
+{
+	std::uint64_t state = 0x9E3779B97F4A7C15;
+	const __float128 one = 1.0;
+	const __float128 inf = binary128_bits(0x7FFF000000000000, 0);
+	const __float128 nan = binary128_bits(0x7FFF800000000000, 0);
+	const __float128 largest = binary128_bits(0x7FFEFFFFFFFFFFFF, ~std::uint64_t{0});
+
+	SUBCASE("exponents and ulps")
+	{
+		bool agree = true;
+		for (int i = 0; i < 100000; ++i)
+		{
+			std::uint64_t high = next_random(state);
+			// half of the values denormal or nearly so
+			high = (i & 1) ? high : high & 0x80000FFFFFFFFFFF;
+			__float128 x = binary128_bits(high, next_random(state));
+			if (__is_inf_or_nan(x) || x == 0)
+			{
+				continue;
+			}
+			__float128 mag = __abs(x);
+			int exp = ilog2(x);
+			agree &= exp2i<__float128>(exp) <= mag && mag < 2 * exp2i<__float128>(exp);
+			agree &= ulp(x) == exp2i<__float128>(std::max(exp - 112, -16494));
+			agree &= proximal<4>{}.margin(x) == 16 * ulp(x);
+			agree &= proximal_dynamic{4}.margin(x) == 16 * ulp(x);
+			representation<__float128> r{x};
+			bits128 u = r.bits();
+			bits128 following = (u & (bits128{1} << 127)) ? u - 1 : u + 1;
+			agree &= ulp_distance(x, representation<__float128>{following}.value()) == 1;
+		}
+		CHECK(agree);
+		CHECK(ilog2(binary128_bits(0, 1)) == -16494);
+		CHECK((ulp(static_cast<__float128>(0.0)) == binary128_bits(0, 1)));
+		CHECK(ulp_distance(-binary128_bits(0, 1), binary128_bits(0, 1)) == 2);
+		CHECK(ulp_distance(largest, inf) == 1);
+		CHECK(ulp_distance(-one, one) == std::numeric_limits<std::int64_t>::max());
+		CHECK(ulp_distance(one, -one) == std::numeric_limits<std::int64_t>::min());
+		CHECK(ulp_distance(nan, one) == std::numeric_limits<std::int64_t>::max());
+	}
+
+	SUBCASE("comparisons")
+	{
+		const __float128 e = exp2i<__float128>(-112);
+		CHECK(proximal<0>{}(one, one + e));
+		CHECK(!proximal<0>{}(one, one + 2 * e));
+		CHECK(proximal<1>{}(one, one + 2 * e));
+		CHECK(proximal_dynamic{1}(one, one + 2 * e));
+		CHECK(!proximal_dynamic{1}(one, one + 4 * e));
+		CHECK(proximal<0>{}(static_cast<__float128>(0.0), -static_cast<__float128>(0.0)));
+		CHECK(proximal<0>{}(binary128_bits(0, 1), -static_cast<__float128>(0.0)));
+		CHECK(!proximal<0>{}(binary128_bits(0, 1), -binary128_bits(0, 1)));
+		CHECK(proximal<0>{}(inf, inf));
+		CHECK(!proximal<20>{}(inf, largest));
+		CHECK(!proximal<20>{}(nan, nan));
+
+		// the integer domain comparison agrees with the ilog2/exp2i definition
+		bool agree = true;
+		for (int i = 0; i < 100000; ++i)
+		{
+			std::uint64_t high = next_random(state) & 0x80000FFFFFFFFFFF;
+			high |= (i & 1) ? std::uint64_t{0x3FFF} << 48 : 0;
+			std::uint64_t low = next_random(state);
+			__float128 a = binary128_bits(high, low);
+			__float128 b = binary128_bits(high ^ (next_random(state) & 0x8000000000000000), low + next_random(state) % 64);
+			__float128 margin = proximal<3>{}.margin(std::max(__abs(a), __abs(b)));
+			agree &= proximal<3>{}(a, b) == (a == b || __abs(a - b) <= margin);
+		}
+		CHECK(agree);
+	}
+
+	SUBCASE("arrays")
+	{
+		std::vector<__float128> a(200), b(200);
+		for (std::size_t i = 0; i < a.size(); ++i)
+		{
+			a[i] = one + static_cast<__float128>(i);
+			b[i] = a[i] + (i % 7 == 3 ? 16 * ulp(a[i]) : 2 * ulp(a[i]));
+		}
+		std::vector<std::uint64_t> mask(4);
+		const proximal<2> close_enough;
+		CHECK(close_enough.mismatches(a.data(), b.data(), a.size(), mask.data()) == 29);
+		CHECK(((mask[0] >> 3) & 1) == 1);
+		CHECK(!close_enough.all_close(a.data(), b.data(), a.size()));
+		CHECK(close_enough.all_close(a.data(), b.data(), 3));
+		proximal_stats<__float128> s = close_enough.stats(a.data(), b.data(), a.size());
+		CHECK(s.mismatches == 29);
+		CHECK(s.first_mismatch == 3);
+		CHECK((s.max_ulps == 16));
+		CHECK(s.worst == 3);
+	}
+}
+
+#endif // __PROXIMAL_HAS_FLOAT128__
+
+/*
+ *	Check a proximal_unordered_set against a linear scan: a key is found if
+ *	and only if some stored key is close to it, and the key found is one of
+ *	the nearest.
+ */
+template<class T, int N>
+static bool
+agrees_with_scan(const proximal_unordered_set<T, N>& set, T key)
+{
+	const T* nearest = nullptr;
+	std::int64_t distance = 0;
+	for (const T& x : set)
+	{
+		std::int64_t d = std::abs(ulp_distance(x, key));
+		if (proximal<N>{}(x, key) && (nearest == nullptr || d < distance))
+		{
+			nearest = &x;
+			distance = d;
+		}
+	}
+	auto found = set.find(key);
+	return nearest == nullptr ? found == set.end()
+		: found != set.end() && std::abs(ulp_distance(*found, key)) == distance;
+}
+
+TEST_CASE("proximal unordered set and map")
+{
+	std::uint64_t state = 0x9E3779B97F4A7C15;
+
+	SUBCASE("insert and find")
+	{
+		proximal_unordered_set<double, 2> set;
+		CHECK(set.find(1.0) == set.end());
+		CHECK(set.insert(1.0).second);
+		CHECK(!set.insert(1.0 + 0x1p-51).second);
+		CHECK(!set.insert(1.0 - 0x1p-52).second);
+		CHECK(set.insert(1.0 + 0x1p-49).second);
+		CHECK(set.size() == 2);
+		CHECK(*set.find(1.0 + 0x1p-51) == 1.0);
+		CHECK(*set.find(1.0 + 0x1p-50 + 0x1p-51) == 1.0 + 0x1p-49);
+		CHECK(set.contains(-0.0) == false);
+		CHECK(set.insert(0.0).second);
+		CHECK(set.contains(-0.0));
+		CHECK(set.insert(std::numeric_limits<double>::infinity()).second);
+		CHECK(set.contains(std::numeric_limits<double>::infinity()));
+		CHECK(!set.contains(std::numeric_limits<double>::max()));
+		CHECK(set.erase(1.0 + 0x1p-52) == 1);
+		CHECK(!set.contains(1.0));
+		CHECK(set.contains(1.0 + 0x1p-49));
+		CHECK(set.size() == 3);
+		set.clear();
+		CHECK(set.empty());
+		CHECK(!set.contains(0.0));
+	}
+
+	SUBCASE("NaN keys are not inserted")
+	{
+		// NaN is close to nothing, so it could never be found or erased
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		proximal_unordered_set<double> set;
+		set.insert(1.0);
+		for (int i = 0; i < 100000; ++i)
+		{
+			auto inserted = set.insert(i % 2 == 0 ? nan : -nan);
+			REQUIRE(inserted.first == set.end());
+			REQUIRE(!inserted.second);
+		}
+		CHECK(set.size() == 1);
+		CHECK(!set.contains(nan));
+		CHECK(set.erase(nan) == 0);
+
+		proximal_unordered_map<float, int> map;
+		CHECK(map.try_emplace(std::numeric_limits<float>::quiet_NaN(), 1).first == map.end());
+		CHECK(!map.insert(std::numeric_limits<float>::quiet_NaN(), 1).second);
+		CHECK(map.empty());
+		CHECK(map.find(std::numeric_limits<float>::quiet_NaN()) == map.end());
+	}
+
+	SUBCASE("every close key is found")
+	{
+		// keys packed around powers of two, zeros and denormals, where cells
+		// and binades meet
+		proximal_unordered_set<float, 3> set;
+		auto key = [&state]()
+		{
+			std::uint64_t r = next_random(state);
+			std::int32_t offset = static_cast<std::int32_t>(r % 64) - 32;
+			std::uint32_t base = (r >> 8) % 4 == 0 ? 0 : static_cast<std::uint32_t>((r >> 16) % 8 + 125) << 23;
+			std::uint32_t bits = base + offset;
+			bits = static_cast<std::int32_t>(bits) < 0 ? static_cast<std::uint32_t>(-offset) : bits;
+			return representation<float>{bits ^ static_cast<std::uint32_t>((r >> 40) & 1) << 31}.value();
+		};
+		bool agree = true;
+		for (int i = 0; i < 2000; ++i)
+		{
+			float x = key();
+			bool present = set.contains(x);
+			auto result = set.insert(x);
+			agree &= result.second != present && proximal<3>{}(*result.first, x);
+			agree &= agrees_with_scan(set, key());
+			if (i % 3 == 0)
+			{
+				set.erase(key());
+			}
+		}
+		CHECK(agree);
+		CHECK(set.size() > 30);
+	}
+
+	SUBCASE("random doubles")
+	{
+		proximal_unordered_set<double, 1> set;
+		set.reserve(1000);
+		std::vector<double> keys;
+		for (int i = 0; i < 1000; ++i)
+		{
+			keys.push_back(std::ldexp(static_cast<double>(next_random(state) >> 11), static_cast<int>(next_random(state) % 16) - 60));
+			set.insert(keys.back());
+		}
+		bool agree = true;
+		for (double k : keys)
+		{
+			for (int u = -3; u <= 3; ++u)
+			{
+				agree &= agrees_with_scan(set, representation<double>{representation<double>{k}.bits() + u}.value());
+			}
+		}
+		CHECK(agree);
+	}
+
+	SUBCASE("other types")
+	{
+		proximal_unordered_set<long double, 1> extended;
+		CHECK(extended.insert(1.0L).second);
+		CHECK(!extended.insert(1.0L + 0x1p-62L).second);
+		CHECK(extended.insert(-1.0L).second);
+		CHECK(*extended.find(-1.0L - 0x1p-63L) == -1.0L);
+		proximal_unordered_set<half, 0> narrow;
+		CHECK(narrow.insert(static_cast<half>(1.0f)).second);
+		CHECK(!narrow.insert(static_cast<half>(std::numeric_limits<float>::quiet_NaN())).second);
+		CHECK(narrow.contains(static_cast<half>(1.0f + 0x1p-10f)));
+		CHECK(!narrow.contains(static_cast<half>(1.0f + 0x1p-9f)));
+	}
+
+	SUBCASE("map")
+	{
+		proximal_unordered_map<double, int> histogram;
+		for (double x : {0.1, 0.2, 0.3, 1.0 - 0.9, 0.1 + 0.2, 0.7})
+		{
+			++histogram[x];
+		}
+		CHECK(histogram.size() == 4);
+		CHECK(histogram[0.1] == 2);
+		CHECK(histogram.find(0.3)->second == 2);
+		CHECK(!histogram.try_emplace(0.7, 10).second);
+		CHECK(histogram.insert(0.8, 10).second);
+		CHECK(histogram[0.8] == 10);
+		histogram.erase(histogram.find(0.1));
+		CHECK(histogram.size() == 4);
+		CHECK(histogram.find(0.1) == histogram.end());
+		CHECK(histogram[0.8] == 10);
+	}
+}
+
+template<int N, class T>
+static std::pair<std::size_t, std::size_t> scanned_range(const std::vector<T>& sorted, T x)
+{
+	std::size_t begin = sorted.size();
+	std::size_t end = sorted.size();
+	for (std::size_t i = 0; i < sorted.size(); ++i)
+	{
+		if (proximal<N>{}(sorted[i], x))
+		{
+			begin = std::min(begin, i);
+			end = i + 1;
+		}
+	}
+	if (begin == sorted.size())
+	{
+		begin = end = __is_nan(x) ? sorted.size() : static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), x) - sorted.begin());
+	}
+	return {begin, end};
+}
+
+TEST_CASE("proximal search of sorted arrays")
+{
+	std::uint64_t state = 0x2545F4914F6CDD1D;
+	// values packed around powers of two and zero, with duplicates
+	auto value = [&state]()
+	{
+		std::uint64_t r = next_random(state);
+		std::int32_t offset = static_cast<std::int32_t>(r % 48) - 24;
+		std::uint32_t base = (r >> 8) % 5 == 0 ? 0 : static_cast<std::uint32_t>((r >> 16) % 6 + 124) << 23;
+		std::uint32_t bits = base + offset;
+		bits = static_cast<std::int32_t>(bits) < 0 ? static_cast<std::uint32_t>(-offset) : bits;
+		return representation<float>{bits ^ static_cast<std::uint32_t>((r >> 40) & 1) << 31}.value();
+	};
+
+	SUBCASE("ranges")
+	{
+		CHECK(proximal_equal_range(static_cast<const double*>(nullptr), static_cast<const double*>(nullptr), 1.0).first == nullptr);
+		std::vector<double> table{-1.0, 0.0, 1.0 - 0x1p-53, 1.0, 1.0 + 0x1p-52, 1.0 + 0x1p-50, 2.0};
+		auto range = proximal_equal_range<1>(table.begin(), table.end(), 1.0);
+		CHECK(range.first - table.begin() == 2);
+		CHECK(range.second - table.begin() == 5);
+		CHECK(proximal_lower_bound<3>(table.begin(), table.end(), 1.0) - table.begin() == 2);
+		CHECK(proximal_upper_bound<3>(table.begin(), table.end(), 1.0) - table.begin() == 6);
+		range = proximal_equal_range(table.begin(), table.end(), 1.5);
+		CHECK(range.first == range.second);
+		CHECK(range.first - table.begin() == 6);
+		CHECK(proximal_find<3>(table.begin(), table.end(), 1.0 + 0x1p-51) - table.begin() == 4);
+		CHECK(proximal_find(table.begin(), table.end(), 0.5) == table.end());
+		CHECK(proximal_equal_range(table.begin(), table.end(), std::nan("")).first == table.end());
+	}
+
+	SUBCASE("agrees with a scan")
+	{
+		for (std::size_t size : {0, 1, 2, 3, 7, 8, 9, 100, 1000})
+		{
+			std::vector<float> sorted;
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				sorted.push_back(value());
+			}
+			std::sort(sorted.begin(), sorted.end());
+			std::vector<float> queries;
+			for (int i = 0; i < 300; ++i)
+			{
+				queries.push_back(value());
+			}
+			queries.push_back(std::numeric_limits<float>::infinity());
+			queries.push_back(std::numeric_limits<float>::quiet_NaN());
+			std::vector<std::pair<std::size_t, std::size_t>> batch(queries.size());
+			std::vector<std::pair<std::size_t, std::size_t>> tree_batch(queries.size());
+			proximal_equal_range<2>(sorted.data(), sorted.size(), queries.data(), queries.size(), batch.data());
+			proximal_eytzinger<float, 2> tree{sorted.data(), sorted.size()};
+			tree.equal_range(queries.data(), queries.size(), tree_batch.data());
+			bool agree = true;
+			for (std::size_t i = 0; i < queries.size(); ++i)
+			{
+				auto expected = scanned_range<2>(sorted, queries[i]);
+				auto range = proximal_equal_range<2>(sorted.data(), sorted.data() + sorted.size(), queries[i]);
+				agree &= range.first - sorted.data() == static_cast<std::ptrdiff_t>(expected.first);
+				agree &= range.second - sorted.data() == static_cast<std::ptrdiff_t>(expected.second);
+				agree &= batch[i] == expected;
+				agree &= tree.equal_range(queries[i]) == expected;
+				agree &= tree_batch[i] == expected;
+				std::size_t found = tree.find(queries[i]);
+				agree &= found == sorted.size() ? expected.first == expected.second : proximal<2>{}(sorted[found], queries[i]);
+			}
+			CHECK(agree);
+		}
+	}
+}
+
+TEST_CASE("proximal unique")
+{
+	std::uint64_t state = 0x853C49E6748FEA9B;
+
+	SUBCASE("semantics")
+	{
+		// each step is one margin, so the chain spans four margins
+		std::vector<double> values{0.5, 1.0, 1.0 + 0x1p-51, 1.0 + 0x1p-50, 1.0 + 0x1p-50 + 0x1p-51, 1.0 + 0x1p-49, 3.0};
+		std::vector<double> anchored = values;
+		anchored.resize(static_cast<std::size_t>(proximal_unique<1>(anchored.data(), anchored.data() + anchored.size(), proximal_chaining::anchor) - anchored.data()));
+		CHECK(anchored == std::vector<double>{0.5, 1.0, 1.0 + 0x1p-50, 1.0 + 0x1p-49, 3.0});
+		std::vector<double> chained = values;
+		chained.resize(static_cast<std::size_t>(proximal_unique<1>(chained.data(), chained.data() + chained.size(), proximal_chaining::chain) - chained.data()));
+		CHECK(chained == std::vector<double>{0.5, 1.0, 3.0});
+		CHECK(proximal_unique<1>(values.data(), values.data(), proximal_chaining::chain) == values.data());
+	}
+
+	SUBCASE("agrees with a scan, in parallel")
+	{
+		parallel::pool workers{4};
+		parallel::options opts;
+		opts.workers = &workers;
+		opts.chunk_bytes = 1024;
+		for (int trial = 0; trial < 4; ++trial)
+		{
+			// ascending values in steps of up to a few ulps, with jumps, duplicates
+			// and runs that cross powers of two and chunk boundaries
+			std::vector<float> sorted;
+			float x = trial % 2 ? -4.0f : 0.75f;
+			for (int i = 0; i < 20000; ++i)
+			{
+				std::uint64_t r = next_random(state);
+				std::uint32_t step = r % 16 == 0 ? 1000 : static_cast<std::uint32_t>(r >> 8) % (trial < 2 ? 4 : 12);
+				x = x < 0 && step > 0 ? representation<float>{representation<float>{x}.bits() - step}.value() : representation<float>{representation<float>{x}.bits() + step}.value();
+				x = x == 0 ? 0.0f : x;
+				sorted.push_back(x);
+			}
+			std::sort(sorted.begin(), sorted.end());
+			std::vector<float> anchored;
+			std::vector<float> chained;
+			for (float y : sorted)
+			{
+				if (anchored.empty() || !proximal<2>{}(anchored.back(), y))
+				{
+					anchored.push_back(y);
+				}
+			}
+			for (std::size_t i = 0; i < sorted.size(); ++i)
+			{
+				if (i == 0 || !proximal<2>{}(sorted[i - 1], sorted[i]))
+				{
+					chained.push_back(sorted[i]);
+				}
+			}
+			for (proximal_chaining chaining : {proximal_chaining::anchor, proximal_chaining::chain})
+			{
+				const std::vector<float>& expected = chaining == proximal_chaining::anchor ? anchored : chained;
+				std::vector<float> serial = sorted;
+				serial.resize(static_cast<std::size_t>(proximal_unique<2>(serial.data(), serial.data() + serial.size(), chaining) - serial.data()));
+				CHECK(serial == expected);
+				std::vector<float> threaded = sorted;
+				threaded.resize(static_cast<std::size_t>(parallel::proximal_unique<2>(threaded.data(), threaded.data() + threaded.size(), chaining, opts) - threaded.data()));
+				CHECK(threaded == expected);
+			}
+			CHECK(chained.size() < anchored.size());
+		}
+	}
+}
+
+TEST_CASE("geometry")
+{
+	SUBCASE("points")
+	{
+		std::array<double, 3> p{{1.0, 2.0, 0.0}};
+		std::array<double, 3> q{{1.0 + 0x1p-52, 2.0, 0x1p-60}};
+		CHECK(!proximal_geometry<1>{}(p, q));
+		CHECK(proximal_geometry<1, geometry_margin::norm>{}(p, q));
+		CHECK(!proximal_geometry<1, geometry_margin::norm>{}(p, std::array<double, 3>{{1.0, 2.0, 0x1p-48}}));
+		CHECK(proximal_geometry<2>{}(p, std::array<double, 3>{{1.0 - 0x1p-53, 2.0 + 0x1p-51, 0.0}}));
+		std::array<float, 2> nan{{1.0f, std::nanf("")}};
+		CHECK(!proximal_geometry<1>{}(nan, nan));
+		CHECK(!proximal_geometry<1, geometry_margin::norm>{}(nan, nan));
+		std::array<float, 2> inf{{std::numeric_limits<float>::infinity(), 0.0f}};
+		CHECK(proximal_geometry<1, geometry_margin::norm>{}(inf, inf));
+	}
+
+	SUBCASE("norms at the ends of the exponent range")
+	{
+		proximal_geometry<1, geometry_margin::norm> close_enough;
+		// squares that would underflow to zero
+		CHECK(!close_enough(std::array<float, 3>{{1e-25f, 0.0f, 0.0f}}, std::array<float, 3>{{2e-25f, 0.0f, 0.0f}}));
+		CHECK(!close_enough(std::array<double, 3>{{1e-170, 1e-170, 0.0}}, std::array<double, 3>{{3e-170, 1e-170, 0.0}}));
+		CHECK(close_enough(std::array<double, 3>{{1e-170, 1e-170, 0.0}}, std::array<double, 3>{{1e-170 * (1.0 + 0x1p-52), 1e-170, 0.0}}));
+		CHECK(close_enough(std::array<float, 2>{{1e-40f, 0.0f}}, std::array<float, 2>{{std::nextafter(1e-40f, 1.0f), 0.0f}}));
+		CHECK(!close_enough(std::array<float, 2>{{1e-40f, 0.0f}}, std::array<float, 2>{{2e-40f, 0.0f}}));
+		// squares that would overflow
+		CHECK(close_enough(std::array<double, 3>{{1e200, 0.0, 0.0}}, std::array<double, 3>{{1e200 * (1.0 + 0x1p-52), 0.0, 0.0}}));
+		CHECK(!close_enough(std::array<double, 3>{{1e200, 0.0, 0.0}}, std::array<double, 3>{{1e200 * (1.0 + 0x1p-40), 0.0, 0.0}}));
+		const float max = std::numeric_limits<float>::max();
+		CHECK(close_enough(std::array<float, 2>{{max, max}}, std::array<float, 2>{{max, std::nextafter(max, 0.0f)}}));
+		CHECK(!close_enough(std::array<float, 2>{{max, 0.0f}}, std::array<float, 2>{{-max, 0.0f}}));
+		CHECK(close_enough(std::array<long double, 2>{{1e4000L, 1e-4000L}}, std::array<long double, 2>{{1e4000L, 0.0L}}));
+	}
+
+	SUBCASE("matrices")
+	{
+		using matrix = std::array<std::array<double, 4>, 4>;
+		matrix m{{{{1.0, 0.0, 0.0, 10.0}}, {{0.0, 1.0, 0.0, 20.0}}, {{0.0, 0.0, 1.0, 30.0}}, {{0.0, 0.0, 0.0, 1.0}}}};
+		matrix n = m;
+		n[0][1] = 1e-15;
+		CHECK(!proximal_geometry<1>{}(m, n));
+		CHECK(proximal_geometry<1, geometry_margin::norm>{}(m, n));
+		n[3][3] = 1.0 + 0x1p-40;
+		CHECK(!proximal_geometry<4, geometry_margin::norm>{}(m, n));
+	}
+
+	SUBCASE("rotations and batches")
+	{
+		std::vector<std::array<double, 4>> q;
+		std::vector<std::array<double, 4>> r;
+		for (int i = 0; i < 150; ++i)
+		{
+			double angle = 0.01 * i;
+			q.push_back({{std::cos(angle), 0.0, std::sin(angle), 0.0}});
+			r.push_back(i % 2 ? std::array<double, 4>{{-q.back()[0], -0.0, -q.back()[2], -0.0}} : q.back());
+		}
+		proximal_geometry<1, geometry_margin::norm> close_enough;
+		CHECK(close_enough.same_rotation(q[3], r[3]));
+		CHECK(!close_enough(q[3], r[3]));
+		CHECK(close_enough.all_same_rotation(q.data(), r.data(), q.size()));
+		CHECK(!close_enough.all_close(q.data(), r.data(), q.size()));
+		std::vector<std::uint64_t> mask((q.size() + 63) / 64);
+		CHECK(close_enough.mismatches(q.data(), r.data(), q.size(), mask.data()) == 75);
+		CHECK(mask[0] == 0xAAAAAAAAAAAAAAAA);
+		CHECK(mask[2] == 0x2AAAAA);
+		r[140][0] += 1e-9;
+		CHECK(close_enough.rotation_mismatches(q.data(), r.data(), q.size(), mask.data()) == 1);
+		CHECK(mask[2] == std::uint64_t{1} << 12);
+		CHECK(!close_enough.all_same_rotation(q.data(), r.data(), q.size()));
+	}
+}
+
+template<class T>
+static void
+check_complex_kernels()
+{
+	std::uint64_t state = 0xDA942042E4DD58B5;
+	// values of all sizes, some with a zero part, perturbed by up to a few
+	// margins of their modulus in each part
+	std::vector<std::complex<T>> a;
+	std::vector<std::complex<T>> b;
+	for (int i = 0; i < 1000; ++i)
+	{
+		T re = std::ldexp(static_cast<T>(next_random(state) % 1000 + 1), static_cast<int>(next_random(state) % 80) - 40) * (next_random(state) % 2 ? 1 : -1);
+		T im = next_random(state) % 5 == 0 ? static_cast<T>(0) : std::ldexp(static_cast<T>(next_random(state) % 1000 + 1), static_cast<int>(next_random(state) % 80) - 40);
+		std::complex<T> x{re, im};
+		T step = std::abs(x) * std::ldexp(static_cast<T>(1), static_cast<int>(next_random(state) % 4) - fractional_digits<T>);
+		a.push_back(x);
+		b.push_back({re + step * static_cast<T>(static_cast<int>(next_random(state) % 3) - 1), im + step * static_cast<T>(static_cast<int>(next_random(state) % 3) - 1)});
+	}
+	b[100] = {std::numeric_limits<T>::quiet_NaN(), 0};
+	b[200] = {std::numeric_limits<T>::infinity(), 0};
+	a[300] = b[300] = {std::numeric_limits<T>::infinity(), 1};
+	proximal<2> close_enough;
+	for (complex_margin mode : {complex_margin::componentwise, complex_margin::modulus})
+	{
+		std::vector<std::uint64_t> expected((a.size() + 63) / 64);
+		std::size_t total = 0;
+		for (std::size_t i = 0; i < a.size(); ++i)
+		{
+			bool close = close_enough(a[i], b[i], mode);
+			expected[i / 64] |= static_cast<std::uint64_t>(!close) << (i % 64);
+			total += !close;
+		}
+		CHECK(total > 50);
+		CHECK(total < 900);
+		for_each_isa([&]()
+		{
+			std::vector<std::uint64_t> mask(expected.size());
+			CHECK(close_enough.mismatches(a.data(), b.data(), a.size(), mask.data(), mode) == total);
+			CHECK(mask == expected);
+			bool agree = true;
+			for (std::size_t count = 0; count < 70; ++count)
+			{
+				bool all = true;
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					all &= close_enough(a[i], b[i], mode);
+				}
+				agree &= close_enough.all_close(a.data(), b.data(), count, mode) == all;
+			}
+			CHECK(agree);
+			CHECK(close_enough.all_close(b.data() + 400, b.data() + 400, 600, mode));
+		});
+	}
+}
+
+TEST_CASE("complex")
+{
+	SUBCASE("modes")
+	{
+		proximal<1> close_enough;
+		std::complex<double> a{1.0, 0.0};
+		std::complex<double> b{1.0, 0x1p-60};
+		CHECK(!close_enough(a, b));
+		CHECK(close_enough(a, b, complex_margin::modulus));
+		CHECK(close_enough(a, std::complex<double>{1.0 + 0x1p-52, 0.0}));
+		CHECK(!close_enough(a, std::complex<double>{1.0, 0x1p-50}, complex_margin::modulus));
+		// the margin comes from the modulus, not the larger part
+		CHECK(close_enough(std::complex<double>{1.5, 1.5}, std::complex<double>{1.5, 1.5 + 0x1p-50}, complex_margin::modulus));
+		CHECK(!close_enough(std::complex<double>{1.5, 1.5}, std::complex<double>{1.5, 1.5 + 0x1p-50}));
+		CHECK(close_enough(std::complex<float>{0.0f, 0.0f}, std::complex<float>{0.0f, -0.0f}, complex_margin::modulus));
+		CHECK(!close_enough(std::complex<float>{std::nanf(""), 0.0f}, std::complex<float>{std::nanf(""), 0.0f}, complex_margin::modulus));
+		CHECK(close_enough(std::complex<long double>{1e300L, 1e300L}, std::complex<long double>{1e300L, 1e300L + 1e281L}, complex_margin::modulus));
+		CHECK(close_enough(std::complex<double>{1e300, -1e300}, std::complex<double>{1e300, -1e300 - 1e284}, complex_margin::modulus));
+		CHECK(close_enough(std::complex<double>{0x1p-1074, 0.0}, std::complex<double>{0.0, 0x1p-1074}, complex_margin::modulus));
+		CHECK(!close_enough(std::complex<double>{0x1p-1070, 0.0}, std::complex<double>{0.0, 0x1p-1070}, complex_margin::modulus));
+		proximal_dynamic dynamic{1};
+		CHECK(dynamic(std::complex<double>{1.5, 1.5}, std::complex<double>{1.5, 1.5 + 0x1p-50}, complex_margin::modulus));
+	}
+
+	SUBCASE("kernels")
+	{
+		check_complex_kernels<float>();
+		check_complex_kernels<double>();
+		check_complex_kernels<long double>();
+	}
+}
+
+template<class T>
+static std::size_t scanned_mismatches(const tensor::view<T>& a, const tensor::view<T>& b)
+{
+	std::vector<std::size_t> index(a.shape.size(), 0);
+	std::size_t total = 0;
+	for (std::size_t i = 0; i < a.size(); ++i)
+	{
+		std::ptrdiff_t x = 0;
+		std::ptrdiff_t y = 0;
+		for (std::size_t k = 0; k < index.size(); ++k)
+		{
+			x += a.strides[k] * static_cast<std::ptrdiff_t>(index[k]);
+			y += b.strides[k] * static_cast<std::ptrdiff_t>(index[k]);
+		}
+		total += !proximal<1>{}(a.data[x], b.data[y]);
+		for (std::size_t k = index.size(); k-- > 0 && ++index[k] == a.shape[k];)
+		{
+			index[k] = 0;
+		}
+	}
+	return total;
+}
+
+TEST_CASE("tensor views")
+{
+	std::uint64_t state = 0x6A09E667F3BCC909;
+	// a 3 x 4 x 3000 tensor, and a copy with a few elements moved by 1 or 4 ulps
+	const std::vector<std::size_t> shape{3, 4, 3000};
+	std::vector<double> data(3 * 4 * 3000);
+	for (double& x : data)
+	{
+		x = std::ldexp(static_cast<double>(next_random(state) >> 11), -53) + 1.0;
+	}
+	std::vector<double> other = data;
+	for (std::size_t i = 0; i < other.size(); i += 97)
+	{
+		other[i] = representation<double>{representation<double>{other[i]}.bits() + (i % 2 ? 1 : 4)}.value();
+	}
+	proximal<1> close_enough;
+	auto a = tensor::view<double>::row_major(data.data(), shape);
+	auto b = tensor::view<double>::row_major(other.data(), shape);
+
+	SUBCASE("contiguous and permuted")
+	{
+		CHECK(tensor::all_close(close_enough, a, a));
+		CHECK(!tensor::all_close(close_enough, a, b));
+		CHECK(tensor::mismatches(close_enough, a, b) == scanned_mismatches(a, b));
+		CHECK(tensor::mismatches(close_enough, a, b) > 0);
+		// the same tensors with the axes listed in another order
+		for (auto order : {std::vector<std::size_t>{2, 0, 1}, std::vector<std::size_t>{1, 2, 0}})
+		{
+			tensor::view<double> pa{a.data, {}, {}};
+			tensor::view<double> pb{b.data, {}, {}};
+			for (std::size_t k : order)
+			{
+				pa.shape.push_back(a.shape[k]);
+				pa.strides.push_back(a.strides[k]);
+				pb.shape.push_back(b.shape[k]);
+				pb.strides.push_back(b.strides[k]);
+			}
+			CHECK(tensor::mismatches(close_enough, pa, pb) == scanned_mismatches(a, b));
+		}
+		// a column-major view of the same memory against the row-major one
+		auto c = tensor::view<double>::column_major(data.data(), {3000, 4, 3});
+		auto t = tensor::view<double>{b.data, {3000, 4, 3}, {1, 3000, 12000}};
+		CHECK(tensor::mismatches(close_enough, c, t) == scanned_mismatches(a, b));
+	}
+
+	SUBCASE("slices, reversal and broadcasting")
+	{
+		// every other row of the last axis, reversed in both
+		tensor::view<double> sa{data.data() + 2999, {3, 4, 1500}, {12000, 3000, -2}};
+		tensor::view<double> sb{other.data() + 2999, {3, 4, 1500}, {12000, 3000, -2}};
+		CHECK(tensor::mismatches(close_enough, sa, sb) == scanned_mismatches(sa, sb));
+		// reversed in one only
+		tensor::view<double> ra{data.data(), {3, 4, 3000}, {12000, 3000, 1}};
+		tensor::view<double> rb{other.data() + 2999, {3, 4, 3000}, {12000, 3000, -1}};
+		CHECK(tensor::mismatches(close_enough, ra, rb) == scanned_mismatches(ra, rb));
+		// one row broadcast against all of them, both along the contiguous
+		// axis (tiled) and across it
+		auto row = tensor::view<double>::row_major(data.data() + 3000, {1, 3000}).broadcast(shape);
+		CHECK(tensor::mismatches(close_enough, a, row) == scanned_mismatches(a, row));
+		CHECK(tensor::mismatches(close_enough, a, row) == 3 * 4 * 3000 - 3000);
+		auto column = tensor::view<double>::row_major(data.data(), {3, 4, 1}).broadcast(shape);
+		CHECK(tensor::mismatches(close_enough, b, column) == scanned_mismatches(b, column));
+		auto scalar = tensor::view<double>::row_major(data.data(), {}).broadcast(shape);
+		CHECK(tensor::mismatches(close_enough, scalar, scalar) == 0);
+		CHECK(tensor::all_close(close_enough, tensor::view<double>{data.data(), {3, 0, 2}, {0, 0, 0}}, tensor::view<double>{other.data(), {3, 0, 2}, {1, 1, 1}}));
+		CHECK(tensor::all_close(close_enough, tensor::view<double>::row_major(data.data(), {}), tensor::view<double>::row_major(data.data(), {})));
+	}
+}
+
+TEST_CASE("cross precision")
+{
+	proximal_cross<1> close_enough;
+	const float max = std::numeric_limits<float>::max();
+	const float inf = std::numeric_limits<float>::infinity();
+
+	SUBCASE("values")
+	{
+		CHECK(close_enough(1.0f, 1.0 + std::ldexp(1.0, -30)));
+		CHECK(close_enough(1.0f + std::ldexp(1.0f, -22), 1.0));
+		CHECK(!close_enough(1.0f + std::ldexp(1.0f, -20), 1.0));
+		CHECK(close_enough(1.0, 1.0L + std::ldexp(1.0L, -60)));
+		CHECK(close_enough(1.0f, 1.0L));
+		// references past the range of float round to infinity
+		CHECK(close_enough(max, static_cast<double>(max) * (1.0 + std::ldexp(1.0, -30))));
+		CHECK(close_enough(inf, 1e39));
+		CHECK(!close_enough(max, 1e39));
+		CHECK(!close_enough(-inf, 1e39));
+		CHECK(!close_enough(std::nanf(""), std::nan("")));
+		// references in the range of float denormals round to them
+		CHECK(close_enough(0.0f, 1e-50));
+		CHECK(close_enough(std::numeric_limits<float>::denorm_min(), 1.5e-45));
+		CHECK(close_enough(0.0f, std::ldexp(1.0, -148)));
+		CHECK(!close_enough(0.0f, std::ldexp(1.0, -147)));
+	}
+
+	SUBCASE("arrays")
+	{
+		const std::size_t n = 5003;
+		std::vector<float> result(n);
+		std::vector<double> reference(n);
+		std::uint64_t state = 0x2545F4914F6CDD1D;
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			next_random(state);
+			int exp = static_cast<int>(state % 300) - 150;
+			if (i % 5 == 0)
+			{
+				exp = 120 + static_cast<int>(state % 10);
+			}
+			double x = std::ldexp(1.0 + static_cast<double>(state >> 40) / 16777216.0, exp);
+			reference[i] = (state & 1) != 0 ? -x : x;
+			float rounded = static_cast<float>(reference[i]);
+			switch ((state >> 8) % 4)
+			{
+				case 0: result[i] = rounded; break;
+				case 1: result[i] = std::nextafter(std::nextafter(rounded, inf), inf); break;
+				case 2: result[i] = std::nextafter(std::nextafter(std::nextafter(rounded, -inf), -inf), -inf); break;
+				default: result[i] = static_cast<float>(reference[i] * 1.001); break;
+			}
+		}
+		std::vector<std::uint64_t> mask((n + 63) / 64);
+		for_each_isa([&]()
+		{
+			std::size_t expected = 0;
+			bool agree = true;
+			std::size_t total = close_enough.mismatches(result.data(), reference.data(), n, mask.data());
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				bool close = close_enough(result[i], reference[i]);
+				expected += !close;
+				agree &= close != (((mask[i / 64] >> (i % 64)) & 1) != 0);
+			}
+			CHECK(agree);
+			CHECK(total == expected);
+			CHECK(total > 0);
+			CHECK(total < n);
+			for (std::size_t count : {0, 1, 7, 33, 100})
+			{
+				CHECK(close_enough.all_close(result.data() + 1, reference.data() + 1, count) == close_enough.all_close<float, double>(result.data() + 1, reference.data() + 1, count));
+			}
+			proximal_stats<float> s = close_enough.stats(result.data(), reference.data(), n, 10);
+			proximal_stats<float> scanned = close_enough.stats<float, double>(result.data(), reference.data(), n, 10);
+			CHECK(s.mismatches == scanned.mismatches);
+			CHECK(s.first_mismatch == scanned.first_mismatch);
+			CHECK(s.max_error == scanned.max_error);
+			CHECK(s.max_ulps == scanned.max_ulps);
+			CHECK(s.worst == scanned.worst);
+		});
+
+		std::vector<long double> wide(reference.begin(), reference.end());
+		CHECK(close_enough.mismatches(result.data(), wide.data(), n, mask.data()) == close_enough.mismatches(result.data(), reference.data(), n, mask.data()));
+	}
+}
+
+TEST_CASE("array assertions")
+{
+	std::vector<double> a(1000000), b(1000000);
+	for (std::size_t i = 0; i < a.size(); ++i)
+	{
+		a[i] = std::ldexp(1.0 + static_cast<double>(i % 1000) / 1000.0, static_cast<int>(i % 200) - 100);
+		b[i] = i % 3 == 0 ? std::nextafter(a[i], 0.0) : a[i];
+	}
+	std::vector<float> narrow(a.begin(), a.end());
+
+	SUBCASE("passing")
+	{
+		CHECK_ALL_CLOSE(1, a, b);
+		REQUIRE_ALL_CLOSE(1, a, b);
+		CHECK_ALL_CLOSE_N(0, a.data(), b.data(), a.size());
+		CHECK_ALL_CLOSE_WITH(proximal_dynamic{1}, a, b);
+		CHECK_ALL_CLOSE_WITH(proximal_cross<0>{}, narrow, a);
+		float x[] = {1.0f, 2.0f, 3.0f};
+		std::array<float, 3> y{{1.0f, 2.0f, 3.0f}};
+		CHECK_ALL_CLOSE(0, x, y);
+	}
+
+	SUBCASE("failure reports")
+	{
+		for (std::size_t i = 1000; i < 13000; i += 1000)
+		{
+			b[i] = a[i] * 1.01;
+		}
+		b[9000] = a[9000] * 2;
+		doctest::detail::Result r = __all_close_result(proximal<1>{}, a, b);
+		std::string report = r.m_decomposition.c_str();
+		CHECK(!r.m_passed);
+		CHECK(report.find("12 of 1000000 elements") == 0);
+		CHECK(report.find("at [9000]") != std::string::npos);
+		CHECK(report.find("\n  [8000] ") != std::string::npos);
+		CHECK(report.find("[9000] ") == report.rfind("[9000] "));
+		CHECK(report.find("... 4 more") != std::string::npos);
+		CHECK(report.find("worst:\n  [9000] ") != std::string::npos);
+		std::ostringstream distance;
+		distance << ulp_distance(a[1000], b[1000]) << " ulps apart";
+		CHECK(report.find(distance.str()) != std::string::npos);
+
+		b.pop_back();
+		r = __all_close_result(proximal<1>{}, a, b);
+		CHECK(!r.m_passed);
+		CHECK(std::string{r.m_decomposition.c_str()} == "sizes differ: 1000000 and 999999");
+	}
+}